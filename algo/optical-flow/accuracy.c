@@ -0,0 +1,617 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+#include "nv_optical_flow.h"
+#include "nv_dense_flow.h"
+#include "nv_global_motion.h"
+#include "nv_context.h"
+#include "nv_frame_source.h"
+#include "frame1_rgb565.h"
+#include "frame2_rgb565.h"
+
+/*
+ * Accuracy versus cost of the fixed-point tracker. Every sequence is run at
+ * 1..ACC_MAX_LEVELS pyramid levels: features from find_multiple_features()
+ * are tracked with lucas_kanade_pyramid() and with a double-precision
+ * pyramidal LK (bilinear sampling, iterated to ACC_EPS) on the same pyramids,
+ * so the difference isolates the fixed-point tracker. Per row:
+ *
+ *   epe_ref     mean endpoint error against the double-precision result
+ *   epe_true    mean endpoint error against the known motion: the built-in
+ *               synthetic sequences and -s files rendered by utils/nvsynth.py
+ *   survive     share of features tracked to within ACC_SURVIVE_PX
+ *   us/frame    pyramid + LK + features of one frame, best of ACC_TIMING_REPS
+ *   cost        us/frame over the best time of a 320x240 build_image_pyramid(),
+ *               so baselines carry between machines of one kind
+ *
+ * The built-in sequences also get a "-dense" row per depth for
+ * dense_flow_compute() on one thread: feat counts the valid blocks, epe_true
+ * is taken at the block centres, survive is the share of all blocks within
+ * ACC_SURVIVE_PX, and us/frame covers the gradients and the field: the
+ * fastest frame, each the best of ACC_DENSE_TIMING_REPS, since a multi-ms
+ * kernel is rarely timed undisturbed and the mean over frames drifts by
+ * tens of percent between runs. Their cost is also held to the wider
+ * ACC_DENSE_COST_TOL. There is no reference for it, so epe_ref is "-".
+ *
+ * The compiled-in pair that run.exe tracks by default has no consistent
+ * motion: the run also fails if its global motion fit succeeds on a single
+ * agreeing track or a minority of them, which would report a direction
+ * from noise.
+ *
+ * Against a baseline a row fails when it is Pareto-dominated by its baseline
+ * row: accuracy lost without cost going down by more than the cost tolerance,
+ * or cost up by more than the tolerance without accuracy improving.
+ */
+#define ACC_MAX_LEVELS 3
+#define ACC_FRAMES 10
+#define ACC_TIMING_REPS 5
+#define ACC_DENSE_TIMING_REPS 15
+#define ACC_MAX_ITER 30
+#define ACC_EPS 1e-3                // reference LK stops below this step, pixels
+#define ACC_SURVIVE_PX 1.0
+#define ACC_EPE_TOL 0.02            // absolute endpoint error tolerance, pixels
+#define ACC_SURVIVE_TOL 0.02
+#define ACC_COST_TOL 0.25           // default relative cost tolerance
+#define ACC_DENSE_COST_TOL 0.5      // least relative cost tolerance of the -dense rows
+#define ACC_MAX_SEQUENCES 8
+#define ACC_MAX_ROWS 64
+
+typedef struct {
+    const char *name;
+    int width, height;
+    double vx, vy;                  // pixels per frame
+} AccCase;
+
+typedef struct {
+    char name[48];
+    int levels;
+    int features;                   // tracked in total
+    double epe_ref, epe_true;       // < 0 without a reference or ground truth
+    double survival;
+    double frame_us, cost;
+} AccResult;
+
+static const AccCase acc_cases[] = {
+    { "syn160-slow", 160, 90, 0.3, 0.2 },
+    { "syn160", 160, 90, 1.3, -0.7 },
+    { "syn160-fast", 160, 90, 3.5, 2.25 },
+    { "syn320", 320, 240, 2.2, 1.1 },
+    { "syn320-fast", 320, 240, 6.0, -4.0 },
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Double-precision reference LK
+ */
+static double sample(const unsigned char *img, int width, int height, double x, double y) {
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x > width - 1) x = width - 1;
+    if (y > height - 1) y = height - 1;
+    int ix = (int)x, iy = (int)y;
+    if (ix > width - 2) ix = width - 2;
+    if (iy > height - 2) iy = height - 2;
+    double fx = x - ix, fy = y - iy;
+    const unsigned char *p = img + iy * width + ix;
+    return (p[0] * (1 - fx) + p[1] * fx) * (1 - fy) + (p[width] * (1 - fx) + p[width + 1] * fx) * fy;
+}
+
+/*
+ * Template at (px, py), flow (gx, gy) refined in place
+ */
+static int ref_lk_level(const unsigned char *img1, const unsigned char *img2, int width, int height,
+                        double px, double py, double *gx, double *gy) {
+    const int half = WINDOW_SIZE / 2;
+    double tmpl[WINDOW_SIZE * WINDOW_SIZE], ix[WINDOW_SIZE * WINDOW_SIZE], iy[WINDOW_SIZE * WINDOW_SIZE];
+    double sxx = 0, sxy = 0, syy = 0;
+
+    if (px < half + 1 || py < half + 1 || px > width - half - 2 || py > height - half - 2) return 0;
+    for (int dy = -half, k = 0; dy <= half; dy++) {
+        for (int dx = -half; dx <= half; dx++, k++) {
+            double x = px + dx, y = py + dy;
+            tmpl[k] = sample(img1, width, height, x, y);
+            ix[k] = (sample(img1, width, height, x + 1, y) - sample(img1, width, height, x - 1, y)) / 2;
+            iy[k] = (sample(img1, width, height, x, y + 1) - sample(img1, width, height, x, y - 1)) / 2;
+            sxx += ix[k] * ix[k];
+            sxy += ix[k] * iy[k];
+            syy += iy[k] * iy[k];
+        }
+    }
+    double det = sxx * syy - sxy * sxy;
+    if (det < 1e-6) return 0;
+
+    for (int iter = 0; iter < ACC_MAX_ITER; iter++) {
+        double qx = px + *gx, qy = py + *gy;
+        double bx = 0, by = 0;
+        if (qx < half || qy < half || qx > width - 1 - half || qy > height - 1 - half) return 0;
+        for (int dy = -half, k = 0; dy <= half; dy++) {
+            for (int dx = -half; dx <= half; dx++, k++) {
+                double it = sample(img2, width, height, qx + dx, qy + dy) - tmpl[k];
+                bx += ix[k] * it;
+                by += iy[k] * it;
+            }
+        }
+        double du = (syy * -bx - sxy * -by) / det;
+        double dv = (sxx * -by - sxy * -bx) / det;
+        *gx += du;
+        *gy += dv;
+        if (fabs(du) < ACC_EPS && fabs(dv) < ACC_EPS) break;
+    }
+    return 1;
+}
+
+static int ref_lk_pyramid(const NvContext *ctx, const FrameData *f1, const FrameData *f2,
+                          double x0, double y0, double *x1, double *y1) {
+    double gx = 0, gy = 0;
+    for (int l = ctx->levels - 1; l >= 0; l--) {
+        double s = 1.0 / (1 << l);
+        if (!ref_lk_level(f1->pyr[l], f2->pyr[l], ctx->level_width[l], ctx->level_height[l], x0 * s, y0 * s, &gx, &gy)) {
+            return 0;
+        }
+        if (l > 0) {
+            gx *= 2;
+            gy *= 2;
+        }
+    }
+    *x1 = x0 + gx;
+    *y1 = y0 + gy;
+    return 1;
+}
+
+/*
+ * Cost unit: best time of a 320x240 pyramid level on this machine, after a
+ * warm-up
+ */
+static double calibrate_ns(void) {
+    enum { W = 320, H = 240, WARMUP = 20, RUNS = 200 };
+    static unsigned char src[W * H], dst[(W / 2) * (H / 2)];
+    double best = 0;
+
+    for (int i = 0; i < W * H; i++) src[i] = (unsigned char)(i * 7 + (i >> 5));
+    for (int r = 0; r < WARMUP + RUNS; r++) {
+        uint64_t start = now_ns();
+        build_image_pyramid(src, dst, W, H);
+        double t = (double)(now_ns() - start);
+        if (r == WARMUP || (r > WARMUP && t < best)) best = t;
+    }
+    return best > 0 ? best : 1;
+}
+
+static void build_levels(const NvContext *ctx, FrameData *frame) {
+    for (int l = 1; l < ctx->levels; l++) {
+        build_image_pyramid(frame->pyr[l - 1], frame->pyr[l], ctx->level_width[l - 1], ctx->level_height[l - 1]);
+    }
+}
+
+/*
+ * Known motion into the frame as x' = m[0] x + m[1] y + m[2], y' = m[3] x + m[4] y + m[5].
+ * Returns 0 without ground truth; JPEG frames are scaled, so their truth is unused.
+ */
+static int frame_truth(const FrameSource *src, const FrameView *view, double m[6]) {
+    if (src->render != NULL) {
+        m[0] = 1, m[1] = 0, m[2] = src->vx / 256.0;
+        m[3] = 0, m[4] = 1, m[5] = src->vy / 256.0;
+        return 1;
+    }
+    const NvSeqMotion *motion = view->format != PIXFMT_JPEG ? nvsq_motion(&src->seq, view->index) : NULL;
+    if (motion == NULL) return 0;
+    for (int k = 0; k < 6; k++) m[k] = motion->m[k] / 16384.0;
+    return 1;
+}
+
+/*
+ * One sequence at one pyramid depth
+ */
+static int run_sequence(FrameSource *src, int levels, double calib_ns, AccResult *r) {
+    NvContext ctx;
+    FrameView view;
+    double epe_ref = 0, epe_true = 0, frame_ns = 0;
+    int compared = 0, tracked = 0, survived = 0, total = 0, timed = 0, truth_tracked = 0;
+
+    if (!nv_context_init(&ctx, src->width, src->height, src->format, levels, NV_CTX_EXTERNAL_FRAMES)) return 0;
+    void *arena = malloc(nv_context_mem_required(&ctx));
+    if (!nv_context_bind(&ctx, arena, nv_context_mem_required(&ctx))) {
+        free(arena);
+        return 0;
+    }
+
+    FrameData *frames = ctx.frames;
+    int cur = 0, have_reference = 0;
+    while (frame_source_next(src, &view)) {
+        FrameData *prev = &frames[cur ^ 1], *curr = &frames[cur];
+        double truth[6];
+        int has_truth = frame_truth(src, &view, truth);
+        int ok = frame_view_to_gray(&view, curr->pyr[0]);
+        frame_source_release(src, &view);
+        if (!ok) break;
+
+        int32_t p1[MAX_FEATURES][2];
+        uint8_t status[MAX_FEATURES];
+        double best = 0;
+        for (int rep = 0; rep < ACC_TIMING_REPS; rep++) {
+            uint64_t start = now_ns();
+            build_levels(&ctx, curr);
+            for (int i = 0; have_reference && i < prev->num_features; i++) {
+                status[i] = (uint8_t)lucas_kanade_pyramid(prev->pyr, curr->pyr, NULL, NULL, prev->feature_points[i], p1[i],
+                                                          ctx.width, ctx.height, ctx.levels);
+            }
+            int32_t points[MAX_FEATURES][2];
+            int n = 0;
+            find_multiple_features(curr->pyr[0], ctx.width, ctx.height, points, &n);
+            double t = (double)(now_ns() - start);
+            if (rep == 0 || t < best) best = t;
+        }
+        frame_ns += best;
+        timed++;
+
+        for (int i = 0; have_reference && i < prev->num_features; i++) {
+            double x0 = prev->feature_points[i][0] / 16384.0, y0 = prev->feature_points[i][1] / 16384.0;
+            double rx, ry;
+            int ref_ok = ref_lk_pyramid(&ctx, prev, curr, x0, y0, &rx, &ry);
+            total++;
+            if (!status[i]) continue;
+
+            double fx = p1[i][0] / 16384.0, fy = p1[i][1] / 16384.0;
+            double err;
+            tracked++;
+            if (ref_ok) {
+                epe_ref += hypot(fx - rx, fy - ry);
+                compared++;
+            }
+            if (has_truth) {
+                double tx = truth[0] * x0 + truth[1] * y0 + truth[2];
+                double ty = truth[3] * x0 + truth[4] * y0 + truth[5];
+                err = hypot(fx - tx, fy - ty);
+                epe_true += err;
+                truth_tracked++;
+            } else {
+                err = ref_ok ? hypot(fx - rx, fy - ry) : ACC_SURVIVE_PX;
+            }
+            if (err < ACC_SURVIVE_PX) survived++;
+        }
+
+        if (!find_multiple_features(curr->pyr[0], ctx.width, ctx.height, curr->feature_points, &curr->num_features)) {
+            curr->num_features = 0;
+        }
+        have_reference = 1;
+        cur ^= 1;
+    }
+    free(arena);
+
+    r->levels = levels;
+    r->features = tracked;
+    r->epe_ref = compared > 0 ? epe_ref / compared : 0;
+    r->epe_true = truth_tracked > 0 ? epe_true / truth_tracked : -1;
+    r->survival = total > 0 ? (double)survived / total : 0;
+    r->frame_us = timed > 0 ? frame_ns / timed / 1000 : 0;
+    r->cost = timed > 0 ? frame_ns / timed / calib_ns : 0;
+    return total > 0;
+}
+
+/*
+ * The dense field between consecutive frames of one sequence with known
+ * motion
+ */
+static int run_dense(FrameSource *src, int levels, double calib_ns, AccResult *r) {
+    NvContext ctx;
+    FrameView view;
+    int16_t *gradx[ACC_MAX_LEVELS] = { NULL }, *grady[ACC_MAX_LEVELS] = { NULL };
+    double epe_true = 0, frame_ns = 0;
+    int valid = 0, survived = 0, total = 0, timed = 0, ok = 1;
+
+    if (!nv_context_init(&ctx, src->width, src->height, src->format, levels, NV_CTX_EXTERNAL_FRAMES)) return 0;
+    void *arena = malloc(nv_context_mem_required(&ctx));
+    int16_t *flow = (int16_t *)malloc((size_t)dense_flow_field_size(ctx.width, ctx.height) * sizeof(int16_t));
+    for (int l = 0; l < levels; l++) {
+        size_t size = (size_t)ctx.level_width[l] * ctx.level_height[l];
+        gradx[l] = (int16_t *)calloc(size, sizeof(int16_t));
+        grady[l] = (int16_t *)calloc(size, sizeof(int16_t));
+        ok = ok && gradx[l] != NULL && grady[l] != NULL;
+    }
+    DenseFlowField field;
+    ok = ok && nv_context_bind(&ctx, arena, nv_context_mem_required(&ctx)) &&
+         dense_flow_init(&field, flow, ctx.width, ctx.height);
+
+    FrameData *frames = ctx.frames;
+    int cur = 0, have_reference = 0;
+    while (ok && frame_source_next(src, &view)) {
+        FrameData *prev = &frames[cur ^ 1], *curr = &frames[cur];
+        double truth[6];
+        int has_truth = frame_truth(src, &view, truth);
+        ok = frame_view_to_gray(&view, curr->pyr[0]);
+        frame_source_release(src, &view);
+        if (!ok) break;
+        build_levels(&ctx, curr);
+
+        if (have_reference && has_truth) {
+            DenseFlowInput in = { prev->pyr, curr->pyr, gradx, grady, ctx.width, ctx.height, ctx.levels };
+            double best = 0;
+            for (int rep = 0; rep < ACC_DENSE_TIMING_REPS; rep++) {
+                uint64_t start = now_ns();
+                for (int l = 0; l < ctx.levels; l++) {
+                    compute_gradient(prev->pyr[l], gradx[l], grady[l], ctx.level_width[l], ctx.level_height[l]);
+                }
+                dense_flow_compute(&in, &field, 1);
+                double t = (double)(now_ns() - start);
+                if (rep == 0 || t < best) best = t;
+            }
+            if (timed == 0 || best < frame_ns) frame_ns = best;
+            timed++;
+
+            for (int by = 0; by < field.rows; by++) {
+                for (int bx = 0; bx < field.cols; bx++) {
+                    const int16_t *f = &field.flow[(by * field.cols + bx) * 2];
+                    total++;
+                    if (f[0] == DENSE_FLOW_INVALID) continue;
+                    double x0 = bx * DENSE_BLOCK_SIZE + DENSE_BLOCK_SIZE / 2;
+                    double y0 = by * DENSE_BLOCK_SIZE + DENSE_BLOCK_SIZE / 2;
+                    double tx = truth[0] * x0 + truth[1] * y0 + truth[2] - x0;
+                    double ty = truth[3] * x0 + truth[4] * y0 + truth[5] - y0;
+                    double err = hypot(f[0] / (double)(1 << DENSE_FLOW_SHIFT) - tx,
+                                       f[1] / (double)(1 << DENSE_FLOW_SHIFT) - ty);
+                    epe_true += err;
+                    valid++;
+                    if (err < ACC_SURVIVE_PX) survived++;
+                }
+            }
+        }
+        have_reference = 1;
+        cur ^= 1;
+    }
+    for (int l = 0; l < levels; l++) {
+        free(gradx[l]);
+        free(grady[l]);
+    }
+    free(flow);
+    free(arena);
+
+    r->levels = levels;
+    r->features = valid;
+    r->epe_ref = -1;
+    r->epe_true = valid > 0 ? epe_true / valid : -1;
+    r->survival = total > 0 ? (double)survived / total : 0;
+    r->frame_us = frame_ns / 1000;
+    r->cost = frame_ns / calib_ns;
+    return ok && total > 0;
+}
+
+/*
+ * Baseline: one line per row, "name levels epe_ref epe_true survival cost"
+ */
+static int load_baseline(const char *path, AccResult *rows, int max_rows) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int n = 0;
+
+    if (f == NULL) return -1;
+    while (n < max_rows && fgets(line, sizeof(line), f) != NULL) {
+        AccResult *b = &rows[n];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%47s %d %lf %lf %lf %lf", b->name, &b->levels, &b->epe_ref, &b->epe_true,
+                   &b->survival, &b->cost) == 6) {
+            n++;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+static int save_baseline(const char *path, const AccResult *rows, int n) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return 0;
+    fprintf(f, "# accuracy baseline: name levels epe_ref epe_true survival cost, see accuracy.c\n");
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "%s %d %.4f %.4f %.4f %.2f\n", rows[i].name, rows[i].levels, rows[i].epe_ref, rows[i].epe_true,
+                rows[i].survival, rows[i].cost);
+    }
+    fclose(f);
+    return 1;
+}
+
+/*
+ * Returns 1 when the row is dominated by its baseline row
+ */
+static int regressed(const AccResult *r, const AccResult *b, double cost_tol) {
+    double epe = r->epe_true >= 0 ? r->epe_true : r->epe_ref;
+    double base_epe = b->epe_true >= 0 ? b->epe_true : b->epe_ref;
+    int worse = epe > base_epe + ACC_EPE_TOL || r->survival < b->survival - ACC_SURVIVE_TOL;
+    int better = epe < base_epe - ACC_EPE_TOL || r->survival > b->survival + ACC_SURVIVE_TOL;
+    int cheaper = r->cost < b->cost * (1 - cost_tol);
+    int dearer = r->cost > b->cost * (1 + cost_tol);
+
+    return (worse && !cheaper) || (dearer && !better);
+}
+
+static int is_dense(const AccResult *r) {
+    size_t len = strlen(r->name);
+    return len > 6 && strcmp(r->name + len - 6, "-dense") == 0;
+}
+
+/*
+ * Tracks the compiled-in pair like run.exe and fits its global motion.
+ * Returns 0 when the fit claims a consensus that one track or a minority of
+ * the tracks make up.
+ */
+static int check_pair(void) {
+    static const void *const pair[] = { frame1_rgb565, frame2_rgb565 };
+    FrameSource src;
+    FrameView view;
+    NvContext ctx;
+    int32_t p0[MAX_FEATURES * 2], p1[MAX_FEATURES * 2];
+    uint8_t status[MAX_FEATURES];
+    GlobalMotion gm;
+    int n = 0, tracked = 0, fitted = 0, ok = 0;
+
+    gm.inliers = 0;
+    if (!frame_source_open_arrays(&src, pair, 2, frame1_rgb565_width, frame1_rgb565_height, PIXFMT_RGB565)) return 0;
+    if (!nv_context_init(&ctx, src.width, src.height, src.format, PYR_LEVELS, NV_CTX_EXTERNAL_FRAMES)) {
+        frame_source_close(&src);
+        return 0;
+    }
+    void *arena = malloc(nv_context_mem_required(&ctx));
+    if (nv_context_bind(&ctx, arena, nv_context_mem_required(&ctx))) {
+        for (int f = 0; f < 2 && frame_source_next(&src, &view); f++) {
+            frame_view_to_gray(&view, ctx.frames[f].pyr[0]);
+            frame_source_release(&src, &view);
+            build_levels(&ctx, &ctx.frames[f]);
+        }
+        FrameData *prev = &ctx.frames[0];
+        find_multiple_features(prev->pyr[0], ctx.width, ctx.height, prev->feature_points, &prev->num_features);
+        n = prev->num_features;
+        for (int i = 0; i < n; i++) {
+            p0[i * 2] = prev->feature_points[i][0];
+            p0[i * 2 + 1] = prev->feature_points[i][1];
+            status[i] = (uint8_t)lucas_kanade_pyramid(prev->pyr, ctx.frames[1].pyr, NULL, NULL, &p0[i * 2], &p1[i * 2],
+                                                      ctx.width, ctx.height, ctx.levels);
+            tracked += status[i] != 0;
+        }
+        fitted = global_motion_estimate(p0, p1, status, n, GM_TRANSLATION, &gm, NULL);
+        ok = !fitted || (gm.inliers >= 2 && gm.inliers * 2 > tracked);
+    }
+    free(arena);
+    frame_source_close(&src);
+
+    printf("pair: %d features, %d tracked, %d inliers, %s\n", n, tracked, gm.inliers,
+           !fitted ? "no fit, no direction" : ok ? "fit" : "FIT FROM TOO FEW INLIERS");
+    return ok;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [-b baseline] [-u] [-c cost_tol] [-s file.nvsq]...\n"
+           "  -b baseline   compare against this file, default accuracy_baseline.txt\n"
+           "  -u            write the results to the baseline instead of comparing\n"
+           "  -c cost_tol   relative cost tolerance, default %.2f, at least %.2f for -dense rows\n"
+           "  -s file.nvsq  add a sequence; its ground truth is used when it has one\n",
+           name, ACC_COST_TOL, ACC_DENSE_COST_TOL);
+}
+
+int main(int argc, char **argv) {
+    const char *baseline_path = "accuracy_baseline.txt";
+    const char *sequences[ACC_MAX_SEQUENCES];
+    int num_sequences = 0, update = 0;
+    double cost_tol = ACC_COST_TOL;
+    static AccResult rows[ACC_MAX_ROWS], base[ACC_MAX_ROWS];
+    int num_rows = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-u") == 0) {
+            update = 1;
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            baseline_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            cost_tol = atof(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0 && num_sequences < ACC_MAX_SEQUENCES) {
+            sequences[num_sequences++] = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    double calib_ns = calibrate_ns();
+    int num_cases = (int)(sizeof(acc_cases) / sizeof(acc_cases[0]));
+    for (int c = 0; c < num_cases + num_sequences; c++) {
+        for (int levels = 1; levels <= ACC_MAX_LEVELS && num_rows < ACC_MAX_ROWS; levels++) {
+            FrameSource src;
+            AccResult *r = &rows[num_rows];
+            int opened, ok;
+
+            memset(r, 0, sizeof(*r));
+            if (c < num_cases) {
+                const AccCase *ac = &acc_cases[c];
+                int32_t vx = (int32_t)lround(ac->vx * 256), vy = (int32_t)lround(ac->vy * 256);
+                snprintf(r->name, sizeof(r->name), "%s", ac->name);
+                opened = frame_source_open_synthetic(&src, ac->width, ac->height, PIXFMT_GRAY8, vx, vy, ACC_FRAMES);
+                ok = opened && run_sequence(&src, levels, calib_ns, r);
+            } else {
+                const char *path = sequences[c - num_cases];
+                const char *slash = strrchr(path, '/');
+                snprintf(r->name, sizeof(r->name), "%s", slash != NULL ? slash + 1 : path);
+                opened = frame_source_open_sequence(&src, path, 3);
+                ok = opened && run_sequence(&src, levels, calib_ns, r);
+            }
+            if (opened) frame_source_close(&src);
+            if (!ok) {
+                printf("Skipping %s at %d levels: cannot open or too small\n", r->name, levels);
+                continue;
+            }
+            num_rows++;
+        }
+    }
+
+    for (int c = 0; c < num_cases; c++) {
+        for (int levels = 1; levels <= ACC_MAX_LEVELS && num_rows < ACC_MAX_ROWS; levels++) {
+            const AccCase *ac = &acc_cases[c];
+            int32_t vx = (int32_t)lround(ac->vx * 256), vy = (int32_t)lround(ac->vy * 256);
+            FrameSource src;
+            AccResult *r = &rows[num_rows];
+
+            memset(r, 0, sizeof(*r));
+            snprintf(r->name, sizeof(r->name), "%s-dense", ac->name);
+            int opened = frame_source_open_synthetic(&src, ac->width, ac->height, PIXFMT_GRAY8, vx, vy, ACC_FRAMES);
+            int ok = opened && run_dense(&src, levels, calib_ns, r);
+            if (opened) frame_source_close(&src);
+            if (!ok) {
+                printf("Skipping %s at %d levels: cannot open or too small\n", r->name, levels);
+                continue;
+            }
+            num_rows++;
+        }
+    }
+
+    if (update) {
+        if (!save_baseline(baseline_path, rows, num_rows)) {
+            printf("Error: cannot write %s\n", baseline_path);
+            return 1;
+        }
+        printf("Wrote %d rows to %s\n", num_rows, baseline_path);
+    }
+
+    int num_base = update ? -1 : load_baseline(baseline_path, base, ACC_MAX_ROWS);
+    int failures = 0;
+    printf("%-18s %2s %5s %8s %8s %7s %9s %7s  %s\n", "sequence", "lv", "feat", "epe_ref", "epe_true", "survive",
+           "us/frame", "cost", num_base >= 0 ? "baseline" : "");
+    for (int i = 0; i < num_rows; i++) {
+        const AccResult *r = &rows[i];
+        const AccResult *b = NULL;
+        char verdict[96] = "";
+
+        for (int j = 0; j < num_base; j++) {
+            if (strcmp(base[j].name, r->name) == 0 && base[j].levels == r->levels) b = &base[j];
+        }
+        if (b != NULL) {
+            double tol = is_dense(r) && cost_tol < ACC_DENSE_COST_TOL ? ACC_DENSE_COST_TOL : cost_tol;
+            int bad = regressed(r, b, tol);
+            snprintf(verdict, sizeof(verdict), "%s (%.3f px, %.0f%%, cost %.2f)", bad ? "REGRESSED" : "ok",
+                     b->epe_true >= 0 ? b->epe_true : b->epe_ref, b->survival * 100, b->cost);
+            failures += bad;
+        } else if (num_base >= 0) {
+            snprintf(verdict, sizeof(verdict), "new");
+        }
+        char epe_ref[16] = "-", epe_true[16] = "-";
+        if (r->epe_ref >= 0) snprintf(epe_ref, sizeof(epe_ref), "%.3f", r->epe_ref);
+        if (r->epe_true >= 0) snprintf(epe_true, sizeof(epe_true), "%.3f", r->epe_true);
+        printf("%-18s %2d %5d %8s %8s %6.0f%% %9.1f %7.2f  %s\n", r->name, r->levels, r->features, epe_ref,
+               epe_true, r->survival * 100, r->frame_us, r->cost, verdict);
+    }
+    if (num_base < 0 && !update) {
+        printf("No baseline at %s, run with -u to create it\n", baseline_path);
+    }
+    if (failures > 0) {
+        printf("FAIL: %d of %d rows regressed against %s\n", failures, num_rows, baseline_path);
+        return 1;
+    }
+    if (!check_pair()) {
+        printf("FAIL: the compiled-in pair reports motion from too few inliers\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,414 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+#include "nv_optical_flow.h"
+#include "nv_dense_flow.h"
+#include "nv_frame_source.h"
+
+/*
+ * Kernel microbenchmarks: every kernel at every size in bench_sizes, LK also
+ * per feature count and dense_flow_compute() per thread count, on gradients
+ * computed once up front. Each case is warmed up, then repeated until it has run
+ * for at least min_ms (between BENCH_MIN_REPS and BENCH_MAX_REPS times), with
+ * each repetition timed on its own. Results go to stdout as a table, CSV or
+ * JSON; see usage().
+ *
+ * Frames are a rendered texture moved by BENCH_SHIFT_X/Y, or with -i the
+ * first two frames of a sequence (e.g. from utils/nvsynth.py) at its own size.
+ */
+#define BENCH_WARMUP 3
+#define BENCH_MIN_REPS 5
+#define BENCH_MAX_REPS 2000
+#define BENCH_MAX_LEVELS 5
+#define BENCH_SHIFT_X 1.3           // frame 2 is frame 1 moved by this, pixels
+#define BENCH_SHIFT_Y 0.7
+
+typedef enum {
+    FMT_TABLE,
+    FMT_CSV,
+    FMT_JSON
+} bench_format_t;
+
+typedef struct {
+    const char *kernel;
+    int width, height;
+    int features;                   // LK feature count, dense_flow thread count, 0 otherwise
+    int reps;
+    double min, median, mean, p90, max, stddev;     // ns per call
+    double mpix_s;                  // level-0 pixels per second at the median, per-pixel kernels only
+} BenchResult;
+
+typedef struct {
+    int width, height, levels;
+    uint16_t *rgb565[2];
+    unsigned char *pyr[2][BENCH_MAX_LEVELS];
+    int16_t *gradx, *grady;
+    int16_t *dense_gradx[BENCH_MAX_LEVELS], *dense_grady[BENCH_MAX_LEVELS];   // of frame 1, per level
+    DenseFlowField dense;
+    int32_t points[MAX_FEATURES][2];
+} BenchFrames;
+
+static const int bench_sizes[][2] = { { 160, 90 }, { 320, 240 }, { 640, 480 }, { 800, 600 }, { 1600, 1200 } };
+static const int bench_feature_counts[] = { 1, 2, 4, 8 };
+static const int bench_dense_threads[] = { 1, 4 };
+
+static volatile uint32_t sink;     // keeps results alive
+static bench_format_t format = FMT_TABLE;
+static int results_printed = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint16_t gray_to_rgb565(int gray) {
+    return (uint16_t)(((gray >> 3) << 11) | ((gray >> 2) << 5) | (gray >> 3));
+}
+
+/*
+ * Smooth texture with structure in both directions, moved by (dx, dy)
+ */
+static void render_frame(uint16_t *rgb565, int width, int height, double dx, double dy) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double u = x - dx, v = y - dy;
+            double g = 128 + 60 * sin(u * 0.21 + 0.8 * sin(v * 0.05)) + 50 * sin(v * 0.17 + u * 0.03);
+            int gray = g < 0 ? 0 : g > 255 ? 255 : (int)g;
+            rgb565[y * width + x] = gray_to_rgb565(gray);
+        }
+    }
+}
+
+/*
+ * Gray levels of the next two frames of src, RGB565 made from them
+ */
+static int load_frames(BenchFrames *f, FrameSource *src) {
+    for (int i = 0; i < 2; i++) {
+        FrameView view;
+        if (!frame_source_next(src, &view)) return 0;
+        int ok = frame_view_to_gray(&view, f->pyr[i][0]);
+        frame_source_release(src, &view);
+        if (!ok) return 0;
+        for (int k = 0; k < f->width * f->height; k++) f->rgb565[i][k] = gray_to_rgb565(f->pyr[i][0][k]);
+    }
+    return 1;
+}
+
+/*
+ * Frames rendered at width x height, or read from src when not NULL
+ */
+static int frames_alloc(BenchFrames *f, int width, int height, int levels, FrameSource *src) {
+    memset(f, 0, sizeof(*f));
+    f->width = width;
+    f->height = height;
+    f->levels = levels;
+    for (int i = 0; i < 2; i++) {
+        f->rgb565[i] = (uint16_t *)malloc((size_t)width * height * sizeof(uint16_t));
+        for (int l = 0; l < levels; l++) {
+            f->pyr[i][l] = (unsigned char *)malloc((size_t)(width >> l) * (height >> l));
+            if (f->pyr[i][l] == NULL) return 0;
+        }
+        if (f->rgb565[i] == NULL) return 0;
+    }
+    f->gradx = (int16_t *)calloc((size_t)width * height, sizeof(int16_t));
+    f->grady = (int16_t *)calloc((size_t)width * height, sizeof(int16_t));
+    if (f->gradx == NULL || f->grady == NULL) return 0;
+
+    if (src != NULL) {
+        if (!load_frames(f, src)) return 0;
+    } else {
+        render_frame(f->rgb565[0], width, height, 0, 0);
+        render_frame(f->rgb565[1], width, height, BENCH_SHIFT_X, BENCH_SHIFT_Y);
+        for (int i = 0; i < 2; i++) rgb565_to_grayscale(f->rgb565[i], f->pyr[i][0], width, height);
+    }
+    for (int i = 0; i < 2; i++) {
+        for (int l = 1; l < levels; l++) {
+            build_image_pyramid(f->pyr[i][l - 1], f->pyr[i][l], width >> (l - 1), height >> (l - 1));
+        }
+    }
+
+    for (int l = 0; l < levels; l++) {
+        f->dense_gradx[l] = (int16_t *)calloc((size_t)(width >> l) * (height >> l), sizeof(int16_t));
+        f->dense_grady[l] = (int16_t *)calloc((size_t)(width >> l) * (height >> l), sizeof(int16_t));
+        if (f->dense_gradx[l] == NULL || f->dense_grady[l] == NULL) return 0;
+        compute_gradient(f->pyr[0][l], f->dense_gradx[l], f->dense_grady[l], width >> l, height >> l);
+    }
+    int16_t *flow = (int16_t *)malloc((size_t)dense_flow_field_size(width, height) * sizeof(int16_t));
+    if (!dense_flow_init(&f->dense, flow, width, height)) {
+        free(flow);
+        return 0;
+    }
+
+    // Features on a grid over the middle half, clear of the LK window at every level
+    for (int i = 0; i < MAX_FEATURES; i++) {
+        f->points[i][0] = (width / 4 + (i % 4) * width / 8) << Q15_SHIFT;
+        f->points[i][1] = (height / 4 + (i / 4) * height / 4) << Q15_SHIFT;
+    }
+    return 1;
+}
+
+static void frames_free(BenchFrames *f) {
+    for (int i = 0; i < 2; i++) {
+        free(f->rgb565[i]);
+        for (int l = 0; l < f->levels; l++) free(f->pyr[i][l]);
+    }
+    for (int l = 0; l < f->levels; l++) {
+        free(f->dense_gradx[l]);
+        free(f->dense_grady[l]);
+    }
+    free(f->gradx);
+    free(f->grady);
+    free(f->dense.flow);
+}
+
+/*
+ * The kernels, one call each
+ */
+typedef void (*bench_fn)(BenchFrames *f, int arg);
+
+static void run_gray(BenchFrames *f, int arg) {
+    (void)arg;
+    rgb565_to_grayscale(f->rgb565[1], f->pyr[1][0], f->width, f->height);
+    sink += f->pyr[1][0][0];
+}
+
+static void run_pyramid(BenchFrames *f, int arg) {
+    (void)arg;
+    build_image_pyramid(f->pyr[1][0], f->pyr[1][1], f->width, f->height);
+    sink += f->pyr[1][1][0];
+}
+
+static void run_gradient(BenchFrames *f, int arg) {
+    (void)arg;
+    compute_gradient(f->pyr[0][0], f->gradx, f->grady, f->width, f->height);
+    sink += (uint32_t)f->gradx[f->width + 1];
+}
+
+static void run_strong_feature(BenchFrames *f, int arg) {
+    int32_t point[2];
+    (void)arg;
+    sink += (uint32_t)find_strong_feature(f->pyr[0][0], f->width, f->height, point);
+}
+
+static void run_multiple_features(BenchFrames *f, int arg) {
+    int32_t points[MAX_FEATURES][2];
+    int n = 0;
+    (void)arg;
+    find_multiple_features(f->pyr[0][0], f->width, f->height, points, &n);
+    sink += (uint32_t)n;
+}
+
+static void run_lk(BenchFrames *f, int features) {
+    for (int i = 0; i < features; i++) {
+        int32_t p1[2];
+        sink += (uint32_t)lucas_kanade_pyramid(f->pyr[0], f->pyr[1], NULL, NULL, f->points[i], p1,
+                                               f->width, f->height, f->levels);
+    }
+}
+
+static void run_dense(BenchFrames *f, int threads) {
+    DenseFlowInput in = { f->pyr[0], f->pyr[1], f->dense_gradx, f->dense_grady, f->width, f->height, f->levels };
+    sink += (uint32_t)dense_flow_compute(&in, &f->dense, threads);
+}
+
+typedef struct {
+    const char *name;
+    bench_fn fn;
+    int per_pixel;                  // cost scales with the frame size
+} BenchKernel;
+
+static const BenchKernel bench_kernels[] = {
+    { "rgb565_to_gray", run_gray, 1 },
+    { "pyramid", run_pyramid, 1 },
+    { "gradient", run_gradient, 1 },
+    { "strong_feature", run_strong_feature, 0 },
+    { "multi_features", run_multiple_features, 0 },
+};
+static const BenchKernel lk_kernel = { "lk_pyramid", run_lk, 0 };     // per feature count
+static const BenchKernel dense_kernel = { "dense_flow", run_dense, 1 }; // per thread count
+
+static void measure(BenchFrames *f, const BenchKernel *kernel, int arg, double min_ms, BenchResult *r) {
+    static uint64_t samples[BENCH_MAX_REPS];
+    bench_fn fn = kernel->fn;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_WARMUP; i++) fn(f, arg);
+    double per_call = (double)(now_ns() - start) / BENCH_WARMUP;
+
+    int reps = per_call > 0 ? (int)(min_ms * 1e6 / per_call) : BENCH_MAX_REPS;
+    if (reps < BENCH_MIN_REPS) reps = BENCH_MIN_REPS;
+    if (reps > BENCH_MAX_REPS) reps = BENCH_MAX_REPS;
+
+    double sum = 0, sum_sq = 0;
+    for (int i = 0; i < reps; i++) {
+        start = now_ns();
+        fn(f, arg);
+        samples[i] = now_ns() - start;
+        sum += (double)samples[i];
+        sum_sq += (double)samples[i] * (double)samples[i];
+    }
+    qsort(samples, (size_t)reps, sizeof(samples[0]), compare_u64);
+
+    memset(r, 0, sizeof(*r));
+    r->kernel = kernel->name;
+    r->width = f->width;
+    r->height = f->height;
+    r->features = kernel == &lk_kernel || kernel == &dense_kernel ? arg : 0;
+    r->reps = reps;
+    r->min = (double)samples[0];
+    r->median = (double)samples[reps / 2];
+    r->p90 = (double)samples[(reps * 9) / 10];
+    r->max = (double)samples[reps - 1];
+    r->mean = sum / reps;
+    double var = sum_sq / reps - r->mean * r->mean;
+    r->stddev = var > 0 ? sqrt(var) : 0;
+    if (kernel->per_pixel && r->median > 0) {
+        r->mpix_s = (double)f->width * f->height * 1e3 / r->median;
+    }
+}
+
+static void print_result(const BenchResult *r) {
+    switch (format) {
+    case FMT_TABLE:
+        if (results_printed == 0) {
+            printf("%-16s %9s %4s %5s %11s %11s %11s %11s %9s\n", "kernel", "size", "feat", "reps",
+                   "min ns", "median ns", "p90 ns", "stddev ns", "Mpix/s");
+        }
+        printf("%-16s %4dx%-4d %4d %5d %11.0f %11.0f %11.0f %11.0f ", r->kernel, r->width, r->height,
+               r->features, r->reps, r->min, r->median, r->p90, r->stddev);
+        if (r->mpix_s > 0) {
+            printf("%9.1f\n", r->mpix_s);
+        } else {
+            printf("%9s\n", "-");
+        }
+        break;
+    case FMT_CSV:
+        if (results_printed == 0) {
+            printf("kernel,width,height,features,reps,min_ns,median_ns,mean_ns,p90_ns,max_ns,stddev_ns,mpix_s\n");
+        }
+        printf("%s,%d,%d,%d,%d,%.0f,%.0f,%.1f,%.0f,%.0f,%.1f,%.3f\n", r->kernel, r->width, r->height, r->features,
+               r->reps, r->min, r->median, r->mean, r->p90, r->max, r->stddev, r->mpix_s);
+        break;
+    case FMT_JSON:
+        printf("%s    {\"kernel\": \"%s\", \"width\": %d, \"height\": %d, \"features\": %d, \"reps\": %d, "
+               "\"min_ns\": %.0f, \"median_ns\": %.0f, \"mean_ns\": %.1f, \"p90_ns\": %.0f, \"max_ns\": %.0f, "
+               "\"stddev_ns\": %.1f, \"mpix_s\": %.3f}",
+               results_printed == 0 ? "" : ",\n", r->kernel, r->width, r->height, r->features, r->reps,
+               r->min, r->median, r->mean, r->p90, r->max, r->stddev, r->mpix_s);
+        break;
+    }
+    results_printed++;
+}
+
+static void bench_size(int width, int height, int levels, double min_ms, FrameSource *src) {
+    BenchFrames f;
+    BenchResult r;
+
+    if (!frames_alloc(&f, width, height, levels, src)) {
+        fprintf(stderr, "Error: cannot allocate or read %dx%d\n", width, height);
+        frames_free(&f);
+        return;
+    }
+    for (unsigned i = 0; i < sizeof(bench_kernels) / sizeof(bench_kernels[0]); i++) {
+        measure(&f, &bench_kernels[i], 0, min_ms, &r);
+        print_result(&r);
+    }
+    for (unsigned i = 0; i < sizeof(bench_feature_counts) / sizeof(bench_feature_counts[0]); i++) {
+        measure(&f, &lk_kernel, bench_feature_counts[i], min_ms, &r);
+        print_result(&r);
+    }
+    for (unsigned i = 0; i < sizeof(bench_dense_threads) / sizeof(bench_dense_threads[0]); i++) {
+        measure(&f, &dense_kernel, bench_dense_threads[i], min_ms, &r);
+        print_result(&r);
+    }
+    frames_free(&f);
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [-l levels] [-t min_ms] [-s WxH | -i file.nvsq] [-f table|csv|json]\n"
+           "  -l levels   pyramid levels for LK, default %d\n"
+           "  -t min_ms   minimum measured time per case, default 100\n"
+           "  -s WxH      one size instead of 160x90 .. 1600x1200\n"
+           "  -i file     first two frames of this sequence instead of rendered ones\n"
+           "  -f format   table (default), csv or json on stdout\n",
+           name, PYR_LEVELS);
+}
+
+int main(int argc, char **argv) {
+    int levels = PYR_LEVELS;
+    double min_ms = 100;
+    int only_width = 0, only_height = 0;
+    const char *input = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-l") == 0) {
+            levels = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            min_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            if (sscanf(argv[++i], "%dx%d", &only_width, &only_height) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-i") == 0) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0) {
+            const char *name = argv[++i];
+            if (strcmp(name, "table") == 0) {
+                format = FMT_TABLE;
+            } else if (strcmp(name, "csv") == 0) {
+                format = FMT_CSV;
+            } else if (strcmp(name, "json") == 0) {
+                format = FMT_JSON;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (levels < 1 || levels > BENCH_MAX_LEVELS || min_ms <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FrameSource src;
+    if (input != NULL && !frame_source_open_sequence(&src, input, 0)) {
+        fprintf(stderr, "Error: cannot open %s\n", input);
+        return 1;
+    }
+
+    if (format == FMT_JSON) {
+        printf("{\n  \"levels\": %d,\n  \"window\": %d,\n  \"iterations\": %d,\n  \"min_ms\": %.1f,\n  \"results\": [\n",
+               levels, WINDOW_SIZE, NUM_ITER, min_ms);
+    }
+    if (input != NULL) {
+        bench_size(src.width, src.height, levels, min_ms, &src);
+        frame_source_close(&src);
+    } else if (only_width > 0 && only_height > 0) {
+        bench_size(only_width, only_height, levels, min_ms, NULL);
+    } else {
+        for (unsigned i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+            bench_size(bench_sizes[i][0], bench_sizes[i][1], levels, min_ms, NULL);
+        }
+    }
+    if (format == FMT_JSON) {
+        printf("\n  ]\n}\n");
+    }
+    return 0;
+}
@@ -5,16 +5,29 @@
  ***********************************************************************************/
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include "nv_optical_flow.h"
-#include "nv_ov2640.h"
+#include "nv_global_motion.h"
+#include "nv_motion_gate.h"
+#include "nv_motion_class.h"
+#include "nv_watch.h"
+#include "nv_profile.h"
+#include "nv_mem_stats.h"
+#include "nv_telemetry.h"
+#include "nv_log.h"
+#include "nv_params.h"
+#include "nv_context.h"
+#include "nv_frame_source.h"
+#include "nv_jpeg.h"
+#include "frame1_rgb565.h"
+#include "frame2_rgb565.h"
 
 #define STBI_NO_STDIO
 
-#define MAX_BUFFER_SIZE (WIDTH * HEIGHT)
-#define PYR_SIZE (MAX_BUFFER_SIZE + (MAX_BUFFER_SIZE >> 2))
 #define Q15_SHIFT 14
 #define GRAD_SCALE_FACTOR (1 << Q15_SHIFT)
+#define STILL_Q14 (1 << (Q15_SHIFT - 2))    // tracked motion under 1/4 pixel teaches the motion gate
 
 typedef enum {
     OK,
@@ -23,111 +36,458 @@ typedef enum {
     LOAD_FAIL
 } status_t;
 
-typedef struct {
-    unsigned char *pyr[PYR_LEVELS];
-    int16_t *gradx[PYR_LEVELS];
-    int16_t *grady[PYR_LEVELS];
-    int32_t feature_point[2];
-    int valid_feature;
-} FrameData;
-
 /********************************************************************************//**
  * Static Functions
  ***********************************************************************************/
-static unsigned char pyr_buffer[PYR_SIZE];
-static unsigned char gray_buffer[MAX_BUFFER_SIZE];
+static NvContext ctx;
+static void *arena = NULL;
+static FILE *tlm_file = NULL;               // -t: the firmware's binary telemetry, for utils/nvtlm.py
+static NvTelemetry tlm;
+static NvTlmMotion tlm_motion;              // filled in while a frame is processed
+static MotionClass motion_class;
+static int events = 0;
 
+static int tlm_write(const uint8_t *data, uint32_t len) {
+    return fwrite(data, 1, len, tlm_file) == len ? (int)len : 0;
+}
 
-static int process_single_frame(int frame, FrameData *frame_data) {
-    uint16_t *img = NULL;
-    printf("%d: Processing frame\n", frame);
-    if (ov2640_capture_frame(&img, frame) == 1) {
-        printf("Error: Cannot load frame %d to RAM.\n", frame);
+/*
+ * The frame's result goes through the classifier; on a change an EVENT is
+ * printed and sent. A MOTION message per frame, as the firmware reports it,
+ * unless nv_params.events asks for events only.
+ */
+static void send_motion(int frame, nv_tlm_state_t state) {
+    int changed = 0;
+    if (state == NV_TLM_UP || state == NV_TLM_DOWN || state == NV_TLM_UNKNOWN) {
+        changed = motion_class_update(&motion_class, tlm_motion.dx, tlm_motion.dy, tlm_motion.confidence);
+    } else if (state == NV_TLM_STILL) {
+        changed = motion_class_update(&motion_class, 0, 0, tlm_motion.confidence);
+    } else {
+        motion_class_skip(&motion_class);
+    }
+    if (changed && nv_params.events != 0) {
+        const MotionClass *mc = &motion_class;
+        printf("%d: => Event %s (was %s for %u frames), %.2f px/frame, %.1f px/s, confidence %d\n", frame,
+               motion_class_name(mc->direction), motion_class_name(mc->previous), (unsigned)mc->duration,
+               mc->magnitude / (double)GRAD_SCALE_FACTOR, mc->speed / (double)GRAD_SCALE_FACTOR, mc->confidence);
+        events++;
+        if (tlm_file != NULL) {
+            NvTlmEvent e = { (uint32_t)frame, (uint8_t)mc->direction, (uint8_t)mc->previous, mc->confidence,
+                             mc->duration, mc->dx, mc->dy, mc->magnitude, mc->speed };
+            nv_tlm_send_event(&tlm, &e);
+        }
+    }
+    if (tlm_file != NULL && nv_params.events != 1) {
+        tlm_motion.frame = (uint32_t)frame;
+        tlm_motion.state = (uint8_t)state;
+        nv_tlm_send_motion(&tlm, &tlm_motion);
+    }
+    memset(&tlm_motion, 0, sizeof(tlm_motion));
+}
+
+static void send_profile(void) {
+    NvProfSummary s;
+    NvTlmProfile p;
+
+    if (tlm_file == NULL) return;
+    for (int i = 0; i < NV_PROF_NUM_STAGES; i++) {
+        if (!nv_profile_summary((nv_prof_stage_t)i, &s)) continue;
+        p.stage = (uint8_t)i;
+        p.unit = 0;
+        p.count = s.count;
+        p.min = s.min;
+        p.mean = s.mean;
+        p.p50 = s.p50;
+        p.p90 = s.p90;
+        p.p99 = s.p99;
+        p.max = s.max;
+        nv_tlm_send_profile(&tlm, &p);
+    }
+}
+
+static uint16_t saturate_u16(uint32_t v) {
+    return v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+static int setup_context(const FrameSource *src, int levels) {
+    if (!nv_context_init(&ctx, src->width, src->height, src->format, levels, NV_CTX_EXTERNAL_FRAMES)) {
+        printf("Error: cannot process %dx%d with %d pyramid levels\n", src->width, src->height, levels);
+        return INVALID_SIZE;
+    }
+    nv_context_report(&ctx, printf);
+    arena = nv_mem_alloc(nv_context_mem_required(&ctx), NV_MEM_TAG_ARENA);
+    if (!nv_context_bind(&ctx, arena, nv_context_mem_required(&ctx))) {
+        printf("Error: cannot allocate %u bytes\n", (unsigned)nv_context_mem_required(&ctx));
         return ERROR;
     }
-    rgb565_to_grayscale(img, gray_buffer, WIDTH, HEIGHT);
-    printf("%d: Converted frame to grayscale\n", frame);
-
-    // Build pyramid for current frame
-    frame_data->pyr[0] = pyr_buffer;
-    frame_data->pyr[1] = pyr_buffer + MAX_BUFFER_SIZE;
-    memcpy(frame_data->pyr[0], gray_buffer, WIDTH * HEIGHT);
-
-    for (int l = 1; l < PYR_LEVELS; l++) {
-        int w = WIDTH >> l;
-        int h = HEIGHT >> l;
-        build_image_pyramid(frame_data->pyr[l - 1], frame_data->pyr[l], w * 2, h * 2);
-        printf("%d: Built pyramid level %d (size: %dx%d)\n", frame, l, w, h);
-    }
-
-    static int16_t grad_buffer_local[PYR_SIZE * 2];
-    for (int l = 0; l < PYR_LEVELS; l++) {
-        int w = WIDTH >> l;
-        int h = HEIGHT >> l;
-        frame_data->gradx[l] = grad_buffer_local;
-        frame_data->grady[l] = grad_buffer_local + (w * h / 2);
-        compute_gradient(frame_data->pyr[l], frame_data->gradx[l], frame_data->grady[l], w, h);
-        printf("%d: Computed gradients, level %d\n", frame, l);
-    }
-
-    // Find specific feature point
-    if (frame == 1) {
-        frame_data->valid_feature = find_strong_feature(gray_buffer, WIDTH, HEIGHT, frame_data->feature_point);
-        if (!frame_data->valid_feature) {
-            frame_data->feature_point[0] = (WIDTH / 2) << Q15_SHIFT; // x
-            frame_data->feature_point[1] = (HEIGHT / 2) << Q15_SHIFT; // y
-            printf("No strong feature found for frame %d, using center (%d,%d)\n",
-                   frame, frame_data->feature_point[0] >> Q15_SHIFT, frame_data->feature_point[1] >> Q15_SHIFT);
+    return OK;
+}
+
+static int check_view_size(const FrameView *view) {
+    if (view->width != ctx.width || view->height != ctx.height) {
+        NV_LOGE("Error: frame %u is %dx%d, expected %dx%d\n", view->index, view->width, view->height, ctx.width, ctx.height);
+        return INVALID_SIZE;
+    }
+    return OK;
+}
+
+static int convert_view(const FrameView *view, FrameData *frame_data) {
+    NV_PROF_BEGIN(NV_PROF_CONVERT);
+    int converted = frame_view_to_gray(view, frame_data->pyr[0]);
+    NV_PROF_END(NV_PROF_CONVERT);
+    if (!converted) {
+        NV_LOGE("Error: frame %u cannot be decoded\n", view->index);
+        return LOAD_FAIL;
+    }
+    return OK;
+}
+
+/*
+ * converted: level 0 already holds the frame, decoded for the watch stage
+ */
+static int process_single_frame(const FrameView *view, FrameData *frame_data, int converted) {
+    int status = check_view_size(view);
+    if (status == OK && !converted) status = convert_view(view, frame_data);
+    if (status != OK) return status;
+
+    NV_PROF_BEGIN(NV_PROF_PYRAMID);
+    for (int l = 1; l < ctx.levels; l++) {
+        build_image_pyramid(frame_data->pyr[l - 1], frame_data->pyr[l], ctx.level_width[l - 1], ctx.level_height[l - 1]);
+    }
+    NV_PROF_END(NV_PROF_PYRAMID);
+    return OK;
+}
+
+/*
+ * Watch stage straight from the view. Uncoded frames are only sampled;
+ * coded ones are decoded whole into level 0, so a hand-over only needs the
+ * pyramid on top.
+ */
+static int watch_view(Watch *watch, const FrameView *view, FrameData *frame_data) {
+    int status = check_view_size(view);
+    int coded = view->format > PIXFMT_GRAY8;
+    if (status == OK && coded) status = convert_view(view, frame_data);
+    if (status != OK) return status;
+
+    NV_PROF_BEGIN(NV_PROF_WATCH);
+    if (coded) {
+        watch_sample_gray(watch, frame_data->pyr[0], ctx.width);
+    } else {
+        frame_view_sample_gray(view, watch->work, watch->step, watch->sample_width, watch->sample_height);
+    }
+    watch_update(watch);
+    NV_PROF_END(NV_PROF_WATCH);
+    return OK;
+}
+
+/*
+ * Features of a frame that becomes the reference for the next one
+ */
+static void prepare_reference(int frame, FrameData *frame_data) {
+    (void)frame;    // only the debug log uses it
+    NV_PROF_BEGIN(NV_PROF_FEATURES);
+    int found = find_multiple_features(frame_data->pyr[0], ctx.width, ctx.height, frame_data->feature_points, &frame_data->num_features);
+    NV_PROF_END(NV_PROF_FEATURES);
+    if (found) {
+        NV_LOGD("%d: Found %d features, strongest at (%d,%d)\n", frame, frame_data->num_features,
+               frame_data->feature_points[0][0] >> Q15_SHIFT, frame_data->feature_points[0][1] >> Q15_SHIFT);
+    } else {
+        // find_strong_feature() falls back to the centre itself
+        frame_data->num_features = 1;
+        if (find_strong_feature(frame_data->pyr[0], ctx.width, ctx.height, frame_data->feature_points[0])) {
+            NV_LOGD("%d: Found feature for frame at (%d,%d)\n",
+                   frame, frame_data->feature_points[0][0] >> Q15_SHIFT, frame_data->feature_points[0][1] >> Q15_SHIFT);
         } else {
-            printf("%d: Found feature for frame at (%d,%d)\n",
-                   frame, frame_data->feature_point[0] >> Q15_SHIFT, frame_data->feature_point[1] >> Q15_SHIFT);
+            NV_LOGD("No strong feature found for frame %d, using center (%d,%d)\n",
+                   frame, frame_data->feature_points[0][0] >> Q15_SHIFT, frame_data->feature_points[0][1] >> Q15_SHIFT);
         }
     }
+}
 
+static int calculate_motion(FrameData *prev_frame, FrameData *curr_frame, int32_t *dx, int32_t *dy) {
+    int32_t p0[MAX_FEATURES * 2], p1[MAX_FEATURES * 2];
+    uint8_t status[MAX_FEATURES];
+    GlobalMotion gm;
+    int n = prev_frame->num_features;
+
+    NV_PROF_BEGIN(NV_PROF_TRACK);
+    for (int i = 0; i < n; i++) {
+        p0[i * 2] = prev_frame->feature_points[i][0];
+        p0[i * 2 + 1] = prev_frame->feature_points[i][1];
+        status[i] = (uint8_t)lucas_kanade_pyramid(prev_frame->pyr, curr_frame->pyr,
+                                                  NULL, NULL,
+                                                  &p0[i * 2], &p1[i * 2], ctx.width, ctx.height, nv_params.levels);
+    }
+    NV_PROF_END(NV_PROF_TRACK);
+
+    NV_PROF_BEGIN(NV_PROF_MOTION);
+    int fitted = global_motion_estimate(p0, p1, status, n, GM_TRANSLATION, &gm, NULL);
+    NV_PROF_END(NV_PROF_MOTION);
+    tlm_motion.features = (uint8_t)n;
+    for (int i = 0; i < n; i++) tlm_motion.tracked += status[i] != 0;
+    if (!fitted) {
+        NV_LOGW("Optical flow failed\n");
+        *dx = *dy = 0;
+        return ERROR;
+    }
+    *dx = gm.m[2];
+    *dy = gm.m[5];
+    tlm_motion.inliers = (uint8_t)gm.inliers;
+    tlm_motion.confidence = gm.confidence;
+    tlm_motion.dx = gm.m[2];
+    tlm_motion.dy = gm.m[5];
+    NV_LOGD("Global motion: dx=%d dy=%d, %d/%d inliers, confidence %d\n",
+           gm.m[2], gm.m[5], gm.inliers, n, gm.confidence);
     return OK;
 }
 
-static int calculate_motion(FrameData *prev_frame, FrameData *curr_frame, int32_t p0[2], int32_t p1[2], int32_t *dy) {
-    printf("Calculating motion from prev to curr frame\n");
-    printf("Initial feature point: (%d,%d)\n", p0[0] >> Q15_SHIFT, p0[1] >> Q15_SHIFT);
-    int valid = lucas_kanade_pyramid(prev_frame->pyr, curr_frame->pyr,
-                                     prev_frame->gradx, prev_frame->grady,
-                                     p0, p1, WIDTH, HEIGHT, PYR_LEVELS);
-    if (!valid) {
-        printf("Optical flow failed\n");
-        *dy = 0;
-        return ERROR;
-    } else {
-        *dy = p1[1] - p0[1];
-        printf("Optical flow valid: (%d,%d)\n", p1[0] >> Q15_SHIFT, p1[1] >> Q15_SHIFT);
-        printf("Computed dy = %d (approx %d pixels)\n", *dy, *dy >> Q15_SHIFT);
-        return OK;
+/*
+ * Planned arena for a range of camera sizes, frames captured into the slots
+ */
+static void print_memory_plans(int levels) {
+    static const int sizes[][2] = { { 160, 90 }, { 160, 120 }, { 320, 240 }, { 640, 480 }, { 800, 600 }, { 1600, 1200 } };
+    NvContext plan_ctx;
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (nv_context_init(&plan_ctx, sizes[i][0], sizes[i][1], PIXFMT_RGB565, levels, 0)) {
+            nv_context_report(&plan_ctx, printf);
+        }
     }
+    nv_mem_budget_report(0, printf);
+}
+
+/*
+ * Optional trailing <width> <height> after the mode arguments
+ */
+static int parse_size(int argc, char **argv, int first, int *width, int *height) {
+    *width = (int)frame1_rgb565_width;
+    *height = (int)frame1_rgb565_height;
+    if (argc == first) return 1;
+    if (argc != first + 2) return 0;
+    *width = atoi(argv[first]);
+    *height = atoi(argv[first + 1]);
+    return *width > 0 && *height > 0;
+}
+
+static int open_source(int argc, char **argv, FrameSource *src) {
+    static const void *const test_frames[] = { frame1_rgb565, frame2_rgb565 };
+    pixfmt_t format;
+    int width, height;
+
+    if (argc < 2) {
+        return frame_source_open_arrays(src, test_frames, 2, frame1_rgb565_width, frame1_rgb565_height, PIXFMT_RGB565);
+    }
+    if (strcmp(argv[1], "raw") == 0 && argc >= 4 && pixfmt_from_name(argv[3], &format) &&
+        parse_size(argc, argv, 4, &width, &height)) {
+        return frame_source_open_raw(src, argv[2], width, height, format);
+    }
+    if (strcmp(argv[1], "seq") == 0 && (argc == 3 || argc == 4)) {
+        int reduction = argc == 4 ? atoi(argv[3]) : 8;
+        if (reduction != 8 && reduction != 4) return 0;
+        return frame_source_open_sequence(src, argv[2], reduction == 8 ? JPEG_SCALE_1_8 : JPEG_SCALE_1_4);
+    }
+    if (strcmp(argv[1], "synthetic") == 0 && (argc == 3 || argc == 5 || argc == 7) &&
+        parse_size(argc, argv, argc == 7 ? 5 : argc, &width, &height)) {
+        double vx = argc >= 5 ? atof(argv[3]) : 0.0;
+        double vy = argc >= 5 ? atof(argv[4]) : 1.0;
+        return frame_source_open_synthetic(src, width, height, PIXFMT_RGB565,
+                                           (int32_t)(vx * 256), (int32_t)(vy * 256), (uint32_t)atoi(argv[2]));
+    }
+    return 0;
 }
 
 /*********************************************************************************
  * Main function
  ***********************************************************************************/
-int main(void) {
-    ov2640_init(HEIGHT, WIDTH);
+int main(int argc, char **argv) {
+    FrameSource src;
+    FrameView view;
+
+    int levels = PYR_LEVELS;
+    int watch_timeout = 0;
+    int memory_report = 0;
+    const char *param_args[16];             // -P, applied once the context sets the levels
+    int num_params = 0;
+
+    nv_stack_paint();
+    nv_log_to_text(vprintf);
+    while (argc >= 2 && (strcmp(argv[1], "-m") == 0 ||
+                         (argc >= 3 && (strcmp(argv[1], "-l") == 0 || strcmp(argv[1], "-w") == 0 ||
+                                        strcmp(argv[1], "-t") == 0 || strcmp(argv[1], "-P") == 0)))) {
+        int used = 2;
+        if (argv[1][1] == 'm') {
+            memory_report = 1;
+            used = 1;
+        } else if (argv[1][1] == 'l') {
+            levels = atoi(argv[2]);
+        } else if (argv[1][1] == 'P') {
+            if (num_params == (int)(sizeof(param_args) / sizeof(param_args[0]))) {
+                printf("Error: too many -P\n");
+                return ERROR;
+            }
+            param_args[num_params++] = argv[2];
+        } else if (argv[1][1] == 't') {
+            if (tlm_file == NULL) tlm_file = fopen(argv[2], "wb");
+            if (tlm_file == NULL) {
+                printf("Error: cannot write telemetry to '%s'\n", argv[2]);
+                return ERROR;
+            }
+        } else {
+            watch_timeout = atoi(argv[2]);
+        }
+        argv[used] = argv[0];
+        argc -= used;
+        argv += used;
+    }
+    if (argc == 2 && strcmp(argv[1], "memplan") == 0) {
+        print_memory_plans(levels);
+        return OK;
+    }
+    if (!open_source(argc, argv, &src)) {
+        printf("Usage: %s [-l levels] [-w timeout] [-m] [-t file] [-P name=value]... <mode>\n"
+               "  -m                              print stack high water and allocations at the end\n"
+               "  -P name=value                   set a tracker parameter, -P list shows them, see nv_params.h\n"
+               "  -t file                         write the binary telemetry and tokenized log, decode with utils/nvtlm.py\n"
+               "  -w timeout                      watch a tiny image until it changes, track until timeout frames without motion\n"
+               "  (none)                          replay the compiled-in frames\n"
+               "  raw <file> <format> [w h]       raw sequence, format rgb565 | yuyv | gray8, default %ux%u\n"
+               "  seq <file.nvsq> [8|4]           NVSQ container, see utils/nvsq.py; JPEG frames at 1/8 or 1/4 size\n"
+               "  synthetic <n> [dx dy [w h]]     moving pattern, dx/dy in pixels per frame\n"
+               "  memplan                         print the arena for common capture sizes\n",
+               argv[0], frame1_rgb565_width, frame1_rgb565_height);
+        return ERROR;
+    }
     printf("Hello from Windows\nStarting...\n");
+    nv_tlm_init(&tlm, tlm_write);
+    if (tlm_file != NULL) nv_log_to_telemetry(&tlm);
+    if (setup_context(&src, levels) != OK) {
+        frame_source_close(&src);
+        nv_mem_free(arena);
+        return ERROR;
+    }
+    nv_params_init(ctx.levels);
+    for (int i = 0; i < num_params; i++) {
+        if (!nv_params_command(strcmp(param_args[i], "list") == 0 ? "" : param_args[i], printf)) {
+            frame_source_close(&src);
+            nv_mem_free(arena);
+            return ERROR;
+        }
+    }
+    nv_params_apply();
+    FrameData *frames = ctx.frames;
+    Watch watch;
+    if (watch_timeout > 0 && !watch_init(&watch, ctx.width, ctx.height, watch_timeout)) {
+        printf("Frame %dx%d too small to watch, tracking only\n", ctx.width, ctx.height);
+    }
 
-    FrameData frame1_data, frame2_data;
-    int32_t dy = 0;
+    int cur = 0, have_reference = 0;
+    int up = 0, down = 0, unknown = 0, still = 0, watched = 0;
+    int32_t dx = 0, dy = 0;
+    MotionGate gate;
+    motion_gate_init(&gate);
+    motion_class_init(&motion_class);
 
-    process_single_frame(1, &frame1_data);
-    process_single_frame(2, &frame2_data);
-    calculate_motion(&frame1_data, &frame2_data, frame1_data.feature_point, frame2_data.feature_point, &dy);
+    nv_profile_init();
+    // continue skips to the increment, so every frame that got through
+    // conversion or the watch stage is timed
+    for (; frame_source_next(&src, &view); NV_PROF_END(NV_PROF_FRAME)) {
+        NV_PROF_BEGIN(NV_PROF_FRAME);
+        int frame = (int)view.index + 1;
+        // While watching only the watch image is made; the frame is
+        // converted and its pyramid built once the watch sees motion
+        int watching = watch_timeout > 0 && watch.mode == WATCH_WATCHING;
+        int status = watching ? watch_view(&watch, &view, &frames[cur]) : OK;
+        if (status == OK && (!watching || watch.mode != WATCH_WATCHING)) {
+            status = process_single_frame(&view, &frames[cur], watching && view.format > PIXFMT_GRAY8);
+        }
+        frame_source_release(&src, &view);
+        if (status != OK) break;
 
-    const int16_t THRESHOLD = 205; // 0.0125 in Q15
-    if (dy > THRESHOLD) {
-        printf("=> Up\n");
-    } else if (dy < -THRESHOLD) {
-        printf("=> Down\n");
-    } else {
-        printf("=> Unknown\n");
+        if (watching) {
+            tlm_motion.change_q8 = saturate_u16(watch.change_q8);
+            tlm_motion.threshold_q8 = saturate_u16(watch.threshold_q8);
+            if (watch.mode == WATCH_WATCHING) {
+                printf("%d: => Watching %dx%d (change %u/256, threshold %u/256)\n", frame, watch.width, watch.height,
+                       (unsigned)watch.change_q8, (unsigned)watch.threshold_q8);
+                send_motion(frame, NV_TLM_WATCHING);
+                watched++;
+                continue;
+            }
+            // This frame becomes the first reference of full tracking
+            printf("%d: => Watch saw motion, shift (%d,%d), tracking\n", frame, watch.dx, watch.dy);
+            tlm_motion.flags |= NV_TLM_FLAG_WATCH_ALARM;
+            tlm_motion.dx = watch.dx * (1 << Q15_SHIFT);
+            tlm_motion.dy = watch.dy * (1 << Q15_SHIFT);
+            have_reference = 0;
+        }
+        if (have_reference) {
+            // Static scene: keep the reference and its features, and let the
+            // next frame reuse this slot
+            int top = ctx.levels - 1;
+            NV_PROF_BEGIN(NV_PROF_GATE);
+            int gate_moving = motion_gate_update(&gate, frames[cur ^ 1].pyr[top], frames[cur].pyr[top],
+                                                 ctx.level_width[top], ctx.level_height[top]);
+            NV_PROF_END(NV_PROF_GATE);
+            if (!gate_moving) {
+                printf("%d: => No motion, confidence %d (difference %u/256, threshold %u/256)\n",
+                       frame, gate.confidence, (unsigned)gate.mad_q8, (unsigned)gate.threshold_q8);
+                still++;
+                tlm_motion.confidence = (uint8_t)gate.confidence;
+                if (watch_timeout > 0 && !watch_track_result(&watch, 0)) {
+                    printf("%d: => Back to watching\n", frame);
+                    tlm_motion.flags |= NV_TLM_FLAG_BACK_TO_WATCH;
+                }
+                send_motion(frame, NV_TLM_STILL);
+                continue;
+            }
+            int moved = 0;
+            nv_tlm_state_t state = NV_TLM_UNKNOWN;
+            if (calculate_motion(&frames[cur ^ 1], &frames[cur], &dx, &dy) != OK) {
+                dx = dy = 0;
+                state = NV_TLM_FAILED;
+            } else if (dx > -STILL_Q14 && dx < STILL_Q14 && dy > -STILL_Q14 && dy < STILL_Q14) {
+                motion_gate_learn_static(&gate);
+            } else {
+                moved = 1;
+            }
+            if (dy > nv_params.threshold) {
+                printf("%d: => Up\n", frame);
+                state = NV_TLM_UP;
+                up++;
+            } else if (dy < -nv_params.threshold) {
+                printf("%d: => Down\n", frame);
+                state = NV_TLM_DOWN;
+                down++;
+            } else {
+                printf("%d: => Unknown\n", frame);
+                unknown++;
+            }
+            if (watch_timeout > 0 && !watch_track_result(&watch, moved)) {
+                printf("%d: => Back to watching\n", frame);
+                tlm_motion.flags |= NV_TLM_FLAG_BACK_TO_WATCH;
+                send_motion(frame, state);
+                continue;
+            }
+            send_motion(frame, state);
+        } else {
+            send_motion(frame, NV_TLM_NO_REFERENCE);
+        }
+        prepare_reference(frame, &frames[cur]);
+        have_reference = 1;
+        cur ^= 1;
     }
-    printf("Final dy=%d\n", dy);
+    frame_source_close(&src);
+    nv_mem_free(arena);
 
+    printf("Frames: %u, Up: %d, Down: %d, Unknown: %d, No motion: %d, Watching: %d\n", src.next_index, up, down, unknown, still, watched);
+    printf("Final dy=%d\n", dy);
+    if (nv_params.events != 0) printf("Events: %d, final state %s\n", events, motion_class_name(motion_class.direction));
+    nv_profile_report(printf);
+    if (memory_report) nv_mem_report(printf);
+    if (tlm_file != NULL) {
+        send_profile();
+        fclose(tlm_file);
+        printf("Telemetry: %lu messages, %lu dropped\n", (unsigned long)tlm.sent, (unsigned long)tlm.dropped);
+    }
     return 0;
-}
\ No newline at end of file
+}
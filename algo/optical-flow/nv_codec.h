@@ -0,0 +1,37 @@
+/*
+ * nv_codec.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * DRLE, a delta + run-length code for stored RGB565 frames (written by
+ * utils/nvsq.py pack --format rgb565-drle). Pixels are coded in raster order
+ * against the previous pixel, which starts at 0 for every frame. Channel
+ * arithmetic wraps (5/6/5 bits), so the code is lossless unless the packer
+ * was given a tolerance. Each token starts with one byte:
+ *
+ *   00nnnnnn              RUN: previous pixel n + 1 more times (1..64)
+ *   01rrggbb              DIFF: one pixel, dr dg db in -2..1, stored +2
+ *   10gggggg rrrrbbbb     DELTA: one pixel, dg in -32..31 stored +32,
+ *                         dr db in -8..7 stored +8
+ *   11nnnnnn p0 .. pn     LITERAL: n + 1 raw little-endian RGB565 pixels
+ *
+ * The decoder writes gray directly: there is no RGB565 buffer, and a run
+ * repeats the gray value it already has instead of converting again.
+ */
+#ifndef NV_CODEC_H_
+#define NV_CODEC_H_
+#include <stdint.h>
+
+#define DRLE_OP_RUN 0x00
+#define DRLE_OP_DIFF 0x40
+#define DRLE_OP_DELTA 0x80
+#define DRLE_OP_LITERAL 0xC0
+#define DRLE_MAX_COUNT 64
+
+// Worst case coded size of a frame: every pixel in a literal run
+#define DRLE_MAX_BYTES(pixels) ((pixels) * 2 + ((pixels) + DRLE_MAX_COUNT - 1) / DRLE_MAX_COUNT)
+
+int drle_decode_gray(const uint8_t *in, uint32_t size, unsigned char *gray, uint32_t pixels);
+
+#endif /* NV_CODEC_H_ */
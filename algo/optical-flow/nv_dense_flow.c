@@ -0,0 +1,240 @@
+#include "nv_dense_flow.h"
+#include <stdlib.h>
+#ifdef NV_DENSE_THREADS
+#include <pthread.h>
+#endif
+
+#define DENSE_MIN_DET 1000
+#define DENSE_EPS (1 << (Q15_SHIFT - DENSE_FLOW_SHIFT))   // stop below output resolution
+#define DENSE_GRAD_GAIN_SHIFT 2     // compute_gradient() yields 4x the derivative
+
+/*
+ * Number of int16_t entries needed for the flow field of a width x height frame
+ */
+int dense_flow_field_size(int width, int height) {
+    return (width / DENSE_BLOCK_SIZE) * (height / DENSE_BLOCK_SIZE) * 2;
+}
+
+int dense_flow_init(DenseFlowField *field, int16_t *buffer, int width, int height) {
+    field->cols = width / DENSE_BLOCK_SIZE;
+    field->rows = height / DENSE_BLOCK_SIZE;
+    field->flow = buffer;
+    if (buffer == NULL || field->cols == 0 || field->rows == 0) return 0;
+    for (int i = 0; i < field->cols * field->rows * 2; i++) {
+        buffer[i] = DENSE_FLOW_INVALID;
+    }
+    return 1;
+}
+
+int dense_flow_num_tiles(const DenseFlowField *field) {
+    return (field->rows + DENSE_TILE_ROWS - 1) / DENSE_TILE_ROWS;
+}
+
+/*
+ * Bilinear sample of img at (x, y) given in Q14, result in Q8
+ */
+static int32_t sample_q8(const unsigned char *img, int width, int32_t x, int32_t y) {
+    int ix = x >> Q15_SHIFT, iy = y >> Q15_SHIFT;
+    int fx = (x >> (Q15_SHIFT - 8)) & 0xFF, fy = (y >> (Q15_SHIFT - 8)) & 0xFF;
+    const unsigned char *p = img + iy * width + ix;
+    int32_t top = p[0] * (256 - fx) + p[1] * fx;
+    int32_t bottom = p[width] * (256 - fx) + p[width + 1] * fx;
+    return (top * (256 - fy) + bottom * fy) >> 8;
+}
+
+/*
+ * num / det for a Q8 mismatch vector, returned in Q14 pixels
+ */
+static int32_t solve_q14(int64_t num, int64_t det) {
+    const int shift = Q15_SHIFT - 8 + DENSE_GRAD_GAIN_SHIFT;
+    while (num > (INT64_MAX >> shift) || num < -(INT64_MAX >> shift)) {
+        num >>= 1;
+        det >>= 1;
+    }
+    int64_t q = (num << shift) / det;
+    if (q > (1 << 27)) q = 1 << 27;
+    if (q < -(1 << 27)) q = -(1 << 27);
+    return (int32_t)q;
+}
+
+/*
+ * Coarse-to-fine LK for the block centred at (cx, cy). The structure tensor is
+ * built once per level; only the mismatch vector is recomputed per iteration.
+ */
+static int dense_flow_block(const DenseFlowInput *in, int cx, int cy, int32_t *u_out, int32_t *v_out) {
+    int32_t u = 0, v = 0; // Q14, in pixels of the current level
+
+    for (int l = in->levels - 1; l >= 0; l--) {
+        int w = in->width >> l, h = in->height >> l;
+        int x = cx >> l, y = cy >> l;
+        const unsigned char *I = in->pyr1[l];
+        const unsigned char *J = in->pyr2[l];
+        const int16_t *gx = in->gradx[l];
+        const int16_t *gy = in->grady[l];
+
+        if (l != in->levels - 1) {
+            u <<= 1;
+            v <<= 1;
+        }
+
+        // clip the window to the region where gradients are defined
+        int x0 = x - DENSE_RADIUS, x1 = x + DENSE_RADIUS;
+        int y0 = y - DENSE_RADIUS, y1 = y + DENSE_RADIUS;
+        if (x0 < 1) x0 = 1;
+        if (y0 < 1) y0 = 1;
+        if (x1 > w - 2) x1 = w - 2;
+        if (y1 > h - 2) y1 = h - 2;
+        if (x0 > x1 || y0 > y1) {
+            if (l == 0) return 0;
+            continue;
+        }
+
+        int32_t sum_xx = 0, sum_xy = 0, sum_yy = 0;
+        for (int py = y0; py <= y1; py++) {
+            for (int px = x0; px <= x1; px++) {
+                int32_t Ix = gx[py * w + px];
+                int32_t Iy = gy[py * w + px];
+                sum_xx += Ix * Ix;
+                sum_xy += Ix * Iy;
+                sum_yy += Iy * Iy;
+            }
+        }
+        int64_t det = (int64_t)sum_xx * sum_yy - (int64_t)sum_xy * sum_xy;
+        if (det < DENSE_MIN_DET) {
+            // textureless at this level: keep the guess, give up only at full resolution
+            if (l == 0) return 0;
+            continue;
+        }
+
+        for (int iter = 0; iter < NUM_ITER; iter++) {
+            int64_t bx = 0, by = 0;
+            for (int py = y0; py <= y1; py++) {
+                int32_t qy = (py << Q15_SHIFT) + v;
+                if (qy < 0 || (qy >> Q15_SHIFT) >= h - 1) continue;
+                for (int px = x0; px <= x1; px++) {
+                    int32_t qx = (px << Q15_SHIFT) + u;
+                    if (qx < 0 || (qx >> Q15_SHIFT) >= w - 1) continue;
+                    int32_t It = sample_q8(J, w, qx, qy) - (I[py * w + px] << 8);
+                    bx += (int64_t)gx[py * w + px] * It;
+                    by += (int64_t)gy[py * w + px] * It;
+                }
+            }
+
+            int32_t du = solve_q14((int64_t)sum_xy * by - (int64_t)sum_yy * bx, det);
+            int32_t dv = solve_q14((int64_t)sum_xy * bx - (int64_t)sum_xx * by, det);
+            u += du;
+            v += dv;
+            if (abs(du) < DENSE_EPS && abs(dv) < DENSE_EPS) break;
+        }
+
+        if (abs(u >> Q15_SHIFT) >= w || abs(v >> Q15_SHIFT) >= h) return 0;
+    }
+
+    *u_out = u;
+    *v_out = v;
+    return 1;
+}
+
+static int16_t to_flow16(int32_t q14) {
+    int32_t f = q14 >> (Q15_SHIFT - DENSE_FLOW_SHIFT);
+    if (f > INT16_MAX) f = INT16_MAX;
+    if (f <= DENSE_FLOW_INVALID) f = DENSE_FLOW_INVALID + 1;
+    return (int16_t)f;
+}
+
+/*
+ * Compute the vectors of one tile (DENSE_TILE_ROWS block rows).
+ * Returns the number of valid blocks in the tile.
+ */
+int dense_flow_compute_tile(const DenseFlowInput *in, DenseFlowField *field, int tile) {
+    int row_begin = tile * DENSE_TILE_ROWS;
+    int row_end = row_begin + DENSE_TILE_ROWS;
+    int valid = 0;
+    if (row_end > field->rows) row_end = field->rows;
+
+    for (int by = row_begin; by < row_end; by++) {
+        int16_t *out = field->flow + by * field->cols * 2;
+        for (int bx = 0; bx < field->cols; bx++) {
+            int32_t u, v;
+            int cx = bx * DENSE_BLOCK_SIZE + DENSE_BLOCK_SIZE / 2;
+            int cy = by * DENSE_BLOCK_SIZE + DENSE_BLOCK_SIZE / 2;
+            if (dense_flow_block(in, cx, cy, &u, &v)) {
+                out[bx * 2] = to_flow16(u);
+                out[bx * 2 + 1] = to_flow16(v);
+                valid++;
+            } else {
+                out[bx * 2] = DENSE_FLOW_INVALID;
+                out[bx * 2 + 1] = DENSE_FLOW_INVALID;
+            }
+        }
+    }
+    return valid;
+}
+
+#ifdef NV_DENSE_THREADS
+typedef struct {
+    const DenseFlowInput *in;
+    DenseFlowField *field;
+    int first_tile;
+    int stride;
+    int valid;
+} DenseWorker;
+
+static void *dense_flow_worker(void *arg) {
+    DenseWorker *wk = (DenseWorker *)arg;
+    int tiles = dense_flow_num_tiles(wk->field);
+    wk->valid = 0;
+    for (int t = wk->first_tile; t < tiles; t += wk->stride) {
+        wk->valid += dense_flow_compute_tile(wk->in, wk->field, t);
+    }
+    return NULL;
+}
+#endif
+
+/*
+ * Compute the whole field. Tiles are distributed round-robin over num_threads
+ * workers when built with NV_DENSE_THREADS, otherwise they run in order on
+ * the calling thread. Returns the number of valid blocks.
+ */
+int dense_flow_compute(const DenseFlowInput *in, DenseFlowField *field, int num_threads) {
+    int tiles = dense_flow_num_tiles(field);
+    int valid = 0;
+    if (num_threads > DENSE_MAX_THREADS) num_threads = DENSE_MAX_THREADS;
+    if (num_threads > tiles) num_threads = tiles;
+
+#ifdef NV_DENSE_THREADS
+    if (num_threads > 1) {
+        pthread_t threads[DENSE_MAX_THREADS];
+        DenseWorker workers[DENSE_MAX_THREADS];
+        int started[DENSE_MAX_THREADS] = {0};
+
+        for (int i = 0; i < num_threads; i++) {
+            workers[i].in = in;
+            workers[i].field = field;
+            workers[i].first_tile = i;
+            workers[i].stride = num_threads;
+            workers[i].valid = 0;
+        }
+        for (int i = 1; i < num_threads; i++) {
+            started[i] = pthread_create(&threads[i], NULL, dense_flow_worker, &workers[i]) == 0;
+        }
+        dense_flow_worker(&workers[0]);
+        for (int i = 1; i < num_threads; i++) {
+            if (started[i]) {
+                pthread_join(threads[i], NULL);
+            } else {
+                dense_flow_worker(&workers[i]); // could not spawn, run it here
+            }
+        }
+        for (int i = 0; i < num_threads; i++) {
+            valid += workers[i].valid;
+        }
+        return valid;
+    }
+#endif
+
+    for (int t = 0; t < tiles; t++) {
+        valid += dense_flow_compute_tile(in, field, t);
+    }
+    return valid;
+}
@@ -0,0 +1,49 @@
+/*
+ * nv_dense_flow.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Semi-dense optical flow: one motion vector per DENSE_BLOCK_SIZE x DENSE_BLOCK_SIZE
+ * block, computed coarse-to-fine from the two frames' pyramids. The sparse
+ * pipeline no longer builds gradient planes, so the caller must run
+ * compute_gradient() on every level of the previous frame and pass all of
+ * them in gradx/grady. The field is split into tiles of block rows so it can
+ * be computed by several threads on the host (NV_DENSE_THREADS).
+ *
+ * Host only, and exercised by the -dense rows of accuracy.exe and the
+ * dense_flow rows of bench.exe.
+ */
+#ifndef NV_DENSE_FLOW_H_
+#define NV_DENSE_FLOW_H_
+#include <stdint.h>
+#include "nv_optical_flow.h"
+
+#define DENSE_BLOCK_SIZE 8
+#define DENSE_RADIUS (DENSE_BLOCK_SIZE / 2)
+#define DENSE_TILE_ROWS 4           // block rows per tile
+#define DENSE_FLOW_SHIFT 5          // output vectors are in 1/32 pixel
+#define DENSE_FLOW_INVALID INT16_MIN
+#define DENSE_MAX_THREADS 16
+
+typedef struct {
+    unsigned char **pyr1;           // previous frame pyramid, level 0 first
+    unsigned char **pyr2;           // current frame pyramid
+    int16_t **gradx;                // gradients of pyr1
+    int16_t **grady;
+    int width, height;              // level 0 size
+    int levels;
+} DenseFlowInput;
+
+typedef struct {
+    int16_t *flow;                  // (dx, dy) pairs, row-major, DENSE_FLOW_SHIFT fraction bits
+    int cols, rows;                 // blocks per row / column
+} DenseFlowField;
+
+int dense_flow_field_size(int width, int height);
+int dense_flow_init(DenseFlowField *field, int16_t *buffer, int width, int height);
+int dense_flow_num_tiles(const DenseFlowField *field);
+int dense_flow_compute_tile(const DenseFlowInput *in, DenseFlowField *field, int tile);
+int dense_flow_compute(const DenseFlowInput *in, DenseFlowField *field, int num_threads);
+
+#endif /* NV_DENSE_FLOW_H_ */
@@ -0,0 +1,62 @@
+#include "nv_file_map.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * Map path read-only. Returns 1 on success; empty files cannot be mapped.
+ */
+int map_file(const char *path, MappedFile *mf) {
+    mf->data = NULL;
+    mf->size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return 0;
+    // the view keeps the mapping alive after its handle is closed
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) return 0;
+    mf->data = (const uint8_t *)view;
+    mf->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return 0;
+    posix_madvise(view, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    mf->data = (const uint8_t *)view;
+    mf->size = (size_t)st.st_size;
+#endif
+    return 1;
+}
+
+void unmap_file(MappedFile *mf) {
+    if (mf->data == NULL) return;
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)mf->data);
+#else
+    munmap((void *)mf->data, mf->size);
+#endif
+    mf->data = NULL;
+    mf->size = 0;
+}
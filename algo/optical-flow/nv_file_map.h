@@ -0,0 +1,23 @@
+/*
+ * nv_file_map.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Read-only memory mapping of a whole file (mmap on POSIX, a file mapping
+ * view on Windows). Host build only.
+ */
+#ifndef NV_FILE_MAP_H_
+#define NV_FILE_MAP_H_
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+} MappedFile;
+
+int map_file(const char *path, MappedFile *mf);
+void unmap_file(MappedFile *mf);
+
+#endif /* NV_FILE_MAP_H_ */
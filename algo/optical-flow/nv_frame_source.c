@@ -0,0 +1,293 @@
+#include "nv_frame_source.h"
+#include "nv_optical_flow.h"
+#include "nv_codec.h"
+#include "nv_jpeg.h"
+#include "nv_mem_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNTH_SEED 0x9E3779B9u
+
+int pixfmt_from_name(const char *name, pixfmt_t *format) {
+    if (strcmp(name, "rgb565") == 0) {
+        *format = PIXFMT_RGB565;
+    } else if (strcmp(name, "yuyv") == 0 || strcmp(name, "yuv") == 0) {
+        *format = PIXFMT_YUYV;
+    } else if (strcmp(name, "gray8") == 0 || strcmp(name, "gray") == 0) {
+        *format = PIXFMT_GRAY8;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static void set_view(FrameSource *src, FrameView *view, const uint8_t *data, uint32_t size) {
+    view->data = data;
+    view->size = size;
+    view->width = src->width;
+    view->height = src->height;
+    view->stride = src->width * pixfmt_bytes_per_pixel(src->format);
+    view->format = src->format;
+    view->jpeg_scale = src->jpeg_scale;
+    view->index = src->next_index++;
+}
+
+static void init_source(FrameSource *src, const FrameSourceOps *ops, int width, int height, pixfmt_t format) {
+    memset(src, 0, sizeof(*src));
+    src->ops = ops;
+    src->width = width;
+    src->height = height;
+    src->format = format;
+}
+
+static void release_nothing(FrameSource *src, FrameView *view) {
+    (void)src;
+    view->data = NULL;
+}
+
+/*
+ * Compiled-in arrays
+ */
+static int arrays_next(FrameSource *src, FrameView *view) {
+    if (src->next_index >= src->num_frames) return 0;
+    set_view(src, view, (const uint8_t *)src->frames[src->next_index],
+             (uint32_t)src->width * src->height * pixfmt_bytes_per_pixel(src->format));
+    return 1;
+}
+
+static void arrays_close(FrameSource *src) {
+    src->frames = NULL;
+}
+
+static const FrameSourceOps arrays_ops = { arrays_next, release_nothing, arrays_close };
+
+int frame_source_open_arrays(FrameSource *src, const void *const *frames, uint32_t count,
+                             int width, int height, pixfmt_t format) {
+    init_source(src, &arrays_ops, width, height, format);
+    src->frames = frames;
+    src->num_frames = count;
+    return frames != NULL && count > 0;
+}
+
+/*
+ * Raw frame sequence file: frames back to back, no header
+ */
+static int raw_next(FrameSource *src, FrameView *view) {
+    size_t frame_bytes = (size_t)src->width * src->height * pixfmt_bytes_per_pixel(src->format);
+    if (src->next_index >= src->num_frames) return 0;
+    set_view(src, view, src->file.data + frame_bytes * src->next_index, (uint32_t)frame_bytes);
+    return 1;
+}
+
+static void raw_close(FrameSource *src) {
+    unmap_file(&src->file);
+}
+
+static const FrameSourceOps raw_ops = { raw_next, release_nothing, raw_close };
+
+int frame_source_open_raw(FrameSource *src, const char *path, int width, int height, pixfmt_t format) {
+    init_source(src, &raw_ops, width, height, format);
+    if (width <= 0 || height <= 0 || !map_file(path, &src->file)) return 0;
+    src->num_frames = (uint32_t)(src->file.size / ((size_t)width * height * pixfmt_bytes_per_pixel(format)));
+    if (src->num_frames == 0) {
+        unmap_file(&src->file);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * NVSQ container file, walked in place through the mapping
+ */
+static int sequence_next(FrameSource *src, FrameView *view) {
+    uint32_t size;
+    const uint8_t *data = nvsq_frame(&src->seq, src->next_index, &size);
+    if (data == NULL) return 0;
+    set_view(src, view, data, size);
+    return 1;
+}
+
+static const FrameSourceOps sequence_ops = { sequence_next, release_nothing, raw_close };
+
+/*
+ * JPEG frames are decoded at 1/(1 << jpeg_scale) size, which becomes the
+ * size of the source. Each frame must be a JPEG of the size in the header.
+ */
+static int check_jpeg_frames(const NvSequence *seq) {
+    for (uint32_t i = 0; i < seq->hdr->frame_count; i++) {
+        uint32_t size;
+        const uint8_t *data = nvsq_frame(seq, i, &size);
+        int width, height;
+        if (!jpeg_read_size(data, size, &width, &height) || width != seq->hdr->width || height != seq->hdr->height) return 0;
+    }
+    return 1;
+}
+
+int frame_source_open_sequence(FrameSource *src, const char *path, int jpeg_scale) {
+    init_source(src, &sequence_ops, 0, 0, PIXFMT_RGB565);
+    if (!map_file(path, &src->file)) return 0;
+    if (src->file.size > UINT32_MAX || !nvsq_open_memory(&src->seq, src->file.data, (uint32_t)src->file.size)) {
+        unmap_file(&src->file);
+        return 0;
+    }
+
+    // Every frame must hold a full uncompressed image; coded frames are
+    // checked as they are decoded
+    const NvSeqHeader *hdr = src->seq.hdr;
+    size_t frame_bytes = (size_t)hdr->width * hdr->height * pixfmt_bytes_per_pixel((pixfmt_t)hdr->format);
+    int valid = hdr->format <= NVSQ_FMT_JPEG && frame_bytes > 0;
+    if (hdr->format == NVSQ_FMT_RGB565_DRLE || hdr->format == NVSQ_FMT_JPEG) frame_bytes = 1;
+    for (uint32_t i = 0; valid && i < hdr->frame_count; i++) {
+        valid = src->seq.index[i + 1] - src->seq.index[i] >= frame_bytes;
+    }
+    if (valid && hdr->format == NVSQ_FMT_JPEG) {
+        valid = (jpeg_scale == JPEG_SCALE_1_8 || jpeg_scale == JPEG_SCALE_1_4) && check_jpeg_frames(&src->seq);
+        src->jpeg_scale = jpeg_scale;
+    }
+    if (!valid) {
+        unmap_file(&src->file);
+        return 0;
+    }
+    src->width = hdr->width >> src->jpeg_scale;
+    src->height = hdr->height >> src->jpeg_scale;
+    src->format = (pixfmt_t)hdr->format;
+    src->num_frames = hdr->frame_count;
+    return 1;
+}
+
+/*
+ * Synthetic moving pattern: two octaves of value noise, translated by
+ * (vx, vy) per frame. The noise is evaluated at Q8 coordinates, so sub-pixel
+ * motion is exact.
+ */
+static uint8_t lattice(int32_t ix, int32_t iy, uint32_t seed) {
+    uint32_t h = ((uint32_t)ix * 0x8DA6B343u) ^ ((uint32_t)iy * 0xD8163841u) ^ seed;
+    h ^= h >> 13;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 16;
+    return (uint8_t)h;
+}
+
+static int noise_q8(int32_t x, int32_t y, int cell_shift, uint32_t seed) {
+    int s = 8 + cell_shift;
+    int32_t ix = x >> s, iy = y >> s;
+    int32_t fx = (x - ix * (1 << s)) >> cell_shift;   // Q8 fraction within the cell
+    int32_t fy = (y - iy * (1 << s)) >> cell_shift;
+    int32_t top = lattice(ix, iy, seed) * (256 - fx) + lattice(ix + 1, iy, seed) * fx;
+    int32_t bottom = lattice(ix, iy + 1, seed) * (256 - fx) + lattice(ix + 1, iy + 1, seed) * fx;
+    return (top * (256 - fy) + bottom * fy) >> 16;
+}
+
+static int synthetic_next(FrameSource *src, FrameView *view) {
+    if (src->num_frames != 0 && src->next_index >= src->num_frames) return 0;
+    int32_t ox = src->vx * (int32_t)src->next_index;
+    int32_t oy = src->vy * (int32_t)src->next_index;
+    uint8_t *out = src->render;
+
+    for (int y = 0; y < src->height; y++) {
+        for (int x = 0; x < src->width; x++) {
+            int32_t px = (x << 8) - ox, py = (y << 8) - oy;
+            int g = (2 * noise_q8(px, py, 4, src->seed) + noise_q8(px, py, 2, src->seed ^ SYNTH_SEED)) / 3;
+            int i = y * src->width + x;
+            if (src->format == PIXFMT_GRAY8) {
+                out[i] = (uint8_t)g;
+            } else if (src->format == PIXFMT_RGB565) {
+                uint16_t p = (uint16_t)(((g >> 3) << 11) | ((g >> 2) << 5) | (g >> 3));
+                out[i * 2] = (uint8_t)p;
+                out[i * 2 + 1] = (uint8_t)(p >> 8);
+            } else {
+                out[i * 2] = (uint8_t)g;
+                out[i * 2 + 1] = 128;
+            }
+        }
+    }
+    set_view(src, view, out, (uint32_t)src->width * src->height * pixfmt_bytes_per_pixel(src->format));
+    return 1;
+}
+
+static void synthetic_close(FrameSource *src) {
+    nv_mem_free(src->render);
+    src->render = NULL;
+}
+
+static const FrameSourceOps synthetic_ops = { synthetic_next, release_nothing, synthetic_close };
+
+int frame_source_open_synthetic(FrameSource *src, int width, int height, pixfmt_t format,
+                                int32_t vx_q8, int32_t vy_q8, uint32_t count) {
+    init_source(src, &synthetic_ops, width, height, format);
+    if (width <= 0 || height <= 0) return 0;
+    src->render = (uint8_t *)nv_mem_alloc((uint32_t)width * height * pixfmt_bytes_per_pixel(format), NV_MEM_TAG_FRAMES);
+    src->vx = vx_q8;
+    src->vy = vy_q8;
+    src->num_frames = count;
+    src->seed = SYNTH_SEED;
+    return src->render != NULL;
+}
+
+/*
+ * Common entry points
+ */
+int frame_source_next(FrameSource *src, FrameView *view) {
+    return src->ops->next(src, view);
+}
+
+void frame_source_release(FrameSource *src, FrameView *view) {
+    src->ops->release(src, view);
+}
+
+void frame_source_close(FrameSource *src) {
+    src->ops->close(src);
+}
+
+/*
+ * gray may point at view->data for uncoded formats: rows are compacted front
+ * to back, so the conversion also works in place on a capture buffer. Coded
+ * frames are decoded and converted in the same pass. Returns 0 on a corrupt
+ * coded frame.
+ */
+int frame_view_to_gray(const FrameView *view, unsigned char *gray) {
+    if (view->format == PIXFMT_RGB565_DRLE) {
+        return drle_decode_gray(view->data, view->size, gray, (uint32_t)view->width * view->height);
+    }
+    if (view->format == PIXFMT_JPEG) {
+        return jpeg_decode_gray(view->data, view->size, view->jpeg_scale, gray, view->width, view->height);
+    }
+    for (int y = 0; y < view->height; y++) {
+        const uint8_t *row = view->data + y * view->stride;
+        unsigned char *out = gray + y * view->width;
+        if (view->format == PIXFMT_RGB565) {
+            rgb565_to_grayscale((const uint16_t *)row, out, view->width, 1);
+        } else if (view->format == PIXFMT_YUYV) {
+            for (int x = 0; x < view->width; x++) out[x] = row[x * 2];
+        } else if (out != row) {
+            memmove(out, row, view->width);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Every step-th pixel of every step-th row, starting step / 2 in, as
+ * width x height gray samples for the watch stage (nv_watch.h). Only the
+ * sampled pixels are read. Returns 0 for coded formats, which have to be
+ * decoded whole.
+ */
+int frame_view_sample_gray(const FrameView *view, unsigned char *gray, int step, int width, int height) {
+    if (view->format > PIXFMT_GRAY8) return 0;
+    const uint8_t *row = view->data + (step >> 1) * view->stride;
+    int first = step >> 1;
+
+    for (int y = 0; y < height; y++, row += step * view->stride) {
+        for (int x = 0; x < width; x++) {
+            int i = first + x * step;
+            if (view->format == PIXFMT_RGB565) {
+                *gray++ = rgb565_pixel_to_gray(((const uint16_t *)row)[i]);
+            } else if (view->format == PIXFMT_YUYV) {
+                *gray++ = row[i * 2];
+            } else {
+                *gray++ = row[i];
+            }
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,70 @@
+/*
+ * nv_frame_source.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Frame source interface for the host build. A source is opened with one of
+ * the frame_source_open_*() backends, then frames are pulled with
+ * frame_source_next() and handed back with frame_source_release().
+ * Compiled-in arrays and mapped files are returned as zero-copy views; the
+ * synthetic backend renders into a buffer owned by the source.
+ */
+#ifndef NV_FRAME_SOURCE_H_
+#define NV_FRAME_SOURCE_H_
+#include <stdint.h>
+#include "nv_file_map.h"
+#include "nv_sequence.h"
+#include "nv_context.h"
+
+typedef struct {
+    const uint8_t *data;
+    int width, height;
+    int stride;         // bytes per row, for uncoded formats
+    uint32_t size;      // bytes at data
+    int jpeg_scale;     // PIXFMT_JPEG: log2 of the reduction, width and height are after it
+    pixfmt_t format;
+    uint32_t index;
+} FrameView;
+
+typedef struct FrameSource FrameSource;
+
+typedef struct {
+    int (*next)(FrameSource *src, FrameView *view);
+    void (*release)(FrameSource *src, FrameView *view);
+    void (*close)(FrameSource *src);
+} FrameSourceOps;
+
+struct FrameSource {
+    const FrameSourceOps *ops;
+    int width, height;
+    pixfmt_t format;
+    uint32_t num_frames;        // 0 for endless sources
+    uint32_t next_index;
+
+    const void *const *frames;  // arrays backend
+    MappedFile file;            // raw and sequence file backends
+    NvSequence seq;             // sequence backend, views into file
+    int jpeg_scale;             // sequence backend, JPEG frames
+    uint8_t *render;            // synthetic backend
+    int32_t vx, vy;             // synthetic motion, Q8 pixels per frame
+    uint32_t seed;
+};
+
+int pixfmt_from_name(const char *name, pixfmt_t *format);
+
+int frame_source_open_arrays(FrameSource *src, const void *const *frames, uint32_t count,
+                             int width, int height, pixfmt_t format);
+int frame_source_open_raw(FrameSource *src, const char *path, int width, int height, pixfmt_t format);
+int frame_source_open_sequence(FrameSource *src, const char *path, int jpeg_scale);
+int frame_source_open_synthetic(FrameSource *src, int width, int height, pixfmt_t format,
+                                int32_t vx_q8, int32_t vy_q8, uint32_t count);
+
+int frame_source_next(FrameSource *src, FrameView *view);
+void frame_source_release(FrameSource *src, FrameView *view);
+void frame_source_close(FrameSource *src);
+
+int frame_view_to_gray(const FrameView *view, unsigned char *gray);
+int frame_view_sample_gray(const FrameView *view, unsigned char *gray, int step, int width, int height);
+
+#endif /* NV_FRAME_SOURCE_H_ */
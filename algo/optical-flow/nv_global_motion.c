@@ -0,0 +1,219 @@
+#include "nv_global_motion.h"
+#include <stdlib.h>
+
+#define GM_ONE (1 << Q15_SHIFT)
+#define GM_FIT_RANGE (1 << 12)     // centred coordinates are scaled below this for fitting
+
+static uint32_t gm_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/*
+ * num / den in Q14, shifting both down when the numerator would overflow
+ */
+static int32_t gm_div_q14(int64_t num, int64_t den) {
+    while (num > (INT64_MAX >> Q15_SHIFT) || num < -(INT64_MAX >> Q15_SHIFT)) {
+        num >>= 1;
+        den >>= 1;
+    }
+    if (den == 0) return 0;
+    int64_t q = (num << Q15_SHIFT) / den;
+    if (q > INT32_MAX) q = INT32_MAX;
+    if (q < -INT32_MAX) q = -INT32_MAX;
+    return (int32_t)q;
+}
+
+static void gm_identity(int32_t *m) {
+    m[0] = GM_ONE; m[1] = 0; m[2] = 0;
+    m[3] = 0; m[4] = GM_ONE; m[5] = 0;
+}
+
+static void gm_map(const int32_t *m, const int32_t *p, int32_t *out) {
+    out[0] = (int32_t)((((int64_t)m[0] * p[0] + (int64_t)m[1] * p[1]) >> Q15_SHIFT) + m[2]);
+    out[1] = (int32_t)((((int64_t)m[3] * p[0] + (int64_t)m[4] * p[1]) >> Q15_SHIFT) + m[5]);
+}
+
+static uint32_t gm_residual(const int32_t *m, const int32_t *p0, const int32_t *p1) {
+    int32_t q[2];
+    gm_map(m, p0, q);
+    int64_t r = llabs((int64_t)q[0] - p1[0]) + llabs((int64_t)q[1] - p1[1]);
+    return r > UINT32_MAX ? UINT32_MAX : (uint32_t)r;
+}
+
+/*
+ * Least-squares fit of the model to the tracks listed in idx. Coordinates are
+ * centred on their centroids and scaled so that the moment sums fit in int64.
+ * Returns 0 for a degenerate configuration.
+ */
+static int gm_fit(gm_model_t type, const int32_t *p0, const int32_t *p1, const int *idx, int n, int32_t *m) {
+    int64_t s0x = 0, s0y = 0, s1x = 0, s1y = 0;
+    for (int k = 0; k < n; k++) {
+        int i = idx[k];
+        s0x += p0[i * 2]; s0y += p0[i * 2 + 1];
+        s1x += p1[i * 2]; s1y += p1[i * 2 + 1];
+    }
+    int32_t c0[2] = { (int32_t)(s0x / n), (int32_t)(s0y / n) };
+    int32_t c1[2] = { (int32_t)(s1x / n), (int32_t)(s1y / n) };
+
+    if (type == GM_TRANSLATION) {
+        gm_identity(m);
+        m[2] = c1[0] - c0[0];
+        m[5] = c1[1] - c0[1];
+        return 1;
+    }
+
+    int32_t max_d = 0;
+    for (int k = 0; k < n; k++) {
+        int i = idx[k];
+        int32_t d[4] = { p0[i * 2] - c0[0], p0[i * 2 + 1] - c0[1], p1[i * 2] - c1[0], p1[i * 2 + 1] - c1[1] };
+        for (int j = 0; j < 4; j++) {
+            if (abs(d[j]) > max_d) max_d = abs(d[j]);
+        }
+    }
+    int s = 0;
+    while ((max_d >> s) >= GM_FIT_RANGE) s++;
+
+    int64_t sxx = 0, sxy = 0, syy = 0, sxu = 0, syu = 0, sxv = 0, syv = 0;
+    for (int k = 0; k < n; k++) {
+        int i = idx[k];
+        int64_t dx = (p0[i * 2] - c0[0]) >> s, dy = (p0[i * 2 + 1] - c0[1]) >> s;
+        int64_t du = (p1[i * 2] - c1[0]) >> s, dv = (p1[i * 2 + 1] - c1[1]) >> s;
+        sxx += dx * dx; sxy += dx * dy; syy += dy * dy;
+        sxu += dx * du; syu += dy * du;
+        sxv += dx * dv; syv += dy * dv;
+    }
+
+    if (type == GM_SIMILARITY) {
+        int64_t den = sxx + syy;
+        if (den == 0) return 0;
+        int32_t a = gm_div_q14(sxu + syv, den);     // scale * cos
+        int32_t b = gm_div_q14(sxv - syu, den);     // scale * sin
+        m[0] = a; m[1] = -b;
+        m[3] = b; m[4] = a;
+    } else {
+        int64_t det = sxx * syy - sxy * sxy;
+        if (det <= 0) return 0;
+        m[0] = gm_div_q14(syy * sxu - sxy * syu, det);
+        m[1] = gm_div_q14(sxx * syu - sxy * sxu, det);
+        m[3] = gm_div_q14(syy * sxv - sxy * syv, det);
+        m[4] = gm_div_q14(sxx * syv - sxy * sxv, det);
+    }
+    m[2] = 0;
+    m[5] = 0;
+    int32_t mc[2];
+    gm_map(m, c0, mc);
+    m[2] = c1[0] - mc[0];
+    m[5] = c1[1] - mc[1];
+    return 1;
+}
+
+static int gm_count_inliers(const int32_t *m, const int32_t *p0, const int32_t *p1,
+                            const int *idx, int n, uint64_t *err) {
+    int count = 0;
+    *err = 0;
+    for (int k = 0; k < n; k++) {
+        int i = idx[k];
+        uint32_t r = gm_residual(m, &p0[i * 2], &p1[i * 2]);
+        if (r <= GM_INLIER_THRESH) {
+            count++;
+            *err += r;
+        }
+    }
+    return count;
+}
+
+/*
+ * Fit a global motion model to tracks p0[i] -> p1[i] (interleaved x, y in Q14).
+ * status may be NULL, otherwise only tracks with status[i] != 0 are used.
+ * inlier_mask, if given, receives 1 for every track consistent with the model.
+ * Returns 1 if a model was found that more than the minimal sample and more
+ * than half of the valid tracks agree with; a lone agreeing track is noise.
+ */
+int global_motion_estimate(const int32_t *p0, const int32_t *p1, const uint8_t *status, int n,
+                           gm_model_t type, GlobalMotion *gm, uint8_t *inlier_mask) {
+    int idx[GM_MAX_TRACKS];
+    int nv = 0;
+    int k = (int)type;
+
+    for (int i = 0; i < n && nv < GM_MAX_TRACKS; i++) {
+        if (status == NULL || status[i]) idx[nv++] = i;
+    }
+    if (inlier_mask != NULL) {
+        for (int i = 0; i < n; i++) inlier_mask[i] = 0;
+    }
+
+    gm->type = type;
+    gm->inliers = 0;
+    gm->confidence = 0;
+    gm_identity(gm->m);
+    if (nv < k) return 0;
+
+    uint32_t seed = GM_SEED;
+    int best = 0;
+    uint64_t best_err = 0;
+    int32_t best_m[6];
+
+    for (int it = 0; it < GM_RANSAC_ITERS; it++) {
+        int sample[3];
+        int32_t m[6];
+        for (int j = 0; j < k; j++) {
+            int dup;
+            do {
+                sample[j] = idx[gm_rand(&seed) % nv];
+                dup = 0;
+                for (int q = 0; q < j; q++) {
+                    if (sample[q] == sample[j]) dup = 1;
+                }
+            } while (dup);
+        }
+        if (!gm_fit(type, p0, p1, sample, k, m)) continue;
+
+        uint64_t err;
+        int count = gm_count_inliers(m, p0, p1, idx, nv, &err);
+        if (count > best || (count == best && err < best_err)) {
+            best = count;
+            best_err = err;
+            for (int j = 0; j < 6; j++) best_m[j] = m[j];
+        }
+    }
+    if (best < k) return 0;
+
+    // refine on the consensus set, keep it only if it does not lose support
+    int inl[GM_MAX_TRACKS];
+    int ni = 0;
+    for (int j = 0; j < nv; j++) {
+        if (gm_residual(best_m, &p0[idx[j] * 2], &p1[idx[j] * 2]) <= GM_INLIER_THRESH) inl[ni++] = idx[j];
+    }
+    int32_t refined[6];
+    if (gm_fit(type, p0, p1, inl, ni, refined)) {
+        uint64_t err;
+        int count = gm_count_inliers(refined, p0, p1, idx, nv, &err);
+        if (count >= best) {
+            best = count;
+            for (int j = 0; j < 6; j++) best_m[j] = refined[j];
+        }
+    }
+
+    for (int j = 0; j < 6; j++) gm->m[j] = best_m[j];
+    gm->inliers = 0;
+    for (int j = 0; j < nv; j++) {
+        int i = idx[j];
+        if (gm_residual(gm->m, &p0[i * 2], &p1[i * 2]) <= GM_INLIER_THRESH) {
+            gm->inliers++;
+            if (inlier_mask != NULL) inlier_mask[i] = 1;
+        }
+    }
+    // a minimal sample always fits itself; only the redundant tracks carry evidence
+    gm->confidence = (uint8_t)((255 * (gm->inliers - k)) / (nv - k + 1));
+    // a consensus needs at least one redundant track and most of the valid ones
+    return gm->inliers > k && gm->inliers * 2 > nv;
+}
+
+void global_motion_apply(const GlobalMotion *gm, const int32_t *p, int32_t *out) {
+    gm_map(gm->m, p, out);
+}
@@ -0,0 +1,45 @@
+/*
+ * nv_global_motion.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Robust global motion from a set of feature tracks. A translation, similarity
+ * or affine model is fitted with a fixed number of RANSAC iterations driven by
+ * a deterministic PRNG, then refined by least squares on the inliers. All math
+ * is integer; points and translations are Q14 pixels like the LK output.
+ */
+#ifndef NV_GLOBAL_MOTION_H_
+#define NV_GLOBAL_MOTION_H_
+#include <stdint.h>
+#include "nv_optical_flow.h"
+
+#define GM_MAX_TRACKS 64
+#define GM_RANSAC_ITERS 32
+#define GM_INLIER_THRESH (1 << Q15_SHIFT)   // L1 residual, 1 pixel
+#define GM_SEED 0x2545F491u
+
+// Enum value is the minimal sample size of the model
+typedef enum {
+    GM_TRANSLATION = 1,
+    GM_SIMILARITY = 2,
+    GM_AFFINE = 3
+} gm_model_t;
+
+/*
+ * x' = (m[0] * x + m[1] * y) >> 14 + m[2]
+ * y' = (m[3] * x + m[4] * y) >> 14 + m[5]
+ * Linear terms are Q14, m[2] and m[5] are Q14 pixels.
+ */
+typedef struct {
+    gm_model_t type;
+    int32_t m[6];
+    int inliers;
+    uint8_t confidence;     // 0..255, share of redundant tracks that agree
+} GlobalMotion;
+
+int global_motion_estimate(const int32_t *p0, const int32_t *p1, const uint8_t *status, int n,
+                           gm_model_t type, GlobalMotion *gm, uint8_t *inlier_mask);
+void global_motion_apply(const GlobalMotion *gm, const int32_t *p, int32_t *out);
+
+#endif /* NV_GLOBAL_MOTION_H_ */
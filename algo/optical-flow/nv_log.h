@@ -0,0 +1,98 @@
+/*
+ * nv_log.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Tokenized logging. Each NV_LOGx() site stores its level, file:line and
+ * format in the "nv_log" section, and the site's offset in that section is
+ * its ID. Sent through the telemetry stream a message is the 16-bit ID plus
+ * the arguments as raw 32-bit words (NV_TLM_LOG); nothing is formatted on the
+ * target. utils/nvlog.py reads the section back out of the ELF (the AXF, or
+ * run.exe) and utils/nvtlm.py renders the messages with it.
+ *
+ * Sites above NV_LOG_LEVEL compile to nothing, format string included.
+ *
+ * Arguments are integers of at most 32 bits, cast to uint32_t at the site, so
+ * pointers and doubles do not compile; at most NV_LOG_MAX_ARGS of them. Use
+ * %d/%u/%x for int32_t/uint32_t on the host and %ld/%lu/%lx on the target,
+ * as with printf.
+ *
+ * With nv_log_to_text() the same sites print their text through a vprintf()
+ * style function instead, as before. On non-ELF hosts, where the section
+ * bounds are unknown, the telemetry sink falls back to TEXT messages.
+ */
+#ifndef NV_LOG_H_
+#define NV_LOG_H_
+#include <stdint.h>
+#include <stdarg.h>
+#include "nv_telemetry.h"
+
+#define NV_LOG_NONE 0
+#define NV_LOG_ERROR 1
+#define NV_LOG_WARN 2
+#define NV_LOG_INFO 3
+#define NV_LOG_DEBUG 4
+
+#ifndef NV_LOG_LEVEL
+#define NV_LOG_LEVEL NV_LOG_INFO
+#endif
+
+#define NV_LOG_MAX_ARGS 6
+#define NV_LOG_SEPARATOR "\x1f"     // between level, file:line and format in a site
+
+void nv_log_to_text(int (*vprint)(const char *format, va_list args));
+void nv_log_to_telemetry(NvTelemetry *tlm);
+void nv_log_write(const char *site, int nargs, ...);
+
+// NV_LOG_NARGS_(format, args...) counts the args, 0 to 6; the format keeps
+// the list non-empty as C99 requires
+#define NV_LOG_COUNT_(f, a1, a2, a3, a4, a5, a6, n, ...) n
+#define NV_LOG_NARGS_(...) NV_LOG_COUNT_(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0, 0)
+#define NV_LOG_FORMAT_(f, ...) f
+
+// The arguments after the format, each cast to one 32-bit word
+#define NV_LOG_ARGS_0(f)
+#define NV_LOG_ARGS_1(f, a) , (uint32_t)(a)
+#define NV_LOG_ARGS_2(f, a, b) , (uint32_t)(a), (uint32_t)(b)
+#define NV_LOG_ARGS_3(f, a, b, c) , (uint32_t)(a), (uint32_t)(b), (uint32_t)(c)
+#define NV_LOG_ARGS_4(f, a, b, c, d) , (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)
+#define NV_LOG_ARGS_5(f, a, b, c, d, e) , (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d), (uint32_t)(e)
+#define NV_LOG_ARGS_6(f, a, b, c, d, e, g) \
+    , (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d), (uint32_t)(e), (uint32_t)(g)
+#define NV_LOG_CAT_(a, b) a##b
+#define NV_LOG_ARGS_N_(n) NV_LOG_CAT_(NV_LOG_ARGS_, n)
+
+#define NV_LOG_STR_(x) #x
+#define NV_LOG_LINE_(x) NV_LOG_STR_(x)
+
+#define NV_LOG_SITE_(level, ...) do { \
+        static const char nv_log_site_[] __attribute__((section("nv_log"), used)) = \
+            level NV_LOG_SEPARATOR __FILE__ ":" NV_LOG_LINE_(__LINE__) NV_LOG_SEPARATOR \
+            NV_LOG_FORMAT_(__VA_ARGS__, 0); \
+        nv_log_write(nv_log_site_, NV_LOG_NARGS_(__VA_ARGS__) \
+                     NV_LOG_ARGS_N_(NV_LOG_NARGS_(__VA_ARGS__))(__VA_ARGS__)); \
+    } while (0)
+
+#if NV_LOG_LEVEL >= NV_LOG_ERROR
+#define NV_LOGE(...) NV_LOG_SITE_("E", __VA_ARGS__)
+#else
+#define NV_LOGE(...) ((void)0)
+#endif
+#if NV_LOG_LEVEL >= NV_LOG_WARN
+#define NV_LOGW(...) NV_LOG_SITE_("W", __VA_ARGS__)
+#else
+#define NV_LOGW(...) ((void)0)
+#endif
+#if NV_LOG_LEVEL >= NV_LOG_INFO
+#define NV_LOGI(...) NV_LOG_SITE_("I", __VA_ARGS__)
+#else
+#define NV_LOGI(...) ((void)0)
+#endif
+#if NV_LOG_LEVEL >= NV_LOG_DEBUG
+#define NV_LOGD(...) NV_LOG_SITE_("D", __VA_ARGS__)
+#else
+#define NV_LOGD(...) ((void)0)
+#endif
+
+#endif /* NV_LOG_H_ */
@@ -0,0 +1,53 @@
+/*
+ * nv_mem_stats.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Memory accounting: stack painting with a high-water mark, a tagged
+ * allocator wrapper that keeps current and peak bytes per tag, and a budget
+ * table of the arena every capture configuration needs.
+ *
+ * On Cortex-M nv_stack_paint() fills the free stack between __StackLimit and
+ * the stack pointer, so call it first thing after reset; the linker symbols
+ * also give the static data and heap region for nv_mem_report(). On the host
+ * it paints NV_STACK_HOST_BYTES below the caller, which then bounds what the
+ * caller's callees are measured against.
+ *
+ * Static buffers (the firmware arena) are entered with nv_mem_track_static()
+ * so the per-tag table covers all pipeline memory, wherever it comes from.
+ */
+#ifndef NV_MEM_STATS_H_
+#define NV_MEM_STATS_H_
+#include <stdint.h>
+
+#define NV_STACK_PATTERN 0xC5C5C5C5u
+#define NV_STACK_HOST_BYTES (256 * 1024)
+
+typedef enum {
+    NV_MEM_TAG_ARENA,       // NvContext arena, nv_context.h
+    NV_MEM_TAG_FRAMES,      // frame source buffers, nv_frame_source.h
+    NV_MEM_TAG_OTHER,
+    NV_MEM_NUM_TAGS
+} nv_mem_tag_t;
+
+typedef struct {
+    uint32_t current, peak;     // bytes
+    uint32_t allocs, fails;
+} NvMemTagStats;
+
+void nv_stack_paint(void);
+uint32_t nv_stack_size(void);           // painted bytes, the whole stack on target
+uint32_t nv_stack_high_water(void);     // deepest use since nv_stack_paint(), bytes
+
+void *nv_mem_alloc(uint32_t size, nv_mem_tag_t tag);
+void nv_mem_free(void *ptr);
+void nv_mem_track_static(nv_mem_tag_t tag, uint32_t size);
+const NvMemTagStats *nv_mem_tag_stats(nv_mem_tag_t tag);
+uint32_t nv_mem_peak(void);             // all tags together
+uint32_t nv_mem_heap_region(void);      // bytes between static data and the end of RAM, 0 on the host
+
+void nv_mem_report(int (*print)(const char *format, ...));
+void nv_mem_budget_report(uint32_t budget, int (*print)(const char *format, ...));
+
+#endif /* NV_MEM_STATS_H_ */
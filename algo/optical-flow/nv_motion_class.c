@@ -0,0 +1,143 @@
+#include "nv_motion_class.h"
+#include <string.h>
+#include "nv_params.h"
+
+static const char *const names[] = {
+    "Still", "Right", "Up-Right", "Up", "Up-Left", "Left", "Down-Left", "Down", "Down-Right"
+};
+
+void motion_class_init(MotionClass *mc) {
+    memset(mc, 0, sizeof(*mc));
+    mc->direction = MC_STILL;
+    mc->previous = MC_STILL;
+    mc->candidate = MC_STILL;
+}
+
+const char *motion_class_name(mc_direction_t direction) {
+    return (unsigned)direction < sizeof(names) / sizeof(names[0]) ? names[direction] : "?";
+}
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t root = 0, bit = (uint64_t)1 << 62;
+
+    while (bit > v) bit >>= 2;
+    for (; bit != 0; bit >>= 2) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return (uint32_t)root;
+}
+
+static uint32_t magnitude_of(int32_t dx, int32_t dy) {
+    return isqrt64((uint64_t)((int64_t)dx * dx + (int64_t)dy * dy));
+}
+
+static int32_t median(const int32_t *taps, int n) {
+    int32_t sorted[MC_MEDIAN_TAPS];
+
+    for (int i = 0; i < n; i++) {
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > taps[i]; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = taps[i];
+    }
+    return sorted[n / 2];
+}
+
+/*
+ * Moving starts above the threshold and stops below half of it; a moving
+ * vector falls in one of eight 45 degree sectors centred on the axes
+ */
+static mc_direction_t classify(const MotionClass *mc, int32_t dx, int32_t dy, uint32_t magnitude) {
+    uint32_t threshold = (uint32_t)nv_params.threshold;
+    if (magnitude == 0 || (mc->direction == MC_STILL ? magnitude <= threshold : magnitude < threshold / 2)) {
+        return MC_STILL;
+    }
+
+    int64_t ax = dx < 0 ? -(int64_t)dx : dx;
+    int64_t ay = dy < 0 ? -(int64_t)dy : dy;
+    if ((ay << 14) < ax * MC_TAN_22_5_Q14) return dx > 0 ? MC_RIGHT : MC_LEFT;
+    if ((ax << 14) < ay * MC_TAN_22_5_Q14) return dy > 0 ? MC_UP : MC_DOWN;
+    if (dy > 0) return dx > 0 ? MC_UP_RIGHT : MC_UP_LEFT;
+    return dx > 0 ? MC_DOWN_RIGHT : MC_DOWN_LEFT;
+}
+
+static void fold_confidence(MotionClass *mc, uint8_t agreement) {
+    mc->ema_confidence += (agreement * 256 - mc->ema_confidence) / (1 << MC_EMA_SHIFT);
+    mc->confidence = (uint8_t)(mc->ema_confidence >> 8);
+}
+
+/*
+ * One frame's global motion, Q14 px/frame, and its fit confidence; a still
+ * frame is (0, 0) with the motion gate's confidence. Returns 1 when the
+ * state changed.
+ */
+int motion_class_update(MotionClass *mc, int32_t dx, int32_t dy, uint8_t confidence) {
+    mc->taps_dx[mc->next_tap] = dx;
+    mc->taps_dy[mc->next_tap] = dy;
+    mc->next_tap = (mc->next_tap + 1) % MC_MEDIAN_TAPS;
+    if (mc->num_taps < MC_MEDIAN_TAPS) mc->num_taps++;
+    if (mc->num_taps == 1) {
+        mc->ema_dx = dx;
+        mc->ema_dy = dy;
+    } else {
+        mc->ema_dx += (dx - mc->ema_dx) / (1 << MC_EMA_SHIFT);
+        mc->ema_dy += (dy - mc->ema_dy) / (1 << MC_EMA_SHIFT);
+    }
+
+    if (nv_params.filter == MC_FILTER_EMA) {
+        mc->dx = mc->ema_dx;
+        mc->dy = mc->ema_dy;
+    } else if (nv_params.filter == MC_FILTER_MEDIAN) {
+        mc->dx = median(mc->taps_dx, mc->num_taps);
+        mc->dy = median(mc->taps_dy, mc->num_taps);
+    } else {
+        mc->dx = dx;
+        mc->dy = dy;
+    }
+    mc->magnitude = magnitude_of(mc->dx, mc->dy);
+    mc->speed = mc->magnitude * (uint32_t)nv_params.fps;
+
+    // The filtered vector decides the state, the frame's own vector whether
+    // the frame agrees with it
+    mc_direction_t target = classify(mc, mc->dx, mc->dy, mc->magnitude);
+    mc_direction_t raw = classify(mc, dx, dy, magnitude_of(dx, dy));
+    mc->frames++;
+    if (target == mc->direction) {
+        mc->pending = 0;
+        fold_confidence(mc, raw == mc->direction ? confidence : 0);
+        return 0;
+    }
+    if (mc->pending == 0 || target != mc->candidate) {
+        mc->candidate = target;
+        mc->pending = 0;
+        mc->candidate_confidence = 0;
+    }
+    mc->pending++;
+    mc->candidate_confidence += raw == target ? confidence : 0;
+    if (mc->pending < nv_params.hold) {
+        fold_confidence(mc, raw == mc->direction ? confidence : 0);
+        return 0;
+    }
+
+    // A new state starts at the mean confidence of the frames that made it
+    mc->previous = mc->direction;
+    mc->duration = mc->frames - (uint32_t)mc->pending;
+    mc->direction = target;
+    mc->frames = (uint32_t)mc->pending;
+    mc->ema_confidence = (int32_t)((mc->candidate_confidence << 8) / (uint32_t)mc->pending);
+    mc->confidence = (uint8_t)(mc->ema_confidence >> 8);
+    mc->pending = 0;
+    return 1;
+}
+
+/*
+ * A frame without a fit: the state and filters hold, the confidence falls
+ */
+void motion_class_skip(MotionClass *mc) {
+    mc->frames++;
+    fold_confidence(mc, 0);
+}
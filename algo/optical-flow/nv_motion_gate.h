@@ -0,0 +1,40 @@
+/*
+ * nv_motion_gate.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Cheap static-scene test run before feature detection and LK. The coarsest
+ * pyramid levels of the reference and current frame are compared by mean
+ * absolute difference, after removing the mean brightness change so exposure
+ * steps do not count as motion. The difference is judged against an adaptive
+ * noise floor. Static calls by the gate only lower the floor; it rises only
+ * when the tracker finds a pair the gate let through to be still
+ * (motion_gate_learn_static()), so neither long motion nor slow drift can
+ * teach the gate to ignore it.
+ *
+ * While the scene is static the caller keeps its reference frame and
+ * features, so slow drift adds up against the same reference until it
+ * crosses the threshold.
+ */
+#ifndef NV_MOTION_GATE_H_
+#define NV_MOTION_GATE_H_
+#include <stdint.h>
+
+#define MG_INITIAL_NOISE_Q8 256     // 1 gray level until the floor is learned
+#define MG_MIN_THRESHOLD_Q8 128     // never gate on less than 0.5 gray level
+#define MG_THRESHOLD_FACTOR 3       // moving above factor * noise floor
+#define MG_NOISE_RATE_SHIFT 3       // floor follows static pairs at 1/8
+
+typedef struct {
+    uint32_t noise_q8;          // mean absolute difference of a static pair, Q8 gray levels
+    uint32_t mad_q8;            // last measurement
+    uint32_t threshold_q8;      // last decision threshold
+    uint8_t confidence;         // 0..255, how far the last measurement was from the threshold
+} MotionGate;
+
+void motion_gate_init(MotionGate *gate);
+int motion_gate_update(MotionGate *gate, const unsigned char *ref, const unsigned char *cur, int width, int height);
+void motion_gate_learn_static(MotionGate *gate);
+
+#endif /* NV_MOTION_GATE_H_ */
@@ -1,30 +1,48 @@
 #include "nv_optical_flow.h"
+#include "nv_profile.h"
+#include "nv_params.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#define MAX_CANDIDATES 32          // local maxima of the corner response, not raw pixels
+#define FEATURE_SEARCH_RADIUS 50
+#define FEATURE_SPAN (2 * FEATURE_SEARCH_RADIUS + 1)
+
 typedef struct {
     int x, y;
     int score;
 } Candidate;
-void rgb565_to_grayscale(uint16_t *rgb565, unsigned char *gray, int width, int height) {
-    for (int i = 0; i < width * height; i++) {
-        uint16_t pixel = rgb565[i];
-        unsigned char r = (pixel >> 11) & 0x1F;  // 5 bits red
-        unsigned char g = (pixel >> 5) & 0x3F;   // 6 bits green
-        unsigned char b = pixel & 0x1F;          // 5 bits blue
 
-        // Convert to 8-bit values
-        r = (r * 255) / 31;
-        g = (g * 255) / 63;
-        b = (b * 255) / 31;
+// find_multiple_features() rows, indexed by y % 3: structure tensor
+// products summed over 3 columns (xx, xy, yy), and corner responses
+static int32_t tensor_rows[3][3][FEATURE_SPAN];
+static int32_t score_rows[3][FEATURE_SPAN];
+/*
+ * One RGB565 pixel to brightness-adjusted gray
+ */
+unsigned char rgb565_pixel_to_gray(uint16_t pixel) {
+    unsigned char r = (pixel >> 11) & 0x1F;  // 5 bits red
+    unsigned char g = (pixel >> 5) & 0x3F;   // 6 bits green
+    unsigned char b = pixel & 0x1F;          // 5 bits blue
 
-        // Calculate grayscale value using weighted sum
-        gray[i] = (r * 30 + g * 59 + b * 11) / 100;
-    }
+    // Convert to 8-bit values
+    r = (r * 255) / 31;
+    g = (g * 255) / 63;
+    b = (b * 255) / 31;
 
-    // brightness adjustment
+    // Weighted sum, then brightness adjustment
+    int y = (r * 30 + g * 59 + b * 11) / 100;
+    return (unsigned char)(y < 128 ? y * 3 / 4 : (y * 5 / 4 > 255 ? 255 : y * 5 / 4));
+}
+
+/*
+ * RGB565 to brightness-adjusted gray in one pass. gray may alias rgb565: pixel
+ * i is written to byte i after bytes 2i and 2i+1 have been read, so converting
+ * front to back compacts the frame into the lower half of its own buffer.
+ */
+void rgb565_to_grayscale(const uint16_t *rgb565, unsigned char *gray, int width, int height) {
     for (int i = 0; i < width * height; i++) {
-        gray[i] = (gray[i] < 128) ? (gray[i] * 3 / 4) : (gray[i] * 5 / 4 > 255 ? 255 : gray[i] * 5 / 4);
+        gray[i] = rgb565_pixel_to_gray(rgb565[i]);
     }
 }
 
@@ -42,6 +60,7 @@ void build_image_pyramid(unsigned char *src, unsigned char *dst, int src_width,
 }
 
 void compute_gradient(unsigned char *pyr, int16_t *gradx, int16_t *grady, int width, int height) {
+    NV_PROF_BEGIN(NV_PROF_GRADIENT);
     for (int i = 1; i < height - 1; i++) {
         for (int j = 1; j < width - 1; j++) {
             int idx = i * width + j;
@@ -52,6 +71,7 @@ void compute_gradient(unsigned char *pyr, int16_t *gradx, int16_t *grady, int wi
                           pyr[(i+1)*width + (j-1)] + 2*pyr[(i+1)*width + j] + pyr[(i+1)*width + (j+1)]) >> 1;
         }
     }
+    NV_PROF_END(NV_PROF_GRADIENT);
 }
 
 int find_strong_feature(unsigned char *gray, int width, int height, int32_t *point) {
@@ -59,11 +79,12 @@ int find_strong_feature(unsigned char *gray, int width, int height, int32_t *poi
     int search_radius = 20;
     int max_grad = 0;
     int best_x = cx, best_y = cy;
+    int half = nv_params.window / 2;
 
     for (int y = cy - search_radius; y <= cy + search_radius; y++) {
-        if (y < WINDOW_SIZE / 2 || y >= height - WINDOW_SIZE / 2) continue;
+        if (y < half || y >= height - half) continue;
         for (int x = cx - search_radius; x <= cx + search_radius; x++) {
-            if (x < WINDOW_SIZE / 2 || x >= width - WINDOW_SIZE / 2) continue;
+            if (x < half || x >= width - half) continue;
             int Ix = (-gray[(y-1)*width + (x-1)] + gray[(y-1)*width + (x+1)] +
                       -2*gray[y*width + (x-1)] + 2*gray[y*width + (x+1)] +
                       -gray[(y+1)*width + (x-1)] + gray[(y+1)*width + (x+1)]) >> 1;
@@ -78,60 +99,130 @@ int find_strong_feature(unsigned char *gray, int width, int height, int32_t *poi
         }
     }
 
-    if (max_grad < 30) {
+    if (max_grad < nv_params.min_gradient) {
         best_x = width / 2;
         best_y = height / 2;
     }
     point[0] = best_x << 14; // Q15
     point[1] = best_y << 14;
-    return max_grad >= 30;
+    return max_grad >= nv_params.min_gradient;
+}
+static void sobel_at(unsigned char *gray, int width, int x, int y, int *Ix, int *Iy) {
+    *Ix = (-gray[(y-1)*width + (x-1)] + gray[(y-1)*width + (x+1)] +
+           -2*gray[y*width + (x-1)] + 2*gray[y*width + (x+1)] +
+           -gray[(y+1)*width + (x-1)] + gray[(y+1)*width + (x+1)]) >> 1;
+    *Iy = (-gray[(y-1)*width + (x-1)] - 2*gray[(y-1)*width + x] - gray[(y-1)*width + (x+1)] +
+           gray[(y+1)*width + (x-1)] + 2*gray[(y+1)*width + x] + gray[(y+1)*width + (x+1)]) >> 1;
+}
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    while (bit > v) bit >>= 2;
+    while (bit != 0) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+/*
+ * Non-maximum suppression over the 3x3 neighbourhood in the score rows:
+ * strictly above the neighbours before it in raster order and at least equal
+ * to those after, so a plateau yields one pixel
+ */
+static int local_maximum(int y, int x, int y0, int y1, int x0, int x1) {
+    int32_t score = score_rows[y % 3][x - x0];
+    for (int ny = y - 1; ny <= y + 1; ny++) {
+        if (ny < y0 || ny > y1) continue;
+        for (int nx = x - 1; nx <= x + 1; nx++) {
+            if (nx < x0 || nx > x1 || (ny == y && nx == x)) continue;
+            int32_t other = score_rows[ny % 3][nx - x0];
+            int before = ny < y || (ny == y && nx < x);
+            if (before ? other >= score : other > score) return 0;
+        }
+    }
+    return 1;
 }
+
+static void add_candidate(Candidate *candidates, int *candidate_count, int x, int y, int score) {
+    if (*candidate_count == MAX_CANDIDATES && score <= candidates[MAX_CANDIDATES - 1].score) return;
+    int pos = *candidate_count < MAX_CANDIDATES ? (*candidate_count)++ : MAX_CANDIDATES - 1;
+    while (pos > 0 && candidates[pos - 1].score < score) {
+        candidates[pos] = candidates[pos - 1];
+        pos--;
+    }
+    candidates[pos].x = x;
+    candidates[pos].y = y;
+    candidates[pos].score = score;
+}
+
+static void suppress_row(int y, int y0, int y1, int x0, int x1, Candidate *candidates, int *candidate_count) {
+    for (int x = x0; x <= x1; x++) {
+        int32_t score = score_rows[y % 3][x - x0];
+        if (score > nv_params.min_score && local_maximum(y, x, y0, y1, x0, x1)) {
+            add_candidate(candidates, candidate_count, x, y, score);
+        }
+    }
+}
+
 int find_multiple_features(unsigned char *gray, int width, int height, int32_t feature_points[MAX_FEATURES][2], int *num_features) {
-    int search_radius = 50;
     int cx = width / 2, cy = height / 2;
     int feature_count = 0;
-    Candidate candidates[10]; // Store potential features
+    Candidate candidates[MAX_CANDIDATES]; // Strongest local maxima, sorted descending
     int candidate_count = 0;
+    int margin = nv_params.window / 2 > 2 ? nv_params.window / 2 : 2; // 3x3 window of 3x3 Sobel taps
+    int x0 = cx - FEATURE_SEARCH_RADIUS < margin ? margin : cx - FEATURE_SEARCH_RADIUS;
+    int x1 = cx + FEATURE_SEARCH_RADIUS >= width - margin ? width - margin - 1 : cx + FEATURE_SEARCH_RADIUS;
+    int y0 = cy - FEATURE_SEARCH_RADIUS < margin ? margin : cy - FEATURE_SEARCH_RADIUS;
+    int y1 = cy + FEATURE_SEARCH_RADIUS >= height - margin ? height - margin - 1 : cy + FEATURE_SEARCH_RADIUS;
 
-    // Compute corner response (Shi-Tomasi)
-    for (int y = cy - search_radius; y <= cy + search_radius; y++) {
-        if (y < WINDOW_SIZE / 2 || y >= height - WINDOW_SIZE / 2) continue;
-        for (int x = cx - search_radius; x <= cx + search_radius; x++) {
-            if (x < WINDOW_SIZE / 2 || x >= width - WINDOW_SIZE / 2) continue;
+    *num_features = 0;
+    if (x0 > x1 || y0 > y1) return 0;
 
-            int Ix = (-gray[(y-1)*width + (x-1)] + gray[(y-1)*width + (x+1)] +
-                      -2*gray[y*width + (x-1)] + 2*gray[y*width + (x+1)] +
-                      -gray[(y+1)*width + (x-1)] + gray[(y+1)*width + (x+1)]) >> 1;
-            int Iy = (-gray[(y-1)*width + (x-1)] - 2*gray[(y-1)*width + x] - gray[(y-1)*width + (x+1)] +
-                      gray[(y+1)*width + (x-1)] + 2*gray[(y+1)*width + x] + gray[(y+1)*width + (x+1)]) >> 1;
-
-            int Ixx = Ix * Ix;
-            int Iyy = Iy * Iy;
-            int Ixy = Ix * Iy;
-            int score = (Ixx + Iyy) - sqrt((Ixx - Iyy) * (Ixx - Iyy) + 4 * Ixy * Ixy);
-
-            if (score > 100) {
-                candidates[candidate_count].x = x;
-                candidates[candidate_count].y = y;
-                candidates[candidate_count].score = score;
-                candidate_count++;
+    // Shi-Tomasi corner response over a 3x3 window. Sobel runs once per
+    // pixel; its products are summed over 3 columns into a row, and the last
+    // 3 rows give the window sums of the row between them.
+    for (int r = y0 - 1; r <= y1 + 1; r++) {
+        int32_t (*row)[FEATURE_SPAN] = tensor_rows[r % 3];
+        int32_t prev[3] = { 0, 0, 0 }, cur[3] = { 0, 0, 0 };
+        for (int x = x0 - 1; x <= x1 + 1; x++) {
+            int Ix, Iy;
+            sobel_at(gray, width, x, r, &Ix, &Iy);
+            int32_t next[3] = { Ix * Ix, Ix * Iy, Iy * Iy };
+            if (x > x0) {
+                for (int k = 0; k < 3; k++) row[k][x - 1 - x0] = prev[k] + cur[k] + next[k];
+            }
+            for (int k = 0; k < 3; k++) {
+                prev[k] = cur[k];
+                cur[k] = next[k];
             }
         }
-    }
+        if (r < y0 + 1) continue;
 
-    // Sort candidates by score (descending)
-    for (int i = 0; i < candidate_count - 1; i++) {
-        for (int j = i + 1; j < candidate_count; j++) {
-            if (candidates[j].score > candidates[i].score) {
-                Candidate temp = candidates[i];
-                candidates[i] = candidates[j];
-                candidates[j] = temp;
+        int y = r - 1;
+        for (int x = x0; x <= x1; x++) {
+            int64_t sum[3];
+            for (int k = 0; k < 3; k++) {
+                sum[k] = (int64_t)tensor_rows[(y - 1) % 3][k][x - x0] + tensor_rows[y % 3][k][x - x0] +
+                         tensor_rows[r % 3][k][x - x0];
             }
+            // twice the minimum eigenvalue of the structure tensor
+            int64_t diff = sum[0] - sum[2];
+            score_rows[y % 3][x - x0] = (int32_t)(sum[0] + sum[2] -
+                                                  isqrt64((uint64_t)(diff * diff + 4 * sum[1] * sum[1])));
         }
+        // Row y - 1 has both neighbours now
+        if (y > y0) suppress_row(y - 1, y0, y1, x0, x1, candidates, &candidate_count);
     }
+    suppress_row(y1, y0, y1, x0, x1, candidates, &candidate_count);
 
-    // Select up to MAX_FEATURES, ensuring spatial separation
-    for (int i = 0; i < candidate_count && feature_count < MAX_FEATURES; i++) {
+    // Select up to nv_params.features, ensuring spatial separation
+    for (int i = 0; i < candidate_count && feature_count < nv_params.features; i++) {
         int x = candidates[i].x;
         int y = candidates[i].y;
         int valid = 1;
@@ -139,7 +230,7 @@ int find_multiple_features(unsigned char *gray, int width, int height, int32_t f
         for (int j = 0; j < feature_count; j++) {
             int dx = (feature_points[j][0] >> Q15_SHIFT) - x;
             int dy = (feature_points[j][1] >> Q15_SHIFT) - y;
-            if (sqrt(dx * dx + dy * dy) < MIN_DISTANCE) {
+            if (dx * dx + dy * dy < MIN_DISTANCE * MIN_DISTANCE) {
                 valid = 0;
                 break;
             }
@@ -155,52 +246,107 @@ int find_multiple_features(unsigned char *gray, int width, int height, int32_t f
     *num_features = feature_count;
     return feature_count > 0;
 }
+/*
+ * Template gradients at one pixel, from the gradient planes when given,
+ * otherwise straight from the image with the compute_gradient() kernel
+ */
+static void template_gradient(unsigned char *pyr, int16_t *gradx, int16_t *grady, int width, int height,
+                              int x, int y, int16_t *Ix, int16_t *Iy) {
+    if (gradx != NULL) {
+        *Ix = gradx[y * width + x];
+        *Iy = grady[y * width + x];
+    } else if (x < 1 || x >= width - 1 || y < 1 || y >= height - 1) {
+        *Ix = 0;
+        *Iy = 0;
+    } else {
+        int gx, gy;
+        sobel_at(pyr, width, x, y, &gx, &gy);
+        *Ix = (int16_t)gx;
+        *Iy = (int16_t)gy;
+    }
+}
+
+/*
+ * Bilinear sample at a Q14 position, Q7 result. The caller keeps the 2x2
+ * neighbourhood inside the image.
+ */
+static int32_t sample_q7(const unsigned char *img, int width, int32_t qx, int32_t qy) {
+    int32_t ix = qx >> 14, iy = qy >> 14;
+    int32_t fx = (qx >> 7) & 127, fy = (qy >> 7) & 127;
+    const unsigned char *p = img + iy * width + ix;
+    int32_t top = p[0] * (128 - fx) + p[1] * fx;
+    int32_t bottom = p[width] * (128 - fx) + p[width + 1] * fx;
+    return (top * (128 - fy) + bottom * fy + 64) >> 7;
+}
+
+/*
+ * p1 holds the initial guess on entry and the tracked position on return; the
+ * template is the window around p0 rounded to a pixel. The current window in
+ * pyr2 is sampled bilinearly, so the iterations refine below a pixel.
+ *
+ * gradx/grady may be NULL: the template gradients are then computed for the
+ * window only, so no full-frame gradient planes are needed.
+ */
 int lucas_kanade_at_level(unsigned char *pyr1, unsigned char *pyr2, int16_t *gradx, int16_t *grady,
                           int32_t *p0, int32_t *p1, int width, int height) {
-    int32_t x = p0[0] >> 14, y = p0[1] >> 14;
-    if (x < WINDOW_SIZE / 2 || x >= width - WINDOW_SIZE / 2 || y < WINDOW_SIZE / 2 || y >= height - WINDOW_SIZE / 2) {
+    const int window = nv_params.window;
+    const int half = window / 2;
+    int32_t x = (p0[0] + (1 << 13)) >> 14, y = (p0[1] + (1 << 13)) >> 14;
+    if (x < half || x >= width - half || y < half || y >= height - half) {
         p1[0] = -1;
         p1[1] = -1;
         return 0;
     }
 
-    int32_t u = 0, v = 0; // Q15
-    int32_t det = 0;
-    for (int iter = 0; iter < NUM_ITER; iter++) {
-        int32_t sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0, sum_yy = 0;
-        int32_t nx = x + (u >> 14), ny = y + (v >> 14);
-
-        for (int dy = -WINDOW_SIZE / 2; dy <= WINDOW_SIZE / 2; dy++) {
-            for (int dx = -WINDOW_SIZE / 2; dx <= WINDOW_SIZE / 2; dx++) {
-                int px = x + dx, py = y + dy;
-                int qx = nx + dx, qy = ny + dy;
-                if (px < 0 || px >= width || py < 0 || py >= height || qx < 0 || qx >= width || qy < 0 || qy >= height) continue;
+    // The template window does not move, fetch its gradients once
+    int16_t win_x[MAX_WINDOW_SIZE * MAX_WINDOW_SIZE], win_y[MAX_WINDOW_SIZE * MAX_WINDOW_SIZE];
+    int64_t sum_xx = 0, sum_xy = 0, sum_yy = 0;
+    NV_PROF_BEGIN(NV_PROF_GRADIENT);
+    for (int dy = -half, k = 0; dy <= half; dy++) {
+        for (int dx = -half; dx <= half; dx++, k++) {
+            template_gradient(pyr1, gradx, grady, width, height, x + dx, y + dy, &win_x[k], &win_y[k]);
+            sum_xx += (int32_t)win_x[k] * win_x[k];
+            sum_xy += (int32_t)win_x[k] * win_y[k];
+            sum_yy += (int32_t)win_y[k] * win_y[k];
+        }
+    }
+    NV_PROF_END(NV_PROF_GRADIENT);
 
-                int16_t Ix = gradx[py * width + px];
-                int16_t Iy = grady[py * width + px];
-                int16_t It = pyr2[qy * width + qx] - pyr1[py * width + px];
+    int64_t det = sum_xx * sum_yy - sum_xy * sum_xy;
+    if (det < nv_params.min_det) {
+        p1[0] = -1;
+        p1[1] = -1;
+        return 0;
+    }
 
-                sum_x += (int32_t)Ix * It;
-                sum_y += (int32_t)Iy * It;
-                sum_xx += (int32_t)Ix * Ix;
-                sum_xy += (int32_t)Ix * Iy;
-                sum_yy += (int32_t)Iy * Iy;
-            }
-        }
+    // Flow in Q14, relative to the template pixel
+    int32_t u = p1[0] - (x << 14), v = p1[1] - (y << 14);
+    for (int iter = 0; iter < nv_params.iterations; iter++) {
+        int64_t sum_x = 0, sum_y = 0;
+        int32_t qx0 = ((x - half) << 14) + u, qy0 = ((y - half) << 14) + v;
 
-        det = sum_xx * sum_yy - sum_xy * sum_xy;
-        if (abs(det) < 1000) {
+        // The whole window plus its bilinear neighbours must be inside pyr2
+        if (qx0 < 0 || qy0 < 0 || (qx0 >> 14) + window >= width || (qy0 >> 14) + window >= height) {
             p1[0] = -1;
             p1[1] = -1;
             return 0;
         }
+        for (int dy = 0, k = 0; dy < window; dy++) {
+            for (int dx = 0; dx < window; dx++, k++) {
+                int32_t It = sample_q7(pyr2, width, qx0 + (dx << 14), qy0 + (dy << 14)) -
+                             (pyr1[(y - half + dy) * width + (x - half + dx)] << 7);
+                sum_x += (int32_t)win_x[k] * It;
+                sum_y += (int32_t)win_y[k] * It;
+            }
+        }
 
-        int32_t du = ((sum_yy * (-sum_x) - sum_xy * (-sum_y)) << 14) / det;
-        int32_t dv = ((sum_xx * (-sum_y) - sum_xy * (-sum_x)) << 14) / det;
+        // Sobel taps halved are 4x the derivative and It is Q7: Q14 needs << (14 - 7 + 2)
+        int32_t du = (int32_t)(((sum_yy * -sum_x + sum_xy * sum_y) << 9) / det);
+        int32_t dv = (int32_t)(((sum_xx * -sum_y + sum_xy * sum_x) << 9) / det);
         u += du;
         v += dv;
 
-        if (abs(du) < (1 << 11) && abs(dv) < (1 << 11)) break;
+        if (abs(du) < (1 << 8) && abs(dv) < (1 << 8)) break;
     }
 
     p1[0] = (x << 14) + u;
@@ -208,28 +354,35 @@ int lucas_kanade_at_level(unsigned char *pyr1, unsigned char *pyr2, int16_t *gra
     return 1;
 }
 
+/*
+ * Coarse to fine: the flow found at each level, doubled, is the initial guess
+ * at the next finer one. gradx/grady may be NULL, see lucas_kanade_at_level().
+ */
 int lucas_kanade_pyramid(unsigned char **pyr1, unsigned char **pyr2, int16_t **gradx, int16_t **grady,
                          int32_t *p0, int32_t *p1, int width, int height, int levels) {
-    int32_t point[2] = { p0[0], p0[1] };
-    int32_t curr_p[2], next_p[2];
+    int32_t flow[2] = { 0, 0 };
 
     for (int l = levels - 1; l >= 0; l--) {
-        int w = width >> l;
-        int h = height >> l;
-        curr_p[0] = point[0] >> l;
-        curr_p[1] = point[1] >> l;
+        int32_t curr_p[2] = { p0[0] >> l, p0[1] >> l };
+        int32_t next_p[2] = { curr_p[0] + flow[0], curr_p[1] + flow[1] };
 
-        if (!lucas_kanade_at_level(pyr1[l], pyr2[l], gradx[l], grady[l], curr_p, next_p, w, h)) {
+        int16_t *gx = gradx != NULL ? gradx[l] : NULL;
+        int16_t *gy = grady != NULL ? grady[l] : NULL;
+        if (!lucas_kanade_at_level(pyr1[l], pyr2[l], gx, gy, curr_p, next_p, width >> l, height >> l)) {
             p1[0] = -1;
             p1[1] = -1;
             return 0;
         }
 
-        point[0] = next_p[0] << 1;
-        point[1] = next_p[1] << 1;
+        flow[0] = next_p[0] - curr_p[0];
+        flow[1] = next_p[1] - curr_p[1];
+        if (l > 0) {
+            flow[0] <<= 1;
+            flow[1] <<= 1;
+        }
     }
 
-    p1[0] = point[0];
-    p1[1] = point[1];
+    p1[0] = p0[0] + flow[0];
+    p1[1] = p0[1] + flow[1];
     return 1;
 }
@@ -0,0 +1,53 @@
+/*
+ * nv_params.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Tracker and classifier parameters that can be changed at runtime, for tuning on site
+ * without a rebuild. The kernels read the active set, nv_params; changes go
+ * into a pending set and take effect at nv_params_apply(), which the
+ * pipeline calls between frames, so a frame never sees a mix of old and new.
+ *
+ * Defaults are the compile-time values (WINDOW_SIZE, NUM_ITER, ...), and
+ * buffers stay sized by the compile-time maxima: the window by
+ * MAX_WINDOW_SIZE, the feature count by MAX_FEATURES and the levels by the
+ * context the arena was planned for.
+ *
+ * Commands, one per line (terminated by '\n', '\r' or ';'), as the firmware
+ * takes them on the USART and run.exe with -P:
+ *
+ *   $                   list all parameters with their pending values
+ *   $name               one parameter
+ *   $name=value         set a pending value
+ */
+#ifndef NV_PARAMS_H_
+#define NV_PARAMS_H_
+#include <stdint.h>
+
+#define NV_PARAMS_MAX_LINE 32
+
+typedef struct {
+    int32_t levels;         // pyramid levels LK tracks through, up to the context's
+    int32_t window;         // LK window, odd, up to MAX_WINDOW_SIZE
+    int32_t iterations;     // LK iterations per level
+    int32_t features;       // features per reference, up to MAX_FEATURES
+    int32_t min_det;        // LK: weakest structure tensor determinant still tracked
+    int32_t min_gradient;   // find_strong_feature(): weakest gradient accepted
+    int32_t min_score;      // find_multiple_features(): weakest corner response accepted
+    int32_t threshold;      // Q14 dy beyond which a frame is Up or Down, and the classifier's moving threshold
+    int32_t filter;         // classifier filter, mc_filter_t: 0 none, 1 exponential, 2 median (default)
+    int32_t hold;           // frames a classifier change must be seen for
+    int32_t events;         // 0 a MOTION report per frame, 1 EVENT reports on classifier changes only, 2 both
+    int32_t fps;            // frame rate of the firmware's frame timer
+} NvParams;
+
+extern NvParams nv_params;  // active set
+
+void nv_params_init(int max_levels);
+int nv_params_set(const char *name, int32_t value);
+int nv_params_get(const char *name, int32_t *value);
+int nv_params_apply(void);
+int nv_params_command(const char *line, int (*print)(const char *format, ...));
+
+#endif /* NV_PARAMS_H_ */
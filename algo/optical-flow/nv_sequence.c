@@ -0,0 +1,72 @@
+#include "nv_sequence.h"
+#include <stddef.h>
+
+/*
+ * Validate the container at data[0..size) and set up views into it.
+ * Nothing is copied; data must stay valid and 4-byte aligned.
+ * Returns 1 on success.
+ */
+int nvsq_open_memory(NvSequence *seq, const uint8_t *data, uint32_t size) {
+    seq->base = NULL;
+    seq->size = 0;
+    seq->hdr = NULL;
+    seq->index = NULL;
+    seq->timestamps = NULL;
+    seq->motion = NULL;
+
+    if (data == NULL || ((uintptr_t)data & 3) != 0 || size < sizeof(NvSeqHeader)) return 0;
+    const NvSeqHeader *hdr = (const NvSeqHeader *)data;
+    if (hdr->magic != NVSQ_MAGIC || hdr->version != NVSQ_VERSION || hdr->header_size < sizeof(NvSeqHeader)) return 0;
+    if (hdr->frame_count == 0 || (hdr->index_offset & 3) != 0) return 0;
+
+    uint64_t index_end = (uint64_t)hdr->index_offset + ((uint64_t)hdr->frame_count + 1) * 4;
+    if (hdr->index_offset < hdr->header_size || index_end > size) return 0;
+    const uint32_t *index = (const uint32_t *)(data + hdr->index_offset);
+    for (uint32_t i = 0; i < hdr->frame_count; i++) {
+        if (index[i] > index[i + 1] || (index[i] & 3) != 0) return 0;
+    }
+    if (index[hdr->frame_count] > size) return 0;
+
+    if (hdr->flags & NVSQ_FLAG_TIMESTAMPS) {
+        uint64_t ts_end = (uint64_t)hdr->timestamp_offset + (uint64_t)hdr->frame_count * 4;
+        if ((hdr->timestamp_offset & 3) != 0 || hdr->timestamp_offset < hdr->header_size || ts_end > size) return 0;
+        seq->timestamps = (const uint32_t *)(data + hdr->timestamp_offset);
+    }
+    if (hdr->flags & NVSQ_FLAG_MOTION) {
+        uint64_t motion_offset = index_end + (seq->timestamps != NULL ? (uint64_t)hdr->frame_count * 4 : 0);
+        if (motion_offset + (uint64_t)hdr->frame_count * sizeof(NvSeqMotion) > size) return 0;
+        seq->motion = (const NvSeqMotion *)(data + motion_offset);
+    }
+
+    seq->base = data;
+    seq->size = size;
+    seq->hdr = hdr;
+    seq->index = index;
+    return 1;
+}
+
+/*
+ * Pointer to frame i inside the container, or NULL when out of range
+ */
+const uint8_t *nvsq_frame(const NvSequence *seq, uint32_t i, uint32_t *size) {
+    if (seq->hdr == NULL || i >= seq->hdr->frame_count) return NULL;
+    if (size != NULL) *size = seq->index[i + 1] - seq->index[i];
+    return seq->base + seq->index[i];
+}
+
+/*
+ * Capture time of frame i; derived from fps when the file has no timestamps
+ */
+uint32_t nvsq_timestamp_ms(const NvSequence *seq, uint32_t i) {
+    if (seq->timestamps != NULL) return seq->timestamps[i];
+    if (seq->hdr == NULL || seq->hdr->fps_milli == 0) return 0;
+    return (uint32_t)((uint64_t)i * 1000000 / seq->hdr->fps_milli);
+}
+
+/*
+ * Ground-truth motion into frame i, or NULL when the file has none
+ */
+const NvSeqMotion *nvsq_motion(const NvSequence *seq, uint32_t i) {
+    if (seq->motion == NULL || i >= seq->hdr->frame_count) return NULL;
+    return &seq->motion[i];
+}
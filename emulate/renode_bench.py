@@ -0,0 +1,388 @@
+"""
+Headless on-target benchmark in Renode: loads the firmware AXF into the
+EFR32MG24 board description, talks to USART2 over a socket and collects the
+per-stage cycle table the firmware prints when built with NV_PROFILE=1
+(silmotion_xG12/app.c, 'r' clears it, 'p' prints it).
+
+  python renode_bench.py
+  python renode_bench.py --axf silmotion_xG12.axf --frames 50 -o report.json
+  python renode_bench.py --renode /opt/renode/renode --mhz 78 --timeout 900
+  python renode_bench.py --axf upload.axf --upload walk.nvsq --frames 20
+
+The frames come from the capture source built into the AXF (APP_SOURCE in
+app.c): the compiled-in pair, or an NVSQ sequence linked in with
+`nvsq.py asm`. Rebuild with the sequence to benchmark it. Or build with
+APP_SOURCE=APP_SOURCE_UPLOAD and stream a sequence in with --upload: frames go
+over the USART socket as utils/nvupload.py sends them, in a loop, at most
+UPLOAD_AHEAD frames ahead of the firmware's reports. Console commands are
+sent between frames then, since inside one every byte is frame data.
+
+Runs:
+  1. renode --disable-xwt --plain --port <monitor>, then over the monitor:
+     socket terminal on USART2, board description, DWT, ELF, start
+  2. wait for "Streaming at", let --warmup frames pass, send 'r'
+  3. after --frames more frames send 'p' and read the profile table
+  4. read sysbus.cpu ExecutedInstructions before and after the measured frames
+
+Renode is not cycle-accurate: DWT CYCCNT follows virtual time at --mhz and the
+CPU runs at PerformanceInMips = --mhz, so a cycle is one instruction. Read the
+numbers as instruction counts, good for comparing builds, not as board timing.
+
+The firmware sends binary telemetry by default (APP_TELEMETRY in app.c); it is
+decoded with utils/nvtlm.py into the text lines the parsing below expects, with
+the tokenized log strings read from the AXF itself. Use --text for a firmware
+built with APP_TELEMETRY=0.
+
+The report is JSON: the profile rows per stage, instructions per frame, the
+frame reports, any error lines from the firmware and, with telemetry, the
+decoder's message, bad frame and lost frame counts; with --upload, the frames
+and bytes sent and the wall time they took.
+"""
+import argparse
+import json
+import os
+import re
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'utils'))
+import nvlog  # noqa: E402
+import nvtlm  # noqa: E402
+import nvupload  # noqa: E402
+
+DEFAULT_AXF = os.path.join(HERE, 'silmotion_xG12.axf')
+BOARD = 'platforms/boards/silabs/efr32mg24board.repl'   # installed as in README.md
+DWT = 'dwt: Miscellaneous.DWT @ sysbus 0xE0001000 { frequency: %d }'
+
+PROMPT = re.compile(rb'\((monitor|machine-\d+)\) $')
+FRAME_LINE = re.compile(r'^(\d+): (.*)$')
+PROFILE_ROW = re.compile(r'^\s+(\w+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s*$')
+PROFILE_COLUMNS = ('count', 'min', 'mean', 'p50', 'p90', 'p99', 'max')
+UPLOAD_AHEAD = 2            # frames in flight, one per upload slot (nv_upload.h)
+UPLOAD_STALL = 30           # seconds without a report before sending anyway
+
+
+class Monitor:
+    """Renode monitor over its telnet port."""
+
+    def __init__(self, port, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                self.sock = socket.create_connection(('localhost', port), timeout=5)
+                break
+            except OSError:
+                if time.monotonic() > deadline:
+                    raise TimeoutError(f"no Renode monitor on port {port}")
+                time.sleep(0.5)
+        self.buffer = b''
+        self.read_prompt(timeout)
+
+    def read_prompt(self, timeout):
+        deadline = time.monotonic() + timeout
+        while not PROMPT.search(self.buffer):
+            if time.monotonic() > deadline:
+                raise TimeoutError("Renode monitor did not answer")
+            self.sock.settimeout(max(0.1, deadline - time.monotonic()))
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("Renode monitor closed")
+            self.buffer += strip_telnet(chunk)
+        text = PROMPT.sub(b'', self.buffer).decode(errors='replace')
+        self.buffer = b''
+        return text
+
+    def command(self, line, timeout=30):
+        self.sock.sendall(line.encode() + b'\n')
+        reply = self.read_prompt(timeout)
+        # The monitor echoes the command; errors come back as text
+        lines = [l for l in reply.replace('\r', '').split('\n') if l.strip() and l.strip() != line]
+        for l in lines:
+            if 'error' in l.lower() or 'could not' in l.lower():
+                raise RuntimeError(f"'{line}': {l.strip()}")
+        return '\n'.join(lines)
+
+    def close(self):
+        self.sock.close()
+
+
+def strip_telnet(data):
+    """Drops telnet negotiation (IAC sequences) and ANSI escapes."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        if data[i] == 0xFF and i + 1 < len(data):
+            i += 3 if data[i + 1] in (0xFB, 0xFC, 0xFD, 0xFE) else 2
+            continue
+        out.append(data[i])
+        i += 1
+    return re.sub(rb'\x1b\[[0-9;]*[A-Za-z]', b'', bytes(out))
+
+
+class Usart:
+    """Line reader on the USART2 server socket; telemetry is rendered to lines."""
+
+    def __init__(self, port, timeout, strings):
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                self.sock = socket.create_connection(('localhost', port), timeout=5)
+                break
+            except OSError:
+                if time.monotonic() > deadline:
+                    raise TimeoutError(f"no USART socket on port {port}")
+                time.sleep(0.5)
+        self.pending = b''
+        self.decoder = nvtlm.Decoder(strings) if strings is not None else None
+        self.log = []
+        self.uploader = None
+
+    def send(self, data):
+        self.sock.sendall(data)
+
+    def read_line(self, deadline):
+        while b'\n' not in self.pending:
+            if time.monotonic() > deadline:
+                raise TimeoutError("firmware stopped reporting")
+            self.sock.settimeout(max(0.1, deadline - time.monotonic()))
+            try:
+                chunk = self.sock.recv(4096)
+            except socket.timeout:
+                continue
+            if not chunk:
+                raise ConnectionError("USART socket closed")
+            if self.decoder:
+                for message in self.decoder.feed(chunk):
+                    line = nvtlm.render(message)
+                    if line is not None:
+                        self.pending += line.encode() + (b'' if message['type'] in ('text', 'log') else b'\n')
+            else:
+                self.pending += chunk
+        line, self.pending = self.pending.split(b'\n', 1)
+        text = line.decode(errors='replace').rstrip('\r')
+        self.log.append(text)
+        return text
+
+    def close(self):
+        self.sock.close()
+
+
+class Uploader(threading.Thread):
+    """Streams --upload in a loop, a frame per report once UPLOAD_AHEAD are
+    out, and sends console commands between frames."""
+
+    def __init__(self, usart, path):
+        super().__init__(daemon=True)
+        width, height, fmt, frames = nvupload.load(path, None)
+        self.packets = [nvupload.packet(frame, i, width, height, fmt) for i, frame in enumerate(frames)]
+        self.usart = usart
+        self.credits = threading.Semaphore(UPLOAD_AHEAD)
+        self.commands = []
+        self.lock = threading.Lock()
+        self.stopping = threading.Event()
+        self.sent = self.bytes = 0
+        self.start_time = self.end_time = None
+
+    def run(self):
+        self.start_time = time.monotonic()
+        while not self.stopping.is_set():
+            for data in self.packets:
+                self.credits.acquire(timeout=UPLOAD_STALL)
+                if self.stopping.is_set():
+                    break
+                self.flush_commands()
+                self.usart.send(data)
+                self.sent += 1
+                self.bytes += len(data)
+        self.end_time = time.monotonic()
+
+    def flush_commands(self):
+        with self.lock:
+            commands, self.commands = self.commands, []
+        for command in commands:
+            self.usart.send(command)
+
+    def send(self, command):
+        """Console command, queued for the next gap between frames."""
+        with self.lock:
+            self.commands.append(command)
+
+    def frame_reported(self):
+        self.credits.release()
+
+    def stop(self):
+        self.stopping.set()
+        self.credits.release()
+        self.join(5)
+        self.flush_commands()
+
+
+def instructions(monitor):
+    reply = monitor.command('sysbus.cpu ExecutedInstructions')
+    match = re.search(r'(\d+)', reply)
+    if not match:
+        raise RuntimeError(f"unexpected ExecutedInstructions reply: {reply!r}")
+    return int(match.group(1))
+
+
+def wait_frames(usart, count, deadline, report):
+    """Reads until count more frame reports arrived; keeps them and any errors."""
+    seen = 0
+    while seen < count:
+        line = usart.read_line(deadline)
+        if line.startswith('Error'):
+            report['errors'].append(line)
+            raise RuntimeError(line)
+        match = FRAME_LINE.match(line)
+        if match:
+            report['frames'].append({'frame': int(match.group(1)), 'report': match.group(2)})
+            seen += 1
+            if usart.uploader:
+                usart.uploader.frame_reported()
+
+
+def read_profile(usart, deadline):
+    """Profile (unit): header, column line, one row per stage that ran."""
+    frames = 0
+    while True:
+        line = usart.read_line(deadline)
+        match = re.match(r'^Profile \((\w+)\):', line)
+        if match:
+            unit = match.group(1)
+            break
+        if FRAME_LINE.match(line):
+            frames += 1
+            if usart.uploader:
+                usart.uploader.frame_reported()
+        if frames > 3:
+            raise RuntimeError("no profile table, build the firmware with NV_PROFILE=1")
+    usart.read_line(deadline)
+    stages = {}
+    while True:
+        line = usart.read_line(deadline)
+        match = PROFILE_ROW.match(line)
+        if not match:
+            break
+        stages[match.group(1)] = dict(zip(PROFILE_COLUMNS, (int(v) for v in match.groups()[1:])))
+    return unit, stages
+
+
+def run(args):
+    if not os.path.isfile(args.axf):
+        raise FileNotFoundError(f"AXF not found: {args.axf}")
+    renode = subprocess.Popen([args.renode, '--disable-xwt', '--plain', '--port', str(args.monitor_port)],
+                              stdout=subprocess.DEVNULL if not args.verbose else None,
+                              stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL)
+    monitor = usart = None
+    report = {'axf': os.path.abspath(args.axf), 'mhz': args.mhz, 'warmup': args.warmup,
+              'frames': [], 'errors': []}
+    uploader = None
+    try:
+        monitor = Monitor(args.monitor_port, args.timeout)
+        for command in (f'emulation CreateServerSocketTerminal {args.usart_port} "usart" false',
+                        'mach create',
+                        f'machine LoadPlatformDescription @{args.board}',
+                        f'machine LoadPlatformDescriptionFromString "{DWT % (args.mhz * 1000000)}"',
+                        'connector Connect sysbus.usart2 usart',
+                        f"sysbus LoadELF @{os.path.abspath(args.axf)}",
+                        f'sysbus.cpu PerformanceInMips {args.mhz}'):
+            monitor.command(command)
+        usart = Usart(args.usart_port, args.timeout, None if args.text else nvlog.extract(args.axf))
+        if args.upload:
+            uploader = usart.uploader = Uploader(usart, args.upload)
+        send = uploader.send if uploader else usart.send
+        monitor.command('start')
+
+        deadline = time.monotonic() + args.timeout
+        while True:
+            line = usart.read_line(deadline)
+            if line.startswith('Error'):
+                report['errors'].append(line)
+                raise RuntimeError(line)
+            if line.startswith('Streaming'):
+                break
+        if uploader:
+            uploader.start()
+
+        wait_frames(usart, args.warmup, deadline, report)
+        send(b'r')
+        start = instructions(monitor)
+        wait_frames(usart, args.frames, deadline, report)
+        end = instructions(monitor)
+        send(b'p')
+        report['unit'], report['stages'] = read_profile(usart, deadline)
+        report['measured_frames'] = args.frames
+        report['instructions'] = end - start
+        report['instructions_per_frame'] = (end - start) // args.frames
+    finally:
+        if uploader and uploader.is_alive():
+            uploader.stop()
+        if uploader and uploader.start_time:
+            report['upload'] = {'file': os.path.abspath(args.upload), 'frames_sent': uploader.sent,
+                                'bytes_sent': uploader.bytes,
+                                'seconds': round(uploader.end_time - uploader.start_time, 3)}
+        report['log'] = usart.log if usart else []
+        if usart and usart.decoder:
+            report['telemetry'] = {'messages': usart.decoder.messages, 'bad_frames': usart.decoder.bad_frames,
+                                   'lost': usart.decoder.lost}
+        if usart:
+            usart.close()
+        if monitor:
+            try:
+                monitor.command('quit', timeout=5)
+            except (OSError, TimeoutError, ConnectionError, RuntimeError):
+                pass
+            monitor.close()
+        try:
+            renode.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            renode.kill()
+    return report
+
+
+def print_summary(report):
+    print(f"{report['measured_frames']} frames, {report['instructions_per_frame']} instructions per frame "
+          f"(sleep included)")
+    if 'upload' in report:
+        upload = report['upload']
+        print(f"uploaded {upload['frames_sent']} frames, {upload['bytes_sent']} bytes in {upload['seconds']} s")
+    print(f"{'stage':<10} {'count':>7} {'min':>10} {'mean':>10} {'p90':>10} {'max':>10}  ({report['unit']})")
+    for name, row in report['stages'].items():
+        print(f"{name:<10} {row['count']:>7} {row['min']:>10} {row['mean']:>10} {row['p90']:>10} {row['max']:>10}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Headless Renode cycle benchmark of the firmware")
+    parser.add_argument('--axf', default=DEFAULT_AXF, help="firmware built with NV_PROFILE=1")
+    parser.add_argument('--renode', default='renode', help="Renode executable")
+    parser.add_argument('--board', default=BOARD, help="board description, Renode path or file")
+    parser.add_argument('--mhz', type=int, default=39, help="core clock for DWT and PerformanceInMips")
+    parser.add_argument('--warmup', type=int, default=3, help="frames before the profile is cleared")
+    parser.add_argument('--frames', type=int, default=20, help="frames measured")
+    parser.add_argument('--timeout', type=float, default=600, help="seconds of wall time for the whole run")
+    parser.add_argument('--text', action='store_true', help="firmware built with APP_TELEMETRY=0")
+    parser.add_argument('--upload', help="NVSQ sequence to stream in, firmware built with APP_SOURCE_UPLOAD")
+    parser.add_argument('--monitor-port', type=int, default=12346)
+    parser.add_argument('--usart-port', type=int, default=12345)
+    parser.add_argument('-o', '--output', help="JSON report, default stdout summary only")
+    parser.add_argument('-v', '--verbose', action='store_true', help="show the Renode log")
+    args = parser.parse_args()
+
+    try:
+        report = run(args)
+        print_summary(report)
+        if args.output:
+            with open(args.output, 'w') as f:
+                json.dump(report, f, indent=2)
+            print(f"Report written to '{args.output}'.")
+    except Exception as e:
+        print(f"An error occurred: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include <nv_usart.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 #include "em_device.h"
 #include "em_chip.h"
 #include "em_cmu.h"
@@ -14,138 +16,910 @@
 #include "em_gpio.h"
 #include "sl_sleeptimer.h"
 #include "nv_optical_flow.h"
-#include "nv_ov2640.h"
+#include "nv_context.h"
+#include "nv_global_motion.h"
+#include "nv_motion_gate.h"
+#include "nv_motion_class.h"
+#include "nv_watch.h"
+#include "nv_profile.h"
+#include "nv_mem_stats.h"
+#include "nv_telemetry.h"
+#include "nv_log.h"
+#include "nv_params.h"
+#include "sl_memory_config.h"
+#include "nv_capture.h"
+#include "nv_upload.h"
+#include "nv_jpeg.h"
+#include "frame1_rgb565.h"
+#include "frame2_rgb565.h"
 
 #define STBI_NO_STDIO
 #include <inttypes.h>
 
-#define MAX_BUFFER_SIZE (WIDTH * HEIGHT)
-#define PYR_SIZE (MAX_BUFFER_SIZE + (MAX_BUFFER_SIZE >> 2))
 #define Q15_SHIFT 14
 #define GRAD_SCALE_FACTOR (1 << Q15_SHIFT)
 
+// Streaming configuration
+#ifndef APP_TARGET_FPS
+#define APP_TARGET_FPS 5
+#endif
+#ifndef APP_CONSOLE_RX
+#define APP_CONSOLE_RX 1        // '$' parameter commands and the p/r/m requests over the USART
+#endif
+// Energy mode between frames, 1 or 2. EM2 stops the HF clocks the USART
+// receives on, so a byte arriving while the core sleeps in it is lost, and
+// the core sleeps for most of each frame period: the console would be
+// mostly deaf. EM2 therefore needs APP_CONSOLE_RX=0 and a build that only
+// sends; with the console the core idles in EM1.
+#ifndef APP_SLEEP_EM
+#if APP_CONSOLE_RX
+#define APP_SLEEP_EM 1
+#else
+#define APP_SLEEP_EM 2
+#endif
+#endif
+#if APP_SLEEP_EM == 2 && APP_CONSOLE_RX
+#error "APP_SLEEP_EM=2 drops console input, build it with APP_CONSOLE_RX=0"
+#endif
+#define APP_STATS_PERIOD_MS 5000
+#ifndef APP_MOTION_GATE
+#define APP_MOTION_GATE 1       // skip features and LK while the scene is static
+#endif
+#define APP_STILL_Q14 (1 << (Q15_SHIFT - 2))    // tracked motion under 1/4 pixel teaches the gate
+#ifndef APP_WATCH
+#define APP_WATCH 1             // watch a tiny image until something moves, then track
+#endif
+#ifndef APP_WATCH_TIMEOUT
+#define APP_WATCH_TIMEOUT (2 * APP_TARGET_FPS)  // frames without tracked motion before watching again
+#endif
+#ifndef APP_TELEMETRY
+#define APP_TELEMETRY 1         // binary messages instead of text lines, decode with utils/nvtlm.py
+#endif
+
+// Replay source, read in place: the compiled-in frame arrays, an NVSQ image
+// linked into flash (utils/nvsq.py asm ... nvsq_frames), or an NVSQ image at
+// APP_MX25_ADDRESS in the external SPI flash. Or frames uploaded over the
+// USART (nv_upload.h, utils/nvupload.py), APP_WIDTH x APP_HEIGHT in
+// APP_UPLOAD_FORMAT, processed as they arrive instead of on the frame timer.
+#define APP_SOURCE_ARRAYS 0
+#define APP_SOURCE_SEQUENCE 1
+#define APP_SOURCE_MX25 2
+#define APP_SOURCE_UPLOAD 3
+#ifndef APP_SOURCE
+#define APP_SOURCE APP_SOURCE_ARRAYS
+#endif
+#ifndef APP_MX25_ADDRESS
+#define APP_MX25_ADDRESS 0x000000
+#endif
+#ifndef APP_UPLOAD_FORMAT
+#define APP_UPLOAD_FORMAT PIXFMT_RGB565
+#endif
+#ifndef APP_UPLOAD_TIMEOUT_MS
+#define APP_UPLOAD_TIMEOUT_MS 2000  // a frame that gets no bytes for this long is given up
+#endif
+// Size reduction for JPEG sequences: JPEG_SCALE_1_8 takes 1600x1200 to 200x150
+#ifndef APP_JPEG_SCALE
+#define APP_JPEG_SCALE JPEG_SCALE_1_8
+#endif
+
+// Geometry of the frame arrays; sequences carry their own. Checked against
+// the arena by nv_context_init() at boot.
+#ifndef APP_WIDTH
+#define APP_WIDTH 160
+#endif
+#ifndef APP_HEIGHT
+#define APP_HEIGHT 90
+#endif
+#ifndef APP_ARENA_SIZE
+#define APP_ARENA_SIZE 36000    // 160x90 with 2 pyramid levels, see nv_context_report()
+#endif
+
 typedef enum {
   OK,
   ERROR,
   INVALID_SIZE,
-  LOAD_FAIL
+  LOAD_FAIL,
+  BUSY
 } status_t;
 
-typedef struct {
-    unsigned char *pyr[PYR_LEVELS];
-    int16_t *gradx[PYR_LEVELS];
-    int16_t *grady[PYR_LEVELS];
-    int32_t feature_point[2];
-    int valid_feature;
-} FrameData;
+typedef enum {
+  APP_STATE_IDLE,
+  APP_STATE_CAPTURE,
+  APP_STATE_WATCH,
+  APP_STATE_CONVERT,
+  APP_STATE_PYRAMID,
+  APP_STATE_TRACK,
+  APP_STATE_REPORT
+} app_state_t;
 
 /********************************************************************************//**
  * Static Functions
  ***********************************************************************************/
-static unsigned char pyr_buffer[PYR_SIZE];
-static unsigned char gray_buffer[MAX_BUFFER_SIZE];
+static uint32_t arena[APP_ARENA_SIZE / sizeof(uint32_t)];
+static NvContext ctx;
+static CaptureSource capture_src;
+static CaptureFrame captured;
+static int cur_frame = 0;                   // ctx.frames[cur_frame ^ 1] is the reference
+static int have_reference = 0;
+static int32_t last_dy = 0;
+static int last_status = ERROR;
+static int last_moving = 1;
+static int last_tracked = 0;                // last LK result was at least APP_STILL_Q14
+static int last_watching = 0;
+static MotionGate motion_gate;
+static MotionClass motion_class;
+#if APP_WATCH
+static Watch watch;
+#endif
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+static uint8_t upload_slots[UPLOAD_SLOTS][APP_WIDTH * APP_HEIGHT * 2] __attribute__((aligned(4)));
+static int converted_rows = 0;              // of the captured upload
+static int arrived_rows = 0;                // of the captured upload, when upload_progress_tick last moved
+static uint32_t upload_progress_tick = 0;
+#endif
+static NvTelemetry telemetry;
+static NvTlmMotion frame_report;            // filled in by the pipeline stages, sent by report_frame()
+
+static volatile app_state_t app_state = APP_STATE_IDLE;
+static volatile uint8_t frame_due = 0;
+static volatile uint32_t dropped_frames = 0;
+static volatile uint8_t console_request = 0;    // 'p' prints the stage timings, 'r' clears them, 'm' prints memory use
+static volatile uint8_t console_ack = 0;        // bytes received since the last "OK:"
+static char command_rx[NV_PARAMS_MAX_LINE + 1];   // '$' line being received, in the RX interrupt
+static uint8_t command_rx_len = 0;                // 0 outside a '$' line
+static char command_line[NV_PARAMS_MAX_LINE + 1]; // complete line for the main loop, "" when too long
+static volatile uint8_t command_ready = 0;
+static sl_sleeptimer_timer_handle_t frame_timer;
+static uint32_t target_fps = APP_TARGET_FPS;
+static uint32_t frame_count = 0;
+static uint32_t stats_frames = 0;
+static uint32_t stats_static = 0;
+static uint32_t stats_watching = 0;
+static uint32_t stats_start_tick = 0;
+
+/*
+ * Text output. With APP_TELEMETRY each call becomes one TEXT message, so it
+ * shares the framing and sequence numbers with the binary reports; lines are
+ * cut at NV_TLM_MAX_TEXT either way.
+ */
+static int app_vprintf(const char *format, va_list args) {
+#if APP_TELEMETRY
+    return nv_tlm_vprintf(&telemetry, format, args);
+#else
+    char line[NV_TLM_MAX_TEXT + 1];
+    int len = vsnprintf(line, sizeof(line), format, args);
+    if (len > NV_TLM_MAX_TEXT) len = NV_TLM_MAX_TEXT;
+    return len > 0 ? usart_write((const uint8_t *)line, (uint32_t)len) : len;
+#endif
+}
+
+static int app_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = app_vprintf(format, args);
+    va_end(args);
+    return len;
+}
 
+#if APP_CONSOLE_RX
+/*
+ * Collects a '$' parameter command (nv_params.h) up to its terminator. One
+ * line is in flight at a time: a line completed before the main loop has run
+ * the previous one is dropped.
+ */
+static void command_rx_byte(uint8_t data) {
+    if (data == '\n' || data == '\r' || data == ';') {
+        if (!command_ready) {
+            if (command_rx_len <= NV_PARAMS_MAX_LINE) {
+                memcpy(command_line, command_rx, command_rx_len);
+                command_line[command_rx_len] = '\0';
+            } else {
+                command_line[0] = '\0';
+            }
+            command_ready = 1;
+        }
+        command_rx_len = 0;
+    } else if (command_rx_len <= NV_PARAMS_MAX_LINE) {
+        if (command_rx_len < NV_PARAMS_MAX_LINE) command_rx[command_rx_len] = (char)data;
+        command_rx_len++;                           // one past the end marks an overlong line
+    }
+}
+#endif
+
+/*
+ * The acknowledgement goes out from the main loop, so interrupt context never
+ * writes into the telemetry stream. A parameter command is acknowledged by
+ * the values it prints.
+ */
 static void rx_callback(uint8_t data) {
-    usart_printf("OK:\n");
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    if (upload_rx_byte(data)) return;
+#endif
+#if APP_CONSOLE_RX
+    if (command_rx_len > 0 || data == '$') {
+        command_rx_byte(data);
+        return;
+    }
+    if (data == 'p' || data == 'r' || data == 'm') {
+        console_request = data;
+    }
+    console_ack = 1;
+#else
+    (void)data;
+#endif
+}
+
+/*
+ * Frame timer tick: request a frame, or count it as dropped while the
+ * pipeline is still busy with the previous one.
+ */
+static void frame_timer_callback(sl_sleeptimer_timer_handle_t *handle, void *data) {
+    (void)handle;
+    (void)data;
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    // Uploads pace the frames; the tick only wakes the loop to notice a stall
+#else
+    if (frame_due || app_state != APP_STATE_IDLE) {
+        dropped_frames++;
+    } else {
+        frame_due = 1;
+    }
+#endif
+}
+
+/*
+ * A frame can start: the timer ticked, or an upload began
+ */
+static int frame_available(void) {
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    return upload_pending();
+#else
+    return frame_due;
+#endif
+}
+
+static void start_frame_timer(uint32_t fps) {
+    if (fps == 0) fps = 1;
+    target_fps = fps;
+    sl_sleeptimer_stop_timer(&frame_timer);
+    sl_sleeptimer_start_periodic_timer_ms(&frame_timer, 1000 / fps, frame_timer_callback, NULL, 0, 0);
+}
+
+/*
+ * Parameters set since the last frame take effect, between frames so no
+ * frame sees a mix. The frame timer restarts only when the rate changed.
+ */
+static void apply_params(void) {
+    if (nv_params_apply() && (uint32_t)nv_params.fps != target_fps) {
+        start_frame_timer((uint32_t)nv_params.fps);
+    }
+}
+
+#if APP_SOURCE == APP_SOURCE_SEQUENCE
+extern const uint8_t nvsq_frames[], nvsq_frames_end[];
+#endif
+
+static int open_capture(void) {
+#if APP_SOURCE == APP_SOURCE_SEQUENCE
+    if (capture_open_sequence(&capture_src, nvsq_frames, (uint32_t)(nvsq_frames_end - nvsq_frames), APP_JPEG_SCALE)) return OK;
+#elif APP_SOURCE == APP_SOURCE_MX25
+    if (capture_open_mx25(&capture_src, APP_MX25_ADDRESS)) return OK;
+#elif APP_SOURCE == APP_SOURCE_UPLOAD
+    if (capture_open_upload(&capture_src, APP_WIDTH, APP_HEIGHT, APP_UPLOAD_FORMAT) &&
+        upload_init(upload_slots[0], sizeof(upload_slots[0]), APP_WIDTH, APP_HEIGHT, APP_UPLOAD_FORMAT)) return OK;
+#else
+    static const void *const test_frames[] = { frame1_rgb565, frame2_rgb565 };
+    if (capture_open_arrays(&capture_src, test_frames, 2, APP_WIDTH, APP_HEIGHT, PIXFMT_RGB565)) return OK;
+#endif
+    NV_LOGE("Error: no frames in capture source %d\n", APP_SOURCE);
+    return LOAD_FAIL;
 }
 
-static int process_single_frame(int frame, FrameData *frame_data) {
-    uint16_t *img = NULL;
-    usart_printf("%d: Processing frame\n", frame);
-    if (ov2640_capture_frame(&img, frame) == 1) {
-        usart_printf("Error: Cannot load frame %d to RAM.\n", frame);
+/*
+ * Frames are converted straight from the capture source, so the arena only
+ * holds the pyramids
+ */
+static int setup_context(void) {
+    if (!nv_context_init(&ctx, capture_src.width, capture_src.height, capture_src.format, PYR_LEVELS,
+                         NV_CTX_EXTERNAL_FRAMES)) {
+        NV_LOGE("Error: cannot process %dx%d with %d levels\n", capture_src.width, capture_src.height, PYR_LEVELS);
+        return INVALID_SIZE;
+    }
+    nv_context_report(&ctx, app_printf);
+    if (!nv_context_bind(&ctx, arena, sizeof(arena))) {
+        NV_LOGE("Error: arena is %u bytes, need %lu\n", (unsigned)sizeof(arena), nv_context_mem_required(&ctx));
         return ERROR;
     }
-    rgb565_to_grayscale(img, gray_buffer, WIDTH, HEIGHT);
-    usart_printf("%d: Converted frame to grayscale\n", frame);
-
-    // Build pyramid for current frame
-    frame_data->pyr[0] = pyr_buffer;
-    frame_data->pyr[1] = pyr_buffer + MAX_BUFFER_SIZE;
-    memcpy(frame_data->pyr[0], gray_buffer, WIDTH * HEIGHT);
-
-    for (int l = 1; l < PYR_LEVELS; l++) {
-        int w = WIDTH >> l;
-        int h = HEIGHT >> l;
-        build_image_pyramid(frame_data->pyr[l - 1], frame_data->pyr[l], w * 2, h * 2);
-        usart_printf("%d: Built p6yramid level %d(size: %dx%d)\n",frame, l, w, h);
-    }
-
-    static int16_t grad_buffer_local[PYR_SIZE * 2];
-    for (int l = 0; l < PYR_LEVELS; l++) {
-        int w = WIDTH >> l;
-        int h = HEIGHT >> l;
-        frame_data->gradx[l] = grad_buffer_local;
-        frame_data->grady[l] = grad_buffer_local + (w * h / 2);
-        compute_gradient(frame_data->pyr[l], frame_data->gradx[l], frame_data->grady[l], w, h);
-        usart_printf("%d: Computed gradients, level %d\n", frame, l);
-    }
-
-    // find specific feature point
-    if(frame == 1){
-        frame_data->valid_feature = find_strong_feature(gray_buffer, WIDTH, HEIGHT, frame_data->feature_point);
-        if (!frame_data->valid_feature) {
-            frame_data->feature_point[0] = (WIDTH / 2) << Q15_SHIFT; // x
-            frame_data->feature_point[1] = (HEIGHT / 2) << Q15_SHIFT; // y
-            usart_printf("No strong feature found for frame %d, using center (%ld,%ld)\n",
-                         frame, frame_data->feature_point[0] >> Q15_SHIFT, frame_data->feature_point[1] >> Q15_SHIFT);
-        } else {
-            usart_printf("%d: Found feature for frame at (%ld,%ld)\n",
-                         frame, frame_data->feature_point[0] >> Q15_SHIFT, frame_data->feature_point[1] >> Q15_SHIFT);
-        }
+    nv_params_init(ctx.levels);
+    nv_params_set("fps", APP_TARGET_FPS);
+    nv_params_apply();
+#if APP_WATCH
+    if (!watch_init(&watch, ctx.width, ctx.height, APP_WATCH_TIMEOUT)) {
+        NV_LOGW("Frame %dx%d too small to watch, tracking only\n", ctx.width, ctx.height);
     }
+#endif
+    return OK;
+}
 
+/*
+ * Replay frames in a loop. Only the frame is looked up here, nothing is copied.
+ * An upload is taken as soon as its header is in, rows still arriving.
+ */
+static int capture_next_frame(void) {
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    if (!upload_take(&captured)) return ERROR;
+    converted_rows = 0;
+    arrived_rows = 0;
+    upload_progress_tick = sl_sleeptimer_get_tick_count();
     return OK;
+#else
+    uint32_t num = frame_count % capture_src.num_frames;
+    if (!capture_frame(&capture_src, num, &captured)) {
+        NV_LOGE("Error: Cannot read frame %lu.\n", num);
+        return ERROR;
+    }
+    return OK;
+#endif
+}
+
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+/*
+ * BUSY until the whole upload is in, ERROR once it stalled. Completion is
+ * checked first, so arrived_rows covers the whole frame when it returns OK.
+ */
+static int upload_wait(void) {
+    int complete = upload_complete(&captured);
+    int ready = upload_rows_ready(&captured);
+    uint32_t now = sl_sleeptimer_get_tick_count();
+
+    if (ready > arrived_rows) {
+        arrived_rows = ready;
+        upload_progress_tick = now;
+    }
+    if (complete) return OK;
+    if (sl_sleeptimer_tick_to_ms(now - upload_progress_tick) < APP_UPLOAD_TIMEOUT_MS) return BUSY;
+    upload_abort(&captured);
+    NV_LOGE("Error: upload of frame %lu stalled at row %d\n", captured.index, arrived_rows);
+    return ERROR;
+}
+
+static int release_upload(void) {
+    if (!upload_release(&captured)) {
+        NV_LOGE("Error: upload of frame %lu failed its CRC\n", captured.index);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*
+ * Converts the rows that arrived since the last call; BUSY until the whole
+ * upload is in. The profile counts each batch of rows as one conversion.
+ */
+static int convert_frame(FrameData *frame_data) {
+    int status = upload_wait();
+
+    if (status == ERROR) return ERROR;
+    if (arrived_rows > converted_rows) {
+        NV_PROF_BEGIN(NV_PROF_CONVERT);
+        capture_rows_to_gray(&capture_src, &captured, frame_data->pyr[0], converted_rows, arrived_rows - converted_rows);
+        NV_PROF_END(NV_PROF_CONVERT);
+        converted_rows = arrived_rows;
+    }
+    return status == OK ? release_upload() : status;
+}
+#else
+static int convert_frame(FrameData *frame_data) {
+    // streams (and decodes) from flash straight into pyramid level 0
+    NV_PROF_BEGIN(NV_PROF_CONVERT);
+    int converted = capture_to_gray(&capture_src, &captured, frame_data->pyr[0]);
+    NV_PROF_END(NV_PROF_CONVERT);
+    if (!converted) {
+        NV_LOGE("Error: Cannot decode frame %lu.\n", captured.index);
+        return ERROR;
+    }
+    return OK;
+}
+#endif
+
+static void build_pyramid(FrameData *frame_data) {
+    NV_PROF_BEGIN(NV_PROF_PYRAMID);
+    for (int l = 1; l < ctx.levels; l++) {
+        build_image_pyramid(frame_data->pyr[l - 1], frame_data->pyr[l], ctx.level_width[l - 1], ctx.level_height[l - 1]);
+    }
+    NV_PROF_END(NV_PROF_PYRAMID);
+}
+
+/*
+ * Features of the current frame, which becomes the reference for the next one
+ */
+static void prepare_reference(FrameData *frame_data) {
+    NV_PROF_BEGIN(NV_PROF_FEATURES);
+    if (!find_multiple_features(frame_data->pyr[0], ctx.width, ctx.height, frame_data->feature_points, &frame_data->num_features)) {
+        // find_strong_feature() falls back to the centre itself
+        find_strong_feature(frame_data->pyr[0], ctx.width, ctx.height, frame_data->feature_points[0]);
+        frame_data->num_features = 1;
+    }
+    NV_PROF_END(NV_PROF_FEATURES);
+    NV_LOGD("%lu: %d features, strongest at (%ld,%ld)\n", frame_count, frame_data->num_features,
+            frame_data->feature_points[0][0] >> Q15_SHIFT, frame_data->feature_points[0][1] >> Q15_SHIFT);
+}
+
+/*
+ * Watch stage, straight from the capture: uncoded frames are only sampled,
+ * coded ones are decoded whole into level 0 as CONVERT would. Sets
+ * last_watching while it handles the frame alone; on motion it hands this
+ * frame to full tracking as the first reference. An upload is watched once
+ * it is complete and released here unless tracking takes it over.
+ */
+static int watch_frame(FrameData *frame_data) {
+#if APP_WATCH
+    int coded = capture_src.format > PIXFMT_GRAY8;
+    int status = OK;
+
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    status = upload_wait();
+#endif
+    if (status == OK && coded) status = convert_frame(frame_data);
+    if (status != OK) return status;
+
+    NV_PROF_BEGIN(NV_PROF_WATCH);
+    if (coded) {
+        watch_sample_gray(&watch, frame_data->pyr[0], ctx.width);
+    } else {
+        capture_sample_gray(&capture_src, &captured, watch.work, watch.step, watch.sample_width, watch.sample_height);
+    }
+    int moving = watch_update(&watch);
+    NV_PROF_END(NV_PROF_WATCH);
+    last_watching = !moving;
+    if (!moving) {
+        last_moving = 0;
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+        status = release_upload();
+#endif
+        return status;
+    }
+    frame_report.flags |= NV_TLM_FLAG_WATCH_ALARM;
+    frame_report.dx = watch.dx * GRAD_SCALE_FACTOR;
+    frame_report.dy = watch.dy * GRAD_SCALE_FACTOR;
+    have_reference = 0;
+    return OK;
+#else
+    (void)frame_data;
+    return ERROR;
+#endif
+}
+
+/*
+ * The watch stage takes the next frame
+ */
+static int watch_due(void) {
+#if APP_WATCH
+    return watch.mode == WATCH_WATCHING;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Tells the watch stage whether tracking still sees motion; it takes over
+ * again after APP_WATCH_TIMEOUT frames without.
+ */
+static void watch_feedback(void) {
+#if APP_WATCH
+    if (!have_reference) return;
+    if (!watch_track_result(&watch, last_moving && last_status == OK && last_tracked)) {
+        frame_report.flags |= NV_TLM_FLAG_BACK_TO_WATCH;
+    }
+#endif
 }
 
-static int calculate_motion(FrameData *prev_frame, FrameData *curr_frame, int32_t p0[2], int32_t p1[2], int32_t *dy) {
-    usart_printf("Calculating motion from prev to curr frame\n");
-    usart_printf("Initial feature point: (%ld,%ld)\n", p0[0] >> Q15_SHIFT, p0[1] >> Q15_SHIFT);
-    int valid = lucas_kanade_pyramid(prev_frame->pyr, curr_frame->pyr,
-                                     prev_frame->gradx, prev_frame->grady,
-                                     p0, p1, WIDTH, HEIGHT, PYR_LEVELS);
-    if (!valid) {
-        usart_printf("Optical flow failed\n");
+/*
+ * Coarsest levels through the motion gate. Returns 0 for a static scene.
+ */
+static int scene_moved(FrameData *prev_frame, FrameData *curr_frame) {
+#if APP_MOTION_GATE
+    int top = ctx.levels - 1;
+    NV_PROF_BEGIN(NV_PROF_GATE);
+    int moving = motion_gate_update(&motion_gate, prev_frame->pyr[top], curr_frame->pyr[top],
+                                    ctx.level_width[top], ctx.level_height[top]);
+    NV_PROF_END(NV_PROF_GATE);
+    return moving;
+#else
+    (void)prev_frame;
+    (void)curr_frame;
+    return 1;
+#endif
+}
+
+static int calculate_motion(FrameData *prev_frame, FrameData *curr_frame, int32_t *dy) {
+    int32_t p0[MAX_FEATURES * 2], p1[MAX_FEATURES * 2];
+    uint8_t status[MAX_FEATURES];
+    GlobalMotion gm;
+    int n = prev_frame->num_features;
+
+    NV_PROF_BEGIN(NV_PROF_TRACK);
+    for (int i = 0; i < n; i++) {
+        p0[i * 2] = prev_frame->feature_points[i][0];
+        p0[i * 2 + 1] = prev_frame->feature_points[i][1];
+        status[i] = (uint8_t)lucas_kanade_pyramid(prev_frame->pyr, curr_frame->pyr,
+                                                  NULL, NULL,
+                                                  &p0[i * 2], &p1[i * 2], ctx.width, ctx.height, nv_params.levels);
+    }
+    NV_PROF_END(NV_PROF_TRACK);
+
+    NV_PROF_BEGIN(NV_PROF_MOTION);
+    int fitted = global_motion_estimate(p0, p1, status, n, GM_TRANSLATION, &gm, NULL);
+    NV_PROF_END(NV_PROF_MOTION);
+    frame_report.features = (uint8_t)n;
+    for (int i = 0; i < n; i++) frame_report.tracked += status[i] != 0;
+    if (!fitted) {
+        NV_LOGD("%lu: no motion fit, %u/%d tracked\n", frame_count, frame_report.tracked, n);
         *dy = 0;
         return ERROR;
+    }
+    *dy = gm.m[5];
+    frame_report.inliers = (uint8_t)gm.inliers;
+    frame_report.confidence = gm.confidence;
+    frame_report.dx = gm.m[2];
+    frame_report.dy = gm.m[5];
+    NV_LOGD("%lu: global motion dx=%ld dy=%ld, %d/%d inliers, confidence %u\n", frame_count, gm.m[2], gm.m[5],
+            gm.inliers, n, gm.confidence);
+    last_tracked = !(gm.m[2] > -APP_STILL_Q14 && gm.m[2] < APP_STILL_Q14 && gm.m[5] > -APP_STILL_Q14 && gm.m[5] < APP_STILL_Q14);
+    if (!last_tracked) {
+        motion_gate_learn_static(&motion_gate);
+    }
+    return OK;
+}
+
+static uint16_t saturate_u16(uint32_t v) {
+    return v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+/*
+ * The frame's result as one MOTION message, or as the text lines it stands for
+ */
+static void send_motion_report(nv_tlm_state_t state) {
+    frame_report.frame = frame_count;
+    frame_report.state = (uint8_t)state;
+#if APP_TELEMETRY
+    nv_tlm_send_motion(&telemetry, &frame_report);
+#else
+    static const char *const directions[] = { "Up", "Down", "Unknown" };
+    if (frame_report.flags & NV_TLM_FLAG_WATCH_ALARM) {
+        app_printf("%lu: => Watch saw motion, shift (%ld,%ld)\n", frame_count, frame_report.dx / GRAD_SCALE_FACTOR,
+                   frame_report.dy / GRAD_SCALE_FACTOR);
+    }
+    if (state == NV_TLM_WATCHING) {
+        app_printf("%lu: => Watching change=%u threshold=%u\n", frame_count, frame_report.change_q8,
+                   frame_report.threshold_q8);
+    } else if (state == NV_TLM_STILL) {
+        app_printf("%lu: => No motion confidence=%u\n", frame_count, frame_report.confidence);
+    } else if (state >= NV_TLM_UP && state <= NV_TLM_UNKNOWN) {
+        app_printf("%lu: => %s dy=%ld\n", frame_count, directions[state - NV_TLM_UP], frame_report.dy);
+    } else if (state == NV_TLM_FAILED) {
+        app_printf("%lu: Optical flow failed\n", frame_count);
+    }
+    if (frame_report.flags & NV_TLM_FLAG_BACK_TO_WATCH) {
+        app_printf("%lu: => Back to watching\n", frame_count);
+    }
+#endif
+}
+
+static void send_event(void) {
+    const MotionClass *mc = &motion_class;
+#if APP_TELEMETRY
+    NvTlmEvent e = { frame_count, (uint8_t)mc->direction, (uint8_t)mc->previous, mc->confidence, mc->duration,
+                     mc->dx, mc->dy, mc->magnitude, mc->speed };
+    nv_tlm_send_event(&telemetry, &e);
+#else
+    uint32_t centi_px = (uint32_t)(((uint64_t)mc->magnitude * 100) >> 14);
+    app_printf("%lu: => Event %s (was %s for %lu frames), %lu.%02lu px/frame, %lu px/s, confidence %u\n",
+               frame_count, motion_class_name(mc->direction), motion_class_name(mc->previous), mc->duration,
+               centi_px / 100, centi_px % 100, mc->speed >> 14, mc->confidence);
+#endif
+}
+
+/*
+ * Every frame goes through the classifier. nv_params.events picks what goes
+ * out: a MOTION report per frame, EVENT reports on classifier changes, or
+ * both. With events only nothing is sent while the motion holds.
+ */
+static void send_frame_report(nv_tlm_state_t state) {
+    int changed = 0;
+    if (state >= NV_TLM_UP && state <= NV_TLM_UNKNOWN) {
+        changed = motion_class_update(&motion_class, frame_report.dx, frame_report.dy, frame_report.confidence);
+    } else if (state == NV_TLM_STILL) {
+        changed = motion_class_update(&motion_class, 0, 0, frame_report.confidence);
     } else {
-        *dy = p1[1] - p0[1];
-        usart_printf("Optical flow valid: (%ld,%ld)\n", p1[0] >> Q15_SHIFT, p1[1] >> Q15_SHIFT);
-        usart_printf("Computed dy = %ld (approx %ld pixels)\n", *dy, *dy >> Q15_SHIFT);
-        return OK;
+        motion_class_skip(&motion_class);
+    }
+    if (changed && nv_params.events != 0) send_event();
+    if (nv_params.events != 1) send_motion_report(state);
+    memset(&frame_report, 0, sizeof(frame_report));
+}
+
+/*
+ * Frames missed: timer ticks while busy, or uploads that found both slots busy
+ */
+static uint32_t frames_dropped(void) {
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    return upload_stats()->dropped;
+#else
+    return dropped_frames;
+#endif
+}
+
+static void send_stats(uint32_t fps_x100) {
+#if APP_TELEMETRY
+    NvTlmStats stats;
+    stats.frames = saturate_u16(stats_frames);
+    stats.still = saturate_u16(stats_static);
+    stats.watching = saturate_u16(stats_watching);
+    stats.fps_x100 = saturate_u16(fps_x100);
+    stats.target_fps = (uint8_t)target_fps;
+    stats.dropped = frames_dropped();
+    stats.tx_dropped = usart_tx_stats()->dropped_bytes;
+    nv_tlm_send_stats(&telemetry, &stats);
+#else
+    app_printf("FPS: %lu.%02lu (target %lu), dropped %lu, static %lu/%lu, watching %lu/%lu, tx dropped %lu B\n",
+               fps_x100 / 100, fps_x100 % 100, target_fps, frames_dropped(), stats_static, stats_frames,
+               stats_watching, stats_frames, usart_tx_stats()->dropped_bytes);
+#endif
+}
+
+/*
+ * Stage timings; with telemetry the header stays text and each stage is one
+ * PROFILE message
+ */
+static void report_profile(void) {
+#if APP_TELEMETRY && NV_PROFILE
+    NvProfSummary s;
+    NvTlmProfile p;
+
+    app_printf("Profile (%s):\n", NV_PROF_UNIT);
+    app_printf("  %-9s %7s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "min", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < NV_PROF_NUM_STAGES; i++) {
+        if (!nv_profile_summary((nv_prof_stage_t)i, &s)) continue;
+        p.stage = (uint8_t)i;
+        p.unit = 1;
+        p.count = s.count;
+        p.min = s.min;
+        p.mean = s.mean;
+        p.p50 = s.p50;
+        p.p90 = s.p90;
+        p.p99 = s.p99;
+        p.max = s.max;
+        nv_tlm_send_profile(&telemetry, &p);
     }
+#else
+    nv_profile_report(app_printf);
+#endif
+}
+
+static void report_frame(void) {
+    nv_tlm_state_t state = NV_TLM_NO_REFERENCE;
+
+    if (last_watching) {
+#if APP_WATCH
+        frame_report.change_q8 = saturate_u16(watch.change_q8);
+        frame_report.threshold_q8 = saturate_u16(watch.threshold_q8);
+#endif
+        state = NV_TLM_WATCHING;
+        stats_watching++;
+    } else if (!last_moving) {
+        frame_report.confidence = motion_gate.confidence;
+        state = NV_TLM_STILL;
+        stats_static++;
+    } else if (last_status == OK) {
+        if (last_dy > nv_params.threshold) {
+            state = NV_TLM_UP;
+        } else if (last_dy < -nv_params.threshold) {
+            state = NV_TLM_DOWN;
+        } else {
+            state = NV_TLM_UNKNOWN;
+        }
+    } else if (have_reference) {
+        state = NV_TLM_FAILED;
+    }
+    send_frame_report(state);
+
+    stats_frames++;
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t elapsed_ms = sl_sleeptimer_tick_to_ms(now - stats_start_tick);
+    if (elapsed_ms >= APP_STATS_PERIOD_MS) {
+        send_stats(stats_frames * 100000 / elapsed_ms);
+        stats_frames = 0;
+        stats_static = 0;
+        stats_watching = 0;
+        stats_start_tick = now;
+    }
+}
+
+/*
+ * Run one pipeline stage. Each call does a bounded amount of work so the
+ * super loop keeps servicing the SDK between stages.
+ */
+static void step_pipeline(void) {
+    FrameData *curr = &ctx.frames[cur_frame];
+    FrameData *prev = &ctx.frames[cur_frame ^ 1];
+
+    switch (app_state) {
+    case APP_STATE_IDLE:
+        apply_params();
+        if (frame_available()) {
+            app_state = APP_STATE_CAPTURE;  // before clearing, so a tick in between counts as dropped
+            frame_due = 0;
+            NV_PROF_BEGIN(NV_PROF_FRAME);
+        }
+        break;
+    case APP_STATE_CAPTURE:
+        last_watching = 0;
+        if (capture_next_frame() != OK) {
+            app_state = APP_STATE_IDLE;
+        } else {
+            app_state = watch_due() ? APP_STATE_WATCH : APP_STATE_CONVERT;
+        }
+        break;
+    case APP_STATE_WATCH: {
+        // Convert and build the pyramid only once the watch sees motion;
+        // coded frames were decoded for it already
+        int status = watch_frame(curr);
+        if (status == BUSY) break;
+        if (status != OK) {
+            app_state = APP_STATE_IDLE;
+        } else if (last_watching) {
+            app_state = APP_STATE_REPORT;
+        } else {
+            app_state = capture_src.format > PIXFMT_GRAY8 ? APP_STATE_PYRAMID : APP_STATE_CONVERT;
+        }
+        break;
+    }
+    case APP_STATE_CONVERT: {
+        int status = convert_frame(curr);
+        if (status != BUSY) app_state = status == OK ? APP_STATE_PYRAMID : APP_STATE_IDLE;
+        break;
+    }
+    case APP_STATE_PYRAMID:
+        build_pyramid(curr);
+        app_state = APP_STATE_TRACK;
+        break;
+    case APP_STATE_TRACK:
+        last_moving = !have_reference || scene_moved(prev, curr);
+        if (last_moving) {
+            last_status = have_reference ? calculate_motion(prev, curr, &last_dy) : ERROR;
+            prepare_reference(curr);
+        }
+        watch_feedback();
+        app_state = APP_STATE_REPORT;
+        break;
+    case APP_STATE_REPORT:
+        report_frame();
+        NV_PROF_END(NV_PROF_FRAME);
+        frame_count++;
+        // A static frame leaves the reference and its features in place and
+        // its slot is reused by the next frame
+        if (last_moving) {
+            have_reference = 1;
+            cur_frame ^= 1;
+        }
+        app_state = APP_STATE_IDLE;
+        break;
+    }
+}
+
+/*
+ * Nothing to do until an interrupt: idle with no frame to start, or an
+ * upload's next rows still on the way
+ */
+static int waiting(void) {
+    if (app_state == APP_STATE_IDLE) return !frame_available();
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    if (app_state == APP_STATE_CONVERT) {
+        return upload_rows_ready(&captured) == converted_rows && !upload_complete(&captured);
+    }
+    if (app_state == APP_STATE_WATCH) {
+        return upload_rows_ready(&captured) == arrived_rows && !upload_complete(&captured);
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Sleep until the next frame tick or upload byte. Interrupts are masked
+ * around the check so one arriving in between still wakes the core from WFI.
+ */
+static void sleep_until_next_frame(void) {
+    __disable_irq();
+    if (waiting()) {
+#if APP_SLEEP_EM == 2 && APP_SOURCE != APP_SOURCE_UPLOAD
+        // HF clocks stop in EM2, so sleep in EM1 while the USART still drains
+        // the TX ring; its interrupts wake the core, the next tick retries EM2
+        if (usart_tx_idle()) {
+            EMU_EnterEM2(true);
+        } else {
+            EMU_EnterEM1();
+        }
+#else
+        // EM1 for uploads and the console: the USART does not receive in EM2
+        EMU_EnterEM1();
+#endif
+    }
+    __enable_irq();
 }
 
 /*********************************************************************************
  * Initialize application.
  ***********************************************************************************/
 void app_init(void) {
+    nv_stack_paint();
     usart_init();
-    ov2640_init(HEIGHT, WIDTH);
     usart_set_rx_callback(rx_callback);
-    usart_printf("Hello from xG24\nStarting...\n");
+    nv_tlm_init(&telemetry, usart_write);
+#if APP_TELEMETRY
+    nv_log_to_telemetry(&telemetry);
+#else
+    nv_log_to_text(app_vprintf);
+#endif
+    app_printf("Hello from xG24\nStarting...\n");
+    // The arena could grow into the heap region beyond the SL_HEAP_SIZE minimum
+    nv_mem_budget_report(sizeof(arena) + nv_mem_heap_region() - SL_HEAP_SIZE, app_printf);
 
-    FrameData frame1_data, frame2_data;
-    int32_t dy = 0;
-
-    process_single_frame(1, &frame1_data);
-    process_single_frame(2, &frame2_data);
-    calculate_motion(&frame1_data, &frame2_data, frame1_data.feature_point, frame2_data.feature_point, &dy);
-
-    const int16_t THRESHOLD = 205; // 0.0125 in Q15
-    if (dy > THRESHOLD) {
-        usart_printf("=> Up\n");
-    } else if (dy < -THRESHOLD) {
-        usart_printf("=> Down\n");
-    } else {
-        usart_printf("=> Unknown\n");
+    if (open_capture() != OK || setup_context() != OK) {
+        return;
     }
-    usart_printf("Final dy=%ld\n", dy);
-
+    nv_mem_track_static(NV_MEM_TAG_ARENA, sizeof(arena));
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    nv_mem_track_static(NV_MEM_TAG_FRAMES, sizeof(upload_slots));
+#endif
+    nv_mem_report(app_printf);
+    motion_gate_init(&motion_gate);
+    motion_class_init(&motion_class);
+    nv_profile_init();
+    stats_start_tick = sl_sleeptimer_get_tick_count();
+    start_frame_timer((uint32_t)nv_params.fps);
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+    app_printf("Streaming uploads of %dx%d, format %d\n", capture_src.width, capture_src.height, capture_src.format);
+#else
+    app_printf("Streaming at %lu fps\n", target_fps);
+#endif
 }
 
 /********************************************************************************//**
  * App ticking function.
  ***********************************************************************************/
 void app_process_action(void) {
+    step_pipeline();
+    if (app_state == APP_STATE_IDLE && console_ack) {
+        console_ack = 0;
+        app_printf("OK:\n");
+    }
+    if (app_state == APP_STATE_IDLE && console_request) {
+        if (console_request == 'p') {
+            report_profile();
+        } else if (console_request == 'r') {
+            nv_profile_reset();
+        } else {
+            const usart_tx_stats_t *tx = usart_tx_stats();
+            nv_mem_report(app_printf);
+            app_printf("  usart tx %lu B, ring high water %lu B, dropped %lu B in %lu writes\n", tx->bytes,
+                         tx->high_water, tx->dropped_bytes, tx->dropped_writes);
+#if APP_SOURCE == APP_SOURCE_UPLOAD
+            const upload_stats_t *up = upload_stats();
+            app_printf("  upload %lu B, %lu frames, dropped %lu, bad header %lu, bad CRC %lu, stalled %lu\n",
+                       up->bytes, up->frames, up->dropped, up->bad_header, up->bad_crc, up->aborted);
+#endif
+        }
+        console_request = 0;
+    }
+    if (app_state == APP_STATE_IDLE && command_ready) {
+        if (command_line[0] == '\0') {
+            app_printf("Error: command longer than %d\n", NV_PARAMS_MAX_LINE);
+        } else {
+            nv_params_command(command_line, app_printf);
+        }
+        command_ready = 0;
+    }
+    if (app_state == APP_STATE_IDLE || app_state == APP_STATE_CONVERT) {
+        sleep_until_next_frame();
+    }
 }
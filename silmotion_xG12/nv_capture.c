@@ -0,0 +1,208 @@
+/*
+ * nv_capture.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ */
+#include "nv_capture.h"
+#include <stddef.h>
+#include <string.h>
+#include "nv_optical_flow.h"
+#include "nv_mx25.h"
+#include "nv_codec.h"
+#include "nv_jpeg.h"
+
+static uint8_t row_buffer[CAPTURE_CHUNK_ROWS * CAPTURE_MAX_ROW_BYTES] __attribute__((aligned(4)));
+
+static void init_source(CaptureSource *src, capture_backend_t backend, int width, int height, pixfmt_t format) {
+  memset(src, 0, sizeof(*src));
+  src->backend = backend;
+  src->width = width;
+  src->height = height;
+  src->format = format;
+}
+
+int capture_open_arrays(CaptureSource *src, const void *const *frames, uint32_t count,
+                        int width, int height, pixfmt_t format) {
+  init_source(src, CAPTURE_ARRAYS, width, height, format);
+  src->frames = frames;
+  src->num_frames = count;
+  return frames != NULL && count > 0;
+}
+
+static int check_header(const NvSeqHeader *hdr, uint8_t max_format) {
+  return hdr->format <= max_format && hdr->width > 0 && hdr->height > 0;
+}
+
+/*
+ * JPEG frames are decoded at 1/(1 << jpeg_scale) size; their headers are
+ * checked here against the sequence header
+ */
+int capture_open_sequence(CaptureSource *src, const uint8_t *data, uint32_t size, int jpeg_scale) {
+  init_source(src, CAPTURE_SEQUENCE, 0, 0, PIXFMT_RGB565);
+  if (!nvsq_open_memory(&src->seq, data, size) || !check_header(src->seq.hdr, NVSQ_FMT_JPEG)) return 0;
+  if (src->seq.hdr->format == NVSQ_FMT_JPEG) {
+    if (jpeg_scale != JPEG_SCALE_1_8 && jpeg_scale != JPEG_SCALE_1_4) return 0;
+    for (uint32_t i = 0; i < src->seq.hdr->frame_count; i++) {
+      uint32_t frame_size;
+      const uint8_t *frame = nvsq_frame(&src->seq, i, &frame_size);
+      int width, height;
+      if (!jpeg_read_size(frame, frame_size, &width, &height) ||
+          width != src->seq.hdr->width || height != src->seq.hdr->height) return 0;
+    }
+    src->jpeg_scale = jpeg_scale;
+  }
+  src->width = src->seq.hdr->width >> src->jpeg_scale;
+  src->height = src->seq.hdr->height >> src->jpeg_scale;
+  src->format = (pixfmt_t)src->seq.hdr->format;
+  src->num_frames = src->seq.hdr->frame_count;
+  return 1;
+}
+
+/*
+ * Only the header is read here; frame offsets are fetched per frame
+ */
+int capture_open_mx25(CaptureSource *src, uint32_t address) {
+  NvSeqHeader hdr;
+
+  init_source(src, CAPTURE_MX25, 0, 0, PIXFMT_RGB565);
+  mx25_init();
+  mx25_read(address, (uint8_t *)&hdr, sizeof(hdr));
+  if (hdr.magic != NVSQ_MAGIC || hdr.version != NVSQ_VERSION || hdr.frame_count == 0 || !check_header(&hdr, NVSQ_FMT_GRAY8)) return 0;
+  if ((uint32_t)hdr.width * pixfmt_bytes_per_pixel((pixfmt_t)hdr.format) > CAPTURE_MAX_ROW_BYTES) return 0;
+
+  src->width = hdr.width;
+  src->height = hdr.height;
+  src->format = (pixfmt_t)hdr.format;
+  src->num_frames = hdr.frame_count;
+  src->mx25_base = address;
+  src->mx25_index = address + hdr.index_offset;
+  return 1;
+}
+
+/*
+ * Geometry only: frames come from upload_take(), not capture_frame()
+ */
+int capture_open_upload(CaptureSource *src, int width, int height, pixfmt_t format) {
+  init_source(src, CAPTURE_UPLOAD, width, height, format);
+  return format <= PIXFMT_GRAY8 && width > 0 && height > 0;
+}
+
+/*
+ * Look up frame index. Nothing is copied: flash frames come back as views,
+ * MX25 frames as an address for capture_to_gray() to stream from.
+ */
+int capture_frame(CaptureSource *src, uint32_t index, CaptureFrame *frame) {
+  uint32_t frame_bytes = (uint32_t)src->width * src->height * pixfmt_bytes_per_pixel(src->format);
+  uint32_t size = 0;
+
+  if (index >= src->num_frames) return 0;
+  frame->index = index;
+  frame->data = NULL;
+  frame->address = 0;
+  frame->stride = (uint32_t)src->width * pixfmt_bytes_per_pixel(src->format);
+  frame->size = frame_bytes;
+
+  switch (src->backend) {
+  case CAPTURE_ARRAYS:
+    frame->data = (const uint8_t *)src->frames[index];
+    return 1;
+  case CAPTURE_SEQUENCE:
+    frame->data = nvsq_frame(&src->seq, index, &size);
+    frame->size = size;
+    // coded frames are checked as they are decoded
+    return frame->data != NULL &&
+           (src->format == PIXFMT_RGB565_DRLE || src->format == PIXFMT_JPEG || size >= frame_bytes);
+  case CAPTURE_MX25: {
+    uint32_t offsets[2];
+    mx25_read(src->mx25_index + index * sizeof(uint32_t), (uint8_t *)offsets, sizeof(offsets));
+    frame->address = src->mx25_base + offsets[0];
+    return offsets[1] >= offsets[0] && offsets[1] - offsets[0] >= frame_bytes;
+  }
+  case CAPTURE_UPLOAD:
+    break;
+  }
+  return 0;
+}
+
+static void rows_to_gray(pixfmt_t format, const uint8_t *rows, unsigned char *gray, int width, int count) {
+  if (format == PIXFMT_RGB565) {
+    rgb565_to_grayscale((const uint16_t *)rows, gray, width, count);
+  } else if (format == PIXFMT_YUYV) {
+    for (int i = 0; i < width * count; i++) gray[i] = rows[i * 2];
+  } else {
+    memcpy(gray, rows, (size_t)width * count);
+  }
+}
+
+static void sample_row(pixfmt_t format, const uint8_t *row, unsigned char *gray, int first, int step, int width) {
+  for (int x = 0, i = first; x < width; x++, i += step) {
+    if (format == PIXFMT_RGB565) {
+      gray[x] = rgb565_pixel_to_gray(((const uint16_t *)row)[i]);
+    } else if (format == PIXFMT_YUYV) {
+      gray[x] = row[i * 2];
+    } else {
+      gray[x] = row[i];
+    }
+  }
+}
+
+/*
+ * Convert a frame to gray, reading it exactly once. Views are converted
+ * (or decoded) straight from flash; MX25 frames go through row_buffer a
+ * chunk at a time. Returns 0 on a corrupt coded frame.
+ */
+int capture_to_gray(const CaptureSource *src, const CaptureFrame *frame, unsigned char *gray) {
+  if (src->format == PIXFMT_RGB565_DRLE) {
+    return drle_decode_gray(frame->data, frame->size, gray, (uint32_t)src->width * src->height);
+  }
+  if (src->format == PIXFMT_JPEG) {
+    return jpeg_decode_gray(frame->data, frame->size, src->jpeg_scale, gray, src->width, src->height);
+  }
+  if (frame->data != NULL) {
+    rows_to_gray(src->format, frame->data, gray, src->width, src->height);
+    return 1;
+  }
+  for (int row = 0; row < src->height; row += CAPTURE_CHUNK_ROWS) {
+    int count = src->height - row < CAPTURE_CHUNK_ROWS ? src->height - row : CAPTURE_CHUNK_ROWS;
+    mx25_read(frame->address + (uint32_t)row * frame->stride, row_buffer, frame->stride * (uint32_t)count);
+    rows_to_gray(src->format, row_buffer, gray + row * src->width, src->width, count);
+  }
+  return 1;
+}
+
+/*
+ * Convert rows [first_row, first_row + count) of an uncoded view, e.g. the
+ * rows of an upload that have arrived so far
+ */
+int capture_rows_to_gray(const CaptureSource *src, const CaptureFrame *frame, unsigned char *gray,
+                         int first_row, int count) {
+  if (frame->data == NULL || src->format > PIXFMT_GRAY8 || first_row < 0 || first_row + count > src->height) return 0;
+  rows_to_gray(src->format, frame->data + (uint32_t)first_row * frame->stride, gray + first_row * src->width,
+               src->width, count);
+  return 1;
+}
+
+/*
+ * Every step-th pixel of every step-th row, starting step / 2 in, as
+ * width x height gray samples for the watch stage (nv_watch.h). Only the
+ * sampled pixels are read, and MX25 frames only read the sampled rows.
+ * Returns 0 for coded formats, which have to be decoded whole.
+ */
+int capture_sample_gray(const CaptureSource *src, const CaptureFrame *frame, unsigned char *gray,
+                        int step, int width, int height) {
+  int first = step >> 1;
+
+  if (src->format > PIXFMT_GRAY8) return 0;
+  for (int y = 0; y < height; y++) {
+    uint32_t offset = (uint32_t)(first + y * step) * frame->stride;
+    const uint8_t *row = row_buffer;
+    if (frame->data != NULL) {
+      row = frame->data + offset;
+    } else {
+      mx25_read(frame->address + offset, row_buffer, frame->stride);
+    }
+    sample_row(src->format, row, gray + y * width, first, step, width);
+  }
+  return 1;
+}
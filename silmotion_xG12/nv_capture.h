@@ -0,0 +1,74 @@
+/*
+ * nv_capture.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Replay capture for the firmware. Frames are never copied into RAM whole:
+ * internal flash is memory mapped, so frames in it (compiled-in arrays or an
+ * NVSQ image linked with utils/nvsq.py asm) are returned as read-only views
+ * and converted straight from flash. Frames in an NVSQ image in the external
+ * MX25 flash are streamed through a small row buffer instead.
+ *
+ * NVSQ images in internal flash may hold DRLE coded frames (nv_codec.h),
+ * which capture_to_gray() decodes and converts in one pass, or JPEG frames
+ * (nv_jpeg.h), decoded at 1/8 or 1/4 size. The MX25 backend takes uncoded
+ * frames only, since it streams whole rows.
+ *
+ * The watch stage samples uncoded frames with capture_sample_gray() instead
+ * of converting them.
+ *
+ * Uploaded frames (nv_upload.h) are views too, onto a RAM slot that is
+ * still filling; capture_rows_to_gray() converts them as rows arrive.
+ */
+#ifndef NV_CAPTURE_H_
+#define NV_CAPTURE_H_
+#include <stdint.h>
+#include "nv_context.h"
+#include "nv_sequence.h"
+
+#define CAPTURE_CHUNK_ROWS 4        // rows per SPI read for the MX25 backend
+#define CAPTURE_MAX_ROW_BYTES 640   // widest row the MX25 row buffer takes
+
+typedef enum {
+  CAPTURE_ARRAYS,       // const frame arrays in internal flash
+  CAPTURE_SEQUENCE,     // NVSQ image in internal flash
+  CAPTURE_MX25,         // NVSQ image in the external SPI flash
+  CAPTURE_UPLOAD        // frames uploaded over the USART, nv_upload.h
+} capture_backend_t;
+
+typedef struct {
+  capture_backend_t backend;
+  int width, height;             // after JPEG scaling
+  pixfmt_t format;
+  int jpeg_scale;
+  uint32_t num_frames;
+
+  const void *const *frames;    // CAPTURE_ARRAYS
+  NvSequence seq;               // CAPTURE_SEQUENCE
+  uint32_t mx25_base;           // CAPTURE_MX25: address of the NVSQ header
+  uint32_t mx25_index;          // CAPTURE_MX25: absolute address of the frame index
+} CaptureSource;
+
+typedef struct {
+  uint32_t index;
+  const uint8_t *data;          // read-only view onto flash, NULL when streamed
+  uint32_t address;             // MX25 address of the frame
+  uint32_t stride;              // bytes per row, for uncoded formats
+  uint32_t size;                // bytes of the stored frame
+} CaptureFrame;
+
+int capture_open_arrays(CaptureSource *src, const void *const *frames, uint32_t count,
+                        int width, int height, pixfmt_t format);
+int capture_open_sequence(CaptureSource *src, const uint8_t *data, uint32_t size, int jpeg_scale);
+int capture_open_mx25(CaptureSource *src, uint32_t address);
+int capture_open_upload(CaptureSource *src, int width, int height, pixfmt_t format);
+
+int capture_frame(CaptureSource *src, uint32_t index, CaptureFrame *frame);
+int capture_to_gray(const CaptureSource *src, const CaptureFrame *frame, unsigned char *gray);
+int capture_rows_to_gray(const CaptureSource *src, const CaptureFrame *frame, unsigned char *gray,
+                         int first_row, int count);
+int capture_sample_gray(const CaptureSource *src, const CaptureFrame *frame, unsigned char *gray,
+                        int step, int width, int height);
+
+#endif /* NV_CAPTURE_H_ */
@@ -0,0 +1,54 @@
+#include "nv_codec.h"
+#include <string.h>
+#include "nv_optical_flow.h"
+
+/*
+ * Decode one DRLE frame from in[0..size) into pixels gray bytes, converting
+ * each pixel as it is reconstructed. Trailing bytes after the last pixel are
+ * ignored (container padding). Returns 0 on a truncated or overlong stream.
+ */
+int drle_decode_gray(const uint8_t *in, uint32_t size, unsigned char *gray, uint32_t pixels) {
+    uint32_t pos = 0, out = 0;
+    unsigned r = 0, g = 0, b = 0;
+    unsigned char value = rgb565_pixel_to_gray(0);
+
+    while (out < pixels) {
+        if (pos >= size) return 0;
+        uint8_t token = in[pos++];
+        uint32_t count = (uint32_t)(token & 0x3F) + 1;
+
+        switch (token & 0xC0) {
+        case DRLE_OP_RUN:
+            if (count > pixels - out) return 0;
+            memset(gray + out, value, count);
+            out += count;
+            continue;
+        case DRLE_OP_DIFF:
+            r = (r + ((token >> 4) & 3) - 2) & 0x1F;
+            g = (g + ((token >> 2) & 3) - 2) & 0x3F;
+            b = (b + (token & 3) - 2) & 0x1F;
+            break;
+        case DRLE_OP_DELTA:
+            if (pos >= size) return 0;
+            g = (g + (token & 0x3F) - 32) & 0x3F;
+            r = (r + (in[pos] >> 4) - 8) & 0x1F;
+            b = (b + (in[pos] & 0x0F) - 8) & 0x1F;
+            pos++;
+            break;
+        default:
+            if (count > pixels - out || count * 2 > size - pos) return 0;
+            for (uint32_t i = 0; i < count; i++, pos += 2) {
+                uint16_t pixel = (uint16_t)(in[pos] | (in[pos + 1] << 8));
+                gray[out++] = rgb565_pixel_to_gray(pixel);
+                r = pixel >> 11;
+                g = (pixel >> 5) & 0x3F;
+                b = pixel & 0x1F;
+            }
+            value = gray[out - 1];
+            continue;
+        }
+        value = rgb565_pixel_to_gray((uint16_t)((r << 11) | (g << 5) | b));
+        gray[out++] = value;
+    }
+    return 1;
+}
@@ -0,0 +1,81 @@
+#include "nv_context.h"
+#include <stddef.h>
+#include <string.h>
+
+#define ALIGN4(n) (((n) + 3u) & ~3u)
+
+int pixfmt_bytes_per_pixel(pixfmt_t format) {
+    return format == PIXFMT_GRAY8 || format == PIXFMT_JPEG ? 1 : 2;
+}
+
+/*
+ * Compute the level geometry and buffer sizes. Nothing is allocated.
+ * Returns 0 when the geometry cannot be processed: the coarsest level must
+ * still hold a full tracking window plus the gradient border.
+ */
+int nv_context_init(NvContext *ctx, int width, int height, pixfmt_t format, int levels, unsigned flags) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (width > NV_MAX_DIMENSION || height > NV_MAX_DIMENSION) return 0;
+    if (levels < 1 || levels > NV_MAX_LEVELS) return 0;
+    if ((width >> (levels - 1)) < WINDOW_SIZE + 2 || (height >> (levels - 1)) < WINDOW_SIZE + 2) return 0;
+    if ((unsigned)format > PIXFMT_JPEG) return 0;
+    // Coded frames are decoded from where they are stored, never captured
+    if ((format == PIXFMT_RGB565_DRLE || format == PIXFMT_JPEG) && !(flags & NV_CTX_EXTERNAL_FRAMES)) return 0;
+    if (format == PIXFMT_YUYV && (width & 1)) return 0;
+
+    ctx->width = width;
+    ctx->height = height;
+    ctx->format = format;
+    ctx->levels = levels;
+    ctx->flags = flags;
+
+    uint32_t pixels = 0;
+    for (int l = 0; l < levels; l++) {
+        ctx->level_width[l] = width >> l;
+        ctx->level_height[l] = height >> l;
+        ctx->level_offset[l] = pixels;
+        pixels += (uint32_t)ctx->level_width[l] * ctx->level_height[l];
+    }
+
+    ctx->frame_bytes = (uint32_t)width * height * pixfmt_bytes_per_pixel(format);
+    ctx->pyr_bytes = ALIGN4(pixels);
+    ctx->slot_bytes = ctx->pyr_bytes;
+    if (!(flags & NV_CTX_EXTERNAL_FRAMES) && ctx->frame_bytes > ctx->slot_bytes) {
+        ctx->slot_bytes = ALIGN4(ctx->frame_bytes);
+    }
+
+    // Level 0 sits where the converted gray lands, which is why the levels
+    // are laid out from the start of the slot
+    ctx->mem_bytes = 2 * ctx->slot_bytes;
+    return 1;
+}
+
+uint32_t nv_context_mem_required(const NvContext *ctx) {
+    return ctx->mem_bytes;
+}
+
+/*
+ * Point the two slots into arena, which must be 4-byte aligned and at
+ * least nv_context_mem_required() bytes
+ */
+int nv_context_bind(NvContext *ctx, void *arena, uint32_t size) {
+    if (arena == NULL || ((uintptr_t)arena & 3) != 0 || ctx->mem_bytes == 0 || size < ctx->mem_bytes) return 0;
+
+    for (int f = 0; f < 2; f++) {
+        unsigned char *slot = (unsigned char *)arena + f * ctx->slot_bytes;
+        for (int l = 0; l < ctx->levels; l++) {
+            ctx->frames[f].pyr[l] = slot + ctx->level_offset[l];
+        }
+        ctx->frames[f].num_features = 0;
+    }
+    return 1;
+}
+
+void nv_context_report(const NvContext *ctx, int (*print)(const char *format, ...)) {
+    print("Context %dx%d, %d levels, arena %lu B:\n", ctx->width, ctx->height, ctx->levels,
+          (unsigned long)ctx->mem_bytes);
+    for (int f = 0; f < 2; f++) {
+        print("  frame%d     %7lu B @ %7lu  %s\n", f, (unsigned long)ctx->slot_bytes,
+              (unsigned long)(f * ctx->slot_bytes), ctx->flags & NV_CTX_EXTERNAL_FRAMES ? "pyramid" : "capture, pyramid");
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * nv_context.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Processing context for one image geometry. nv_context_init() works out
+ * every buffer size from (width, height, format, levels) without allocating
+ * anything, nv_context_mem_required() gives the arena size, and
+ * nv_context_bind() points the buffers into a caller-owned arena.
+ *
+ * Each frame owns one slot that is first its capture buffer and then its
+ * pyramid: the frame is converted to gray in place at the front of the slot
+ * and the coarse levels go into the freed upper half. With
+ * NV_CTX_EXTERNAL_FRAMES the frames are read from elsewhere (a mapped file,
+ * flash) and the slots only hold the pyramids. The two slots ping-pong
+ * between current and reference, so both live across frames and the arena
+ * is simply the two of them back to back.
+ */
+#ifndef NV_CONTEXT_H_
+#define NV_CONTEXT_H_
+#include <stdint.h>
+#include "nv_optical_flow.h"
+
+#define NV_MAX_LEVELS 5
+#define NV_MAX_DIMENSION 4096       // keeps Q14 coordinates inside int32
+
+// nv_context_init() flags
+#define NV_CTX_EXTERNAL_FRAMES 0x01 // frames never land in the arena
+
+typedef enum {
+    PIXFMT_RGB565,      // little-endian uint16 per pixel
+    PIXFMT_YUYV,        // YUV 4:2:2, Y0 U Y1 V
+    PIXFMT_GRAY8,
+    PIXFMT_RGB565_DRLE, // RGB565 coded with nv_codec.h, stored frames only
+    PIXFMT_JPEG         // baseline JPEG decoded at reduced size by nv_jpeg.h
+} pixfmt_t;
+
+typedef struct {
+    unsigned char *pyr[NV_MAX_LEVELS];     // pyr[0] is also the start of the capture slot
+    int32_t feature_points[MAX_FEATURES][2];
+    int num_features;
+} FrameData;
+
+typedef struct {
+    int width, height;
+    pixfmt_t format;
+    int levels;
+    unsigned flags;
+    int level_width[NV_MAX_LEVELS];
+    int level_height[NV_MAX_LEVELS];
+    uint32_t level_offset[NV_MAX_LEVELS];   // pixel offset of each level inside a pyramid
+
+    uint32_t frame_bytes;       // one input frame in its pixel format
+    uint32_t pyr_bytes;         // one gray pyramid, all levels
+    uint32_t slot_bytes;        // capture then pyramid, or only the pyramid for external frames
+    uint32_t mem_bytes;         // arena size needed by nv_context_bind(), both slots
+
+    FrameData frames[2];        // current and reference, valid after bind
+} NvContext;
+
+int pixfmt_bytes_per_pixel(pixfmt_t format);     // decoded size for coded formats
+
+int nv_context_init(NvContext *ctx, int width, int height, pixfmt_t format, int levels, unsigned flags);
+uint32_t nv_context_mem_required(const NvContext *ctx);
+int nv_context_bind(NvContext *ctx, void *arena, uint32_t size);
+void nv_context_report(const NvContext *ctx, int (*print)(const char *format, ...));
+
+#endif /* NV_CONTEXT_H_ */
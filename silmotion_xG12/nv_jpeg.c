@@ -0,0 +1,397 @@
+#include "nv_jpeg.h"
+#include <stddef.h>
+
+#define M_SOF0 0xC0
+#define M_SOF1 0xC1
+#define M_DHT 0xC4
+#define M_RST0 0xD0
+#define M_SOI 0xD8
+#define M_EOI 0xD9
+#define M_SOS 0xDA
+#define M_DQT 0xDB
+#define M_DRI 0xDD
+
+#define JPEG_MAX_COMPONENTS 3
+#define JPEG_QUANT_TERMS 5      // zigzag 0..4 covers (0,0) (0,1) (1,0) (1,1)
+
+// Quadrant means of the 8x8 inverse DCT from the lowest terms, Q12:
+// 1/8 for DC, cos sums over half a block for the first AC terms
+#define K_DC 512
+#define K_AC1 464
+#define K_AC11 420
+
+typedef struct {
+    const uint8_t *values;      // symbols, in place in the DHT segment
+    int32_t maxcode[17];        // -1 when no code has this length
+    uint16_t mincode[17];
+    uint16_t valptr[17];
+    int defined;
+} JpegHuff;
+
+typedef struct {
+    int id, h, v, tq;
+    int td, ta;                 // Huffman tables of the current scan
+    int32_t pred;               // DC predictor
+} JpegComponent;
+
+typedef struct {
+    int width, height;
+    int num_components, hmax, vmax;
+    JpegComponent comp[JPEG_MAX_COMPONENTS];
+    uint16_t quant[4][JPEG_QUANT_TERMS];
+    JpegHuff dc[2], ac[2];      // baseline allows two of each
+    int restart_interval;
+} JpegDecoder;
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size, pos;
+    uint32_t bits;              // MSB first
+    int count;
+    int marker;                 // stopped at a marker, zeros are fed from here
+    int padded;                 // zero bytes fed
+} BitReader;
+
+static int read_u16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+/*
+ * Keep at least 25 bits buffered, unstuffing 0xFF00. At a marker or the end
+ * of the data zeros are fed instead, as libjpeg does.
+ */
+static void fill_bits(BitReader *br) {
+    while (br->count <= 24) {
+        uint32_t byte = 0;
+        if (br->marker || br->pos >= br->size) {
+            br->padded++;
+        } else {
+            byte = br->data[br->pos];
+            if (byte == 0xFF) {
+                if (br->pos + 1 < br->size && br->data[br->pos + 1] == 0x00) {
+                    br->pos += 2;
+                } else {
+                    br->marker = 1;
+                    byte = 0;
+                }
+            } else {
+                br->pos++;
+            }
+        }
+        br->bits |= byte << (24 - br->count);
+        br->count += 8;
+    }
+}
+
+static int get_bits(BitReader *br, int n) {
+    if (n == 0) return 0;
+    fill_bits(br);
+    int v = (int)(br->bits >> (32 - n));
+    br->bits <<= n;
+    br->count -= n;
+    return v;
+}
+
+static int32_t extend(int v, int s) {
+    return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+static int huff_decode(BitReader *br, const JpegHuff *h) {
+    int32_t code = 0;
+    fill_bits(br);
+    for (int l = 1; l <= 16; l++) {
+        code = (code << 1) | (int32_t)(br->bits >> 31);
+        br->bits <<= 1;
+        br->count--;
+        if (code <= h->maxcode[l]) return h->values[h->valptr[l] + code - h->mincode[l]];
+    }
+    return -1;
+}
+
+static int build_huff(JpegHuff *h, const uint8_t *counts, const uint8_t *values) {
+    int32_t code = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+        h->valptr[l] = (uint16_t)k;
+        h->mincode[l] = (uint16_t)code;
+        code += counts[l - 1];
+        k += counts[l - 1];
+        h->maxcode[l] = counts[l - 1] ? code - 1 : -1;
+        if (code > (1 << l)) return 0;
+        code <<= 1;
+    }
+    h->values = values;
+    h->defined = 1;
+    return k <= 256;
+}
+
+/*
+ * Marker segments, seg points past the length field
+ */
+static int parse_dqt(JpegDecoder *d, const uint8_t *seg, int len) {
+    while (len > 0) {
+        int pq = seg[0] >> 4, tq = seg[0] & 15;
+        int n = 1 + (pq ? 128 : 64);
+        if (tq > 3 || pq > 1 || len < n) return 0;
+        for (int i = 0; i < JPEG_QUANT_TERMS; i++) {
+            d->quant[tq][i] = (uint16_t)(pq ? read_u16(seg + 1 + i * 2) : seg[1 + i]);
+        }
+        seg += n;
+        len -= n;
+    }
+    return 1;
+}
+
+static int parse_dht(JpegDecoder *d, const uint8_t *seg, int len) {
+    while (len > 17) {
+        int tc = seg[0] >> 4, th = seg[0] & 15;
+        int total = 0;
+        for (int i = 0; i < 16; i++) total += seg[1 + i];
+        if (tc > 1 || th > 1 || len < 17 + total) return 0;
+        if (!build_huff(tc ? &d->ac[th] : &d->dc[th], seg + 1, seg + 17)) return 0;
+        seg += 17 + total;
+        len -= 17 + total;
+    }
+    return len == 0;
+}
+
+static int parse_sof(JpegDecoder *d, const uint8_t *seg, int len) {
+    if (len < 6 || seg[0] != 8) return 0;
+    d->height = read_u16(seg + 1);
+    d->width = read_u16(seg + 3);
+    d->num_components = seg[5];
+    if (d->width == 0 || d->height == 0 || d->num_components < 1 || d->num_components > JPEG_MAX_COMPONENTS) return 0;
+    if (len < 6 + d->num_components * 3) return 0;
+
+    d->hmax = d->vmax = 1;
+    for (int i = 0; i < d->num_components; i++) {
+        JpegComponent *c = &d->comp[i];
+        c->id = seg[6 + i * 3];
+        c->h = seg[7 + i * 3] >> 4;
+        c->v = seg[7 + i * 3] & 15;
+        c->tq = seg[8 + i * 3];
+        if (c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4 || c->tq > 3) return 0;
+        if (c->h > d->hmax) d->hmax = c->h;
+        if (c->v > d->vmax) d->vmax = c->v;
+    }
+    // Luma must be full resolution so its blocks map straight onto the output
+    return d->comp[0].h == d->hmax && d->comp[0].v == d->vmax;
+}
+
+/*
+ * Decode one block. Only the terms up to zigzag 4 are kept, in coef when it
+ * is not NULL; everything else is decoded to stay in sync and dropped.
+ */
+static int decode_block(BitReader *br, JpegDecoder *d, JpegComponent *c, int32_t *coef) {
+    int s = huff_decode(br, &d->dc[c->td]);
+    if (s < 0 || s > 11) return 0;
+    c->pred += s ? extend(get_bits(br, s), s) : 0;
+    if (coef != NULL) {
+        coef[0] = c->pred;
+        coef[1] = coef[2] = coef[3] = coef[4] = 0;
+    }
+
+    for (int k = 1; k < 64; k++) {
+        int rs = huff_decode(br, &d->ac[c->ta]);
+        if (rs < 0) return 0;
+        int r = rs >> 4;
+        s = rs & 15;
+        if (s == 0) {
+            if (r != 15) break;     // end of block
+            k += 15;
+            continue;
+        }
+        k += r;
+        if (k > 63) return 0;
+        int v = get_bits(br, s);
+        if (coef != NULL && k < JPEG_QUANT_TERMS) coef[k] = extend(v, s);
+    }
+    return 1;
+}
+
+static int32_t dequant(int32_t coef, uint16_t q) {
+    int32_t v = coef * q;
+    return v < -16384 ? -16384 : (v > 16383 ? 16383 : v);
+}
+
+static unsigned char clamp_pixel(int32_t v) {
+    return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static void put_block(const JpegDecoder *d, const int32_t *coef, int bx, int by, int scale,
+                      unsigned char *gray, int out_width, int out_height) {
+    const uint16_t *q = d->quant[d->comp[0].tq];
+    int32_t dc = dequant(coef[0], q[0]) * K_DC;
+
+    if (scale == JPEG_SCALE_1_8) {
+        if (bx < out_width && by < out_height) gray[by * out_width + bx] = clamp_pixel(128 + ((dc + 2048) >> 12));
+        return;
+    }
+    int32_t ax = dequant(coef[1], q[1]) * K_AC1;    // zigzag 1 is (0,1), horizontal
+    int32_t ay = dequant(coef[2], q[2]) * K_AC1;
+    int32_t axy = dequant(coef[4], q[4]) * K_AC11;
+    for (int y = 0; y < 2; y++) {
+        int oy = by * 2 + y;
+        if (oy >= out_height) break;
+        for (int x = 0; x < 2; x++) {
+            int ox = bx * 2 + x;
+            if (ox >= out_width) break;
+            int32_t v = dc + (x ? -ax : ax) + (y ? -ay : ay) + (x == y ? axy : -axy);
+            gray[oy * out_width + ox] = clamp_pixel(128 + ((v + 2048) >> 12));
+        }
+    }
+}
+
+/*
+ * RSTn between restart intervals: drop the buffered bits, step over the
+ * marker and reset the DC predictors
+ */
+static int restart(BitReader *br, JpegDecoder *d) {
+    br->bits = 0;
+    br->count = 0;
+    br->marker = 0;
+    br->padded = 0;
+    while (br->pos < br->size && br->data[br->pos] != 0xFF) br->pos++;
+    if (br->pos + 1 >= br->size || (br->data[br->pos + 1] & 0xF8) != M_RST0) return 0;
+    br->pos += 2;
+    for (int i = 0; i < d->num_components; i++) d->comp[i].pred = 0;
+    return 1;
+}
+
+/*
+ * Entropy-coded data of a scan starting at data[pos]. Returns the position
+ * after it, or 0 on error.
+ */
+static uint32_t decode_scan(JpegDecoder *d, JpegComponent **scan, int ns, const uint8_t *data, uint32_t size,
+                            uint32_t pos, int scale, unsigned char *gray, int out_width, int out_height) {
+    BitReader br = { data, size, pos, 0, 0, 0, 0 };
+    int32_t coef[JPEG_QUANT_TERMS];
+    int mcus_x, mcus_y;
+
+    if (ns == 1) {
+        // Non-interleaved: one block per MCU over the component's own grid
+        int cw = (d->width * scan[0]->h + d->hmax - 1) / d->hmax;
+        int ch = (d->height * scan[0]->v + d->vmax - 1) / d->vmax;
+        mcus_x = (cw + 7) / 8;
+        mcus_y = (ch + 7) / 8;
+    } else {
+        mcus_x = (d->width + 8 * d->hmax - 1) / (8 * d->hmax);
+        mcus_y = (d->height + 8 * d->vmax - 1) / (8 * d->vmax);
+    }
+    for (int i = 0; i < d->num_components; i++) d->comp[i].pred = 0;
+
+    for (int my = 0; my < mcus_y; my++) {
+        for (int mx = 0; mx < mcus_x; mx++) {
+            int mcu = my * mcus_x + mx;
+            if (d->restart_interval && mcu > 0 && mcu % d->restart_interval == 0 && !restart(&br, d)) return 0;
+
+            for (int s = 0; s < ns; s++) {
+                JpegComponent *c = scan[s];
+                int luma = c == &d->comp[0];
+                int bh = ns == 1 ? 1 : c->h, bv = ns == 1 ? 1 : c->v;
+                for (int j = 0; j < bv; j++) {
+                    for (int i = 0; i < bh; i++) {
+                        if (!decode_block(&br, d, c, luma ? coef : NULL)) return 0;
+                        if (luma) put_block(d, coef, mx * bh + i, my * bv + j, scale, gray, out_width, out_height);
+                    }
+                }
+            }
+        }
+    }
+    // Bits taken from the zero fill mean the scan was cut short
+    if (br.padded * 8 - br.count > 0) return 0;
+    return br.pos;
+}
+
+/*
+ * Walk the marker segments up to the frame header (size_only) or through the
+ * first scan holding luma. Returns 1 on success.
+ */
+static int parse(JpegDecoder *d, const uint8_t *data, uint32_t size, int size_only,
+                 int scale, unsigned char *gray, int out_width, int out_height) {
+    uint32_t pos = 2;
+    int have_frame = 0;
+
+    if (data == NULL || size < 4 || data[0] != 0xFF || data[1] != M_SOI) return 0;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return 0;
+        int marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;              // fill byte
+            continue;
+        }
+        if (marker == M_EOI) return 0;
+        int len = read_u16(data + pos + 2);
+        if (len < 2 || pos + 2 + len > size) return 0;
+        const uint8_t *seg = data + pos + 4;
+        len -= 2;
+        pos += 2 + 2 + len;
+
+        switch (marker) {
+        case M_SOF0:
+        case M_SOF1:
+            if (!parse_sof(d, seg, len)) return 0;
+            if (size_only) return 1;
+            have_frame = 1;
+            break;
+        case M_DHT:
+            if (!parse_dht(d, seg, len)) return 0;
+            break;
+        case M_DQT:
+            if (!parse_dqt(d, seg, len)) return 0;
+            break;
+        case M_DRI:
+            if (len < 2) return 0;
+            d->restart_interval = read_u16(seg);
+            break;
+        case M_SOS: {
+            JpegComponent *scan[JPEG_MAX_COMPONENTS];
+            int ns = seg[0], has_luma = 0;
+            if (!have_frame || ns < 1 || ns > d->num_components || len < 1 + ns * 2 + 3) return 0;
+            for (int i = 0; i < ns; i++) {
+                scan[i] = NULL;
+                for (int k = 0; k < d->num_components; k++) {
+                    if (d->comp[k].id == seg[1 + i * 2]) scan[i] = &d->comp[k];
+                }
+                if (scan[i] == NULL) return 0;
+                scan[i]->td = seg[2 + i * 2] >> 4;
+                scan[i]->ta = seg[2 + i * 2] & 15;
+                if (scan[i]->td > 1 || scan[i]->ta > 1) return 0;
+                if (!d->dc[scan[i]->td].defined || !d->ac[scan[i]->ta].defined) return 0;
+                has_luma |= scan[i] == &d->comp[0];
+            }
+            if (!has_luma) return 0;
+            return decode_scan(d, scan, ns, data, size, pos, scale, gray, out_width, out_height) != 0;
+        }
+        default:
+            // Progressive, lossless and arithmetic-coded frames
+            if (marker >= 0xC2 && marker <= 0xCF && marker != M_DHT && marker != 0xC8 && marker != 0xCC) return 0;
+            break;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Image size from the frame header
+ */
+int jpeg_read_size(const uint8_t *data, uint32_t size, int *width, int *height) {
+    JpegDecoder d = { 0 };
+    if (!parse(&d, data, size, 1, 0, NULL, 0, 0)) return 0;
+    *width = d.width;
+    *height = d.height;
+    return 1;
+}
+
+/*
+ * Decode the luma of a JPEG at 1/8 or 1/4 scale into gray, which must be
+ * (width >> scale) x (height >> scale). Returns 0 on an unsupported or
+ * corrupt file.
+ */
+int jpeg_decode_gray(const uint8_t *data, uint32_t size, int scale, unsigned char *gray, int out_width, int out_height) {
+    JpegDecoder d = { 0 };
+    if (scale != JPEG_SCALE_1_8 && scale != JPEG_SCALE_1_4) return 0;
+    if (!parse(&d, data, size, 1, 0, NULL, 0, 0)) return 0;
+    if (out_width != d.width >> scale || out_height != d.height >> scale || out_width == 0 || out_height == 0) return 0;
+    return parse(&d, data, size, 0, scale, gray, out_width, out_height);
+}
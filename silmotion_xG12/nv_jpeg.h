@@ -0,0 +1,33 @@
+/*
+ * nv_jpeg.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Reduced-size gray decoder for baseline JPEG, as sent by the OV2640 in JPEG
+ * mode. The entropy-coded data is read once, front to back, from the buffer
+ * holding the JPEG. Only luma is reconstructed and no inverse DCT is run:
+ *
+ *   1/8 scale   one pixel per 8x8 block, from the DC coefficient
+ *   1/4 scale   2x2 pixels per block, from DC and the three lowest AC terms
+ *
+ * Chroma blocks and the remaining AC terms are Huffman-decoded and dropped.
+ * Output pixels are written as their blocks complete, so gray can be a
+ * pyramid level directly. Output is plain luma, like the YUYV path.
+ *
+ * Supported: baseline and extended sequential Huffman (SOF0, SOF1) with
+ * 8-bit samples, gray or YCbCr with luma at the highest sampling factor,
+ * interleaved or luma-only scans and restart intervals. Progressive and
+ * arithmetic-coded files are rejected.
+ */
+#ifndef NV_JPEG_H_
+#define NV_JPEG_H_
+#include <stdint.h>
+
+#define JPEG_SCALE_1_8 3        // log2 of the size reduction
+#define JPEG_SCALE_1_4 2
+
+int jpeg_read_size(const uint8_t *data, uint32_t size, int *width, int *height);
+int jpeg_decode_gray(const uint8_t *data, uint32_t size, int scale, unsigned char *gray, int out_width, int out_height);
+
+#endif /* NV_JPEG_H_ */
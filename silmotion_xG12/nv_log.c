@@ -0,0 +1,48 @@
+#include "nv_log.h"
+#include <string.h>
+
+#if defined(__ELF__)
+// Provided by the linker for the section; weak so a binary without any
+// enabled site still links
+extern const char __start_nv_log[] __attribute__((weak));
+#endif
+
+static int (*text_sink)(const char *format, va_list args) = NULL;
+static NvTelemetry *tlm_sink = NULL;
+
+void nv_log_to_text(int (*vprint)(const char *format, va_list args)) {
+    text_sink = vprint;
+    tlm_sink = NULL;
+}
+
+void nv_log_to_telemetry(NvTelemetry *tlm) {
+    tlm_sink = tlm;
+    text_sink = NULL;
+}
+
+/*
+ * The format is the site after its second separator
+ */
+static const char *site_format(const char *site) {
+    const char *p = strchr(site, NV_LOG_SEPARATOR[0]);
+    p = strchr(p + 1, NV_LOG_SEPARATOR[0]);
+    return p + 1;
+}
+
+void nv_log_write(const char *site, int nargs, ...) {
+    va_list args;
+    va_start(args, nargs);
+    if (text_sink != NULL) {
+        text_sink(site_format(site), args);
+    } else if (tlm_sink != NULL) {
+#if defined(__ELF__)
+        uint32_t words[NV_LOG_MAX_ARGS];
+        for (int i = 0; i < nargs; i++) words[i] = va_arg(args, uint32_t);
+        nv_tlm_send_log(tlm_sink, (uint16_t)(site - __start_nv_log), words, nargs);
+#else
+        (void)nargs;
+        nv_tlm_vprintf(tlm_sink, site_format(site), args);
+#endif
+    }
+    va_end(args);
+}
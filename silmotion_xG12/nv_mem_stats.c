@@ -0,0 +1,203 @@
+#include "nv_mem_stats.h"
+#include <stdlib.h>
+#include "nv_context.h"
+#if defined(__ARM_ARCH)
+#include "em_device.h"
+#endif
+
+// Size and tag in front of every tracked block, 8 bytes to keep malloc alignment
+typedef union {
+    struct {
+        uint32_t size;
+        uint32_t tag;
+    } h;
+    uint64_t align;
+} AllocHeader;
+
+static NvMemTagStats tags[NV_MEM_NUM_TAGS];
+static uint32_t total_current, total_peak;
+
+static const char *const tag_names[NV_MEM_NUM_TAGS] = { "arena", "frames", "other" };
+
+#if defined(__ARM_ARCH)
+// Linker script symbols, autogen/linkerfile.ld
+extern uint32_t __StackLimit, __StackTop, __data_start__, __bss_end__, __HeapBase, __HeapLimit;
+
+/*
+ * Paints from the stack limit up to just below this frame, with interrupts
+ * masked so no exception frame is pushed into the area being painted
+ */
+void nv_stack_paint(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t *p = &__StackLimit;
+    uint32_t *sp = (uint32_t *)(uintptr_t)(__get_MSP() & ~3u) - 8;
+    while (p < sp) *p++ = NV_STACK_PATTERN;
+    __set_PRIMASK(primask);
+}
+
+uint32_t nv_stack_size(void) {
+    return (uint32_t)((uintptr_t)&__StackTop - (uintptr_t)&__StackLimit);
+}
+
+static const volatile uint32_t *stack_low(void) {
+    return &__StackLimit;
+}
+
+static uintptr_t stack_high(void) {
+    return (uintptr_t)&__StackTop;
+}
+#else
+static uintptr_t paint_low, paint_high;
+
+/*
+ * The region is this function's frame, so after it returns it is the stack
+ * the caller's next calls grow into
+ */
+static __attribute__((noinline)) void paint_below(void) {
+    volatile uint32_t region[NV_STACK_HOST_BYTES / 4];
+    for (uint32_t i = 0; i < NV_STACK_HOST_BYTES / 4; i++) region[i] = NV_STACK_PATTERN;
+    paint_low = (uintptr_t)&region[0];
+    paint_high = paint_low + NV_STACK_HOST_BYTES;
+}
+
+void nv_stack_paint(void) {
+    paint_below();
+}
+
+uint32_t nv_stack_size(void) {
+    return (uint32_t)(paint_high - paint_low);
+}
+
+static const volatile uint32_t *stack_low(void) {
+    return (const volatile uint32_t *)paint_low;
+}
+
+static uintptr_t stack_high(void) {
+    return paint_high;
+}
+#endif
+
+/*
+ * The stack grows down, so the lowest overwritten word marks the deepest use
+ */
+uint32_t nv_stack_high_water(void) {
+    const volatile uint32_t *p = stack_low();
+    if (p == NULL) return 0;
+    while ((uintptr_t)p < stack_high() && *p == NV_STACK_PATTERN) p++;
+    return (uint32_t)(stack_high() - (uintptr_t)p);
+}
+
+static void account(nv_mem_tag_t tag, uint32_t size) {
+    NvMemTagStats *t = &tags[tag];
+    t->current += size;
+    if (t->current > t->peak) t->peak = t->current;
+    total_current += size;
+    if (total_current > total_peak) total_peak = total_current;
+}
+
+void *nv_mem_alloc(uint32_t size, nv_mem_tag_t tag) {
+    AllocHeader *h = (AllocHeader *)malloc(sizeof(AllocHeader) + size);
+    if (h == NULL) {
+        tags[tag].fails++;
+        return NULL;
+    }
+    h->h.size = size;
+    h->h.tag = (uint32_t)tag;
+    tags[tag].allocs++;
+    account(tag, size);
+    return h + 1;
+}
+
+void nv_mem_free(void *ptr) {
+    if (ptr == NULL) return;
+    AllocHeader *h = (AllocHeader *)ptr - 1;
+    tags[h->h.tag].current -= h->h.size;
+    total_current -= h->h.size;
+    free(h);
+}
+
+/*
+ * Statically allocated buffers count as allocated for good
+ */
+void nv_mem_track_static(nv_mem_tag_t tag, uint32_t size) {
+    tags[tag].allocs++;
+    account(tag, size);
+}
+
+const NvMemTagStats *nv_mem_tag_stats(nv_mem_tag_t tag) {
+    return &tags[tag];
+}
+
+uint32_t nv_mem_peak(void) {
+    return total_peak;
+}
+
+uint32_t nv_mem_heap_region(void) {
+#if defined(__ARM_ARCH)
+    return (uint32_t)((uintptr_t)&__HeapLimit - (uintptr_t)&__HeapBase);
+#else
+    return 0;
+#endif
+}
+
+void nv_mem_report(int (*print)(const char *format, ...)) {
+    print("Memory:\n");
+#if defined(__ARM_ARCH)
+    print("  static  %7lu B  .data and .bss\n",
+          (unsigned long)((uintptr_t)&__bss_end__ - (uintptr_t)&__data_start__));
+    print("  heap    %7lu B  region for malloc()\n", (unsigned long)nv_mem_heap_region());
+#endif
+    print("  stack   %7lu B  high water of %lu B\n", (unsigned long)nv_stack_high_water(),
+          (unsigned long)nv_stack_size());
+    print("  %-7s %7s %7s %6s %5s\n", "tag", "current", "peak", "allocs", "fails");
+    for (int i = 0; i < NV_MEM_NUM_TAGS; i++) {
+        const NvMemTagStats *t = &tags[i];
+        print("  %-7s %7lu %7lu %6lu %5lu\n", tag_names[i], (unsigned long)t->current, (unsigned long)t->peak,
+              (unsigned long)t->allocs, (unsigned long)t->fails);
+    }
+    print("  %-7s %7lu %7lu\n", "all", (unsigned long)total_current, (unsigned long)total_peak);
+}
+
+/*
+ * Capture configurations the firmware can be built for, see app.c
+ */
+static const struct {
+    const char *name;
+    int width, height;
+    pixfmt_t format;
+    unsigned flags;
+} budget_configs[] = {
+    { "replay 160x90", 160, 90, PIXFMT_RGB565, NV_CTX_EXTERNAL_FRAMES },
+    { "camera 160x120", 160, 120, PIXFMT_RGB565, 0 },
+    { "camera 320x240", 320, 240, PIXFMT_RGB565, 0 },
+    { "camera 640x480", 640, 480, PIXFMT_RGB565, 0 },
+    { "UXGA jpeg 1/8", 200, 150, PIXFMT_JPEG, NV_CTX_EXTERNAL_FRAMES },
+    { "UXGA jpeg 1/4", 400, 300, PIXFMT_JPEG, NV_CTX_EXTERNAL_FRAMES },
+};
+
+/*
+ * Arena per configuration and pyramid depth; with a budget, sizes over it are
+ * starred. The context itself is static, with MAX_FEATURES points per frame.
+ */
+void nv_mem_budget_report(uint32_t budget, int (*print)(const char *format, ...)) {
+    static NvContext ctx;
+
+    print("Arena per configuration (B)%s:\n", budget > 0 ? ", * over budget" : "");
+    print("  %-15s %8s  %8s  %8s\n", "config", "1 level", "2 levels", "3 levels");
+    for (unsigned i = 0; i < sizeof(budget_configs) / sizeof(budget_configs[0]); i++) {
+        print("  %-15s", budget_configs[i].name);
+        for (int levels = 1; levels <= 3; levels++) {
+            if (nv_context_init(&ctx, budget_configs[i].width, budget_configs[i].height, budget_configs[i].format,
+                                levels, budget_configs[i].flags)) {
+                uint32_t bytes = nv_context_mem_required(&ctx);
+                print(" %8lu%c", (unsigned long)bytes, budget > 0 && bytes > budget ? '*' : ' ');
+            } else {
+                print(" %8s ", "-");
+            }
+        }
+        print("\n");
+    }
+    if (budget > 0) print("  budget %lu B\n", (unsigned long)budget);
+    print("  NvContext %lu B static, MAX_FEATURES %d\n", (unsigned long)sizeof(NvContext), MAX_FEATURES);
+}
@@ -0,0 +1,77 @@
+/*
+ * nv_motion_class.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Motion classifier on top of the global motion fit: one of eight directions
+ * or still, the magnitude in px/frame and px/s, and a confidence, from a
+ * temporally filtered motion vector. Directions follow the Up/Down report,
+ * dy > 0 is Up and dx > 0 is Right.
+ *
+ * The fit is filtered per frame (nv_params.filter): exponentially, new
+ * samples weighing 1 / (1 << MC_EMA_SHIFT), or by the median of the last
+ * MC_MEDIAN_TAPS samples per axis, which drops single outliers outright.
+ *
+ * The state only changes with hysteresis. Moving starts when the filtered
+ * magnitude exceeds nv_params.threshold and stops when it falls below half
+ * of it, and any change, to a new direction too, must be seen for
+ * nv_params.hold frames in a row. motion_class_update() returns 1 on a
+ * change, so a caller reporting only those (nv_params.events) sends nothing
+ * while the motion holds and its host can sleep.
+ *
+ * The confidence is an exponential average of the fit confidence of the
+ * frames that agree with the state, so it falls while frames disagree or
+ * have no fit. A new state starts at the mean over the frames that made it.
+ */
+#ifndef NV_MOTION_CLASS_H_
+#define NV_MOTION_CLASS_H_
+#include <stdint.h>
+
+#define MC_EMA_SHIFT 2              // EMA weight of a new sample, 1/4
+#define MC_MEDIAN_TAPS 5            // samples in the median filter
+#define MC_TAN_22_5_Q14 6786        // sector boundary between an axis and a diagonal
+
+typedef enum {
+    MC_STILL,
+    MC_RIGHT,
+    MC_UP_RIGHT,
+    MC_UP,
+    MC_UP_LEFT,
+    MC_LEFT,
+    MC_DOWN_LEFT,
+    MC_DOWN,
+    MC_DOWN_RIGHT
+} mc_direction_t;
+
+typedef enum {
+    MC_FILTER_NONE,
+    MC_FILTER_EMA,
+    MC_FILTER_MEDIAN
+} mc_filter_t;
+
+typedef struct {
+    mc_direction_t direction;       // classified state
+    mc_direction_t previous;        // state before the last change
+    uint32_t duration;              // frames the previous state lasted
+    uint32_t frames;                // frames in the current state
+    int32_t dx, dy;                 // filtered motion, Q14 px/frame
+    uint32_t magnitude;             // of the filtered motion, Q14 px/frame
+    uint32_t speed;                 // Q14 px/s at nv_params.fps
+    uint8_t confidence;             // 0..255
+
+    mc_direction_t candidate;       // differing state seen for pending frames
+    int pending;
+    uint32_t candidate_confidence;  // summed over the pending frames that agree with it
+    int32_t ema_dx, ema_dy;         // Q14
+    int32_t ema_confidence;         // Q8
+    int32_t taps_dx[MC_MEDIAN_TAPS], taps_dy[MC_MEDIAN_TAPS];
+    int num_taps, next_tap;
+} MotionClass;
+
+void motion_class_init(MotionClass *mc);
+int motion_class_update(MotionClass *mc, int32_t dx, int32_t dy, uint8_t confidence);
+void motion_class_skip(MotionClass *mc);
+const char *motion_class_name(mc_direction_t direction);
+
+#endif /* NV_MOTION_CLASS_H_ */
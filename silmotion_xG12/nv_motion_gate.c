@@ -0,0 +1,50 @@
+#include "nv_motion_gate.h"
+
+void motion_gate_init(MotionGate *gate) {
+    gate->noise_q8 = MG_INITIAL_NOISE_Q8;
+    gate->mad_q8 = 0;
+    gate->threshold_q8 = 0;
+    gate->confidence = 0;
+}
+
+/*
+ * Compare two gray images of the same size, normally the coarsest pyramid
+ * levels. Returns 1 when the scene moved, 0 when it is static; the
+ * confidence of the decision is left in gate->confidence.
+ */
+int motion_gate_update(MotionGate *gate, const unsigned char *ref, const unsigned char *cur, int width, int height) {
+    uint32_t n = (uint32_t)width * height;
+    int32_t sum = 0;
+    uint32_t sad = 0;
+
+    // Mean brightness change, taken out so exposure steps are not motion
+    for (uint32_t i = 0; i < n; i++) sum += cur[i] - ref[i];
+    int32_t offset = (sum >= 0 ? sum + (int32_t)(n / 2) : sum - (int32_t)(n / 2)) / (int32_t)n;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t d = cur[i] - ref[i] - offset;
+        sad += (uint32_t)(d < 0 ? -d : d);
+    }
+
+    gate->mad_q8 = (uint32_t)(((uint64_t)sad << 8) / n);
+    gate->threshold_q8 = gate->noise_q8 * MG_THRESHOLD_FACTOR;
+    if (gate->threshold_q8 < MG_MIN_THRESHOLD_Q8) gate->threshold_q8 = MG_MIN_THRESHOLD_Q8;
+
+    int moving = gate->mad_q8 > gate->threshold_q8;
+    uint32_t margin = moving ? gate->mad_q8 - gate->threshold_q8 : gate->threshold_q8 - gate->mad_q8;
+    uint32_t confidence = margin * 255 / gate->threshold_q8;
+    gate->confidence = (uint8_t)(confidence > 255 ? 255 : confidence);
+
+    // Against a kept reference, slow drift also reads as a small difference,
+    // so the gate's own static calls may only lower the floor
+    if (!moving && gate->mad_q8 < gate->noise_q8) motion_gate_learn_static(gate);
+    return moving;
+}
+
+/*
+ * Fold the last measurement into the noise floor. Called by the tracker for
+ * a pair it found still; this is the only way the floor rises.
+ */
+void motion_gate_learn_static(MotionGate *gate) {
+    int32_t delta = (int32_t)gate->mad_q8 - (int32_t)gate->noise_q8;
+    gate->noise_q8 = (uint32_t)((int32_t)gate->noise_q8 + delta / (1 << MG_NOISE_RATE_SHIFT));
+}
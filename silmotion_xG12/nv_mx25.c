@@ -0,0 +1,85 @@
+/*
+ * nv_mx25.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * The flash is left in deep power-down by the board init (mx25 flash
+ * shutdown), so mx25_init() wakes it up and mx25_deinit() puts it back.
+ */
+#include "nv_mx25.h"
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+#include "sl_sleeptimer.h"
+#include "sl_mx25_flash_shutdown_usart_config.h"
+
+#define MX25_CMD_READ 0x03
+#define MX25_CMD_DEEP_POWER_DOWN 0xB9
+#define MX25_CMD_RELEASE_POWER_DOWN 0xAB
+
+#define MX25_USART SL_MX25_FLASH_SHUTDOWN_PERIPHERAL
+#define MX25_CLOCK cmuClock_USART1      // SL_MX25_FLASH_SHUTDOWN_PERIPHERAL_NO
+
+static void cs_low(void) {
+  GPIO_PinOutClear(SL_MX25_FLASH_SHUTDOWN_CS_PORT, SL_MX25_FLASH_SHUTDOWN_CS_PIN);
+}
+
+static void cs_high(void) {
+  GPIO_PinOutSet(SL_MX25_FLASH_SHUTDOWN_CS_PORT, SL_MX25_FLASH_SHUTDOWN_CS_PIN);
+}
+
+static void send_command(uint8_t cmd) {
+  cs_low();
+  USART_SpiTransfer(MX25_USART, cmd);
+  cs_high();
+}
+
+/*
+ * Configure the SPI master and wake the flash from deep power-down
+ */
+void mx25_init(void) {
+  CMU_ClockEnable(cmuClock_GPIO, true);
+  CMU_ClockEnable(MX25_CLOCK, true);
+
+  USART_InitSync_TypeDef init = USART_INITSYNC_DEFAULT;
+  init.baudrate = MX25_SPI_BAUDRATE;
+  init.msbf = true;
+  init.enable = usartDisable;
+  USART_InitSync(MX25_USART, &init);
+
+  MX25_USART->ROUTELOC0 = ((uint32_t)SL_MX25_FLASH_SHUTDOWN_TX_LOC << _USART_ROUTELOC0_TXLOC_SHIFT)
+                          | ((uint32_t)SL_MX25_FLASH_SHUTDOWN_RX_LOC << _USART_ROUTELOC0_RXLOC_SHIFT)
+                          | ((uint32_t)SL_MX25_FLASH_SHUTDOWN_CLK_LOC << _USART_ROUTELOC0_CLKLOC_SHIFT);
+  MX25_USART->ROUTEPEN = USART_ROUTEPEN_TXPEN | USART_ROUTEPEN_RXPEN | USART_ROUTEPEN_CLKPEN;
+
+  GPIO_PinModeSet(SL_MX25_FLASH_SHUTDOWN_TX_PORT, SL_MX25_FLASH_SHUTDOWN_TX_PIN, gpioModePushPull, 0);
+  GPIO_PinModeSet(SL_MX25_FLASH_SHUTDOWN_RX_PORT, SL_MX25_FLASH_SHUTDOWN_RX_PIN, gpioModeInput, 0);
+  GPIO_PinModeSet(SL_MX25_FLASH_SHUTDOWN_CLK_PORT, SL_MX25_FLASH_SHUTDOWN_CLK_PIN, gpioModePushPull, 0);
+  GPIO_PinModeSet(SL_MX25_FLASH_SHUTDOWN_CS_PORT, SL_MX25_FLASH_SHUTDOWN_CS_PIN, gpioModePushPull, 1);
+  USART_Enable(MX25_USART, usartEnable);
+
+  send_command(MX25_CMD_RELEASE_POWER_DOWN);
+  sl_sleeptimer_delay_millisecond(1);   // tRES1 is 35 us worst case
+}
+
+/*
+ * Plain READ, no dummy cycles: fine at the SPI clock used here
+ */
+void mx25_read(uint32_t address, uint8_t *buf, uint32_t len) {
+  cs_low();
+  USART_SpiTransfer(MX25_USART, MX25_CMD_READ);
+  USART_SpiTransfer(MX25_USART, (uint8_t)(address >> 16));
+  USART_SpiTransfer(MX25_USART, (uint8_t)(address >> 8));
+  USART_SpiTransfer(MX25_USART, (uint8_t)address);
+  for (uint32_t i = 0; i < len; i++) {
+    buf[i] = USART_SpiTransfer(MX25_USART, 0xFF);
+  }
+  cs_high();
+}
+
+void mx25_deinit(void) {
+  send_command(MX25_CMD_DEEP_POWER_DOWN);
+  USART_Enable(MX25_USART, usartDisable);
+}
@@ -0,0 +1,21 @@
+/*
+ * nv_mx25.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Read access to the MX25 SPI flash on the radio board, on the USART and
+ * pins from config/sl_mx25_flash_shutdown_usart_config.h. The flash is not
+ * memory mapped on xG12, so data is read into RAM in caller-sized chunks.
+ */
+#ifndef NV_MX25_H_
+#define NV_MX25_H_
+#include <stdint.h>
+
+#define MX25_SPI_BAUDRATE 8000000
+
+void mx25_init(void);
+void mx25_read(uint32_t address, uint8_t *buf, uint32_t len);
+void mx25_deinit(void);
+
+#endif /* NV_MX25_H_ */
@@ -7,19 +7,28 @@
 #ifndef NV_OPTICAL_FLOW_H_
 #define NV_OPTICAL_FLOW_H_
 #include <stdint.h>
-#define WIDTH 160
-#define HEIGHT 90
-#define CHANNEL 3
-#define PYR_LEVELS 2
-#define WINDOW_SIZE 17
+// Tracker parameters; override with -D for sweeps (make -B TUNE="-DWINDOW_SIZE=7").
+// These are the defaults of the runtime set in nv_params.h, which the kernels read
+#ifndef PYR_LEVELS
+#define PYR_LEVELS 2        // default pyramid depth, see nv_context_init()
+#endif
+#ifndef WINDOW_SIZE
+#define WINDOW_SIZE 5       // odd
+#endif
+#ifndef NUM_ITER
 #define NUM_ITER 5
+#endif
+#ifndef MAX_WINDOW_SIZE
+#define MAX_WINDOW_SIZE (WINDOW_SIZE > 9 ? WINDOW_SIZE : 9)    // largest runtime window, nv_params.h
+#endif
 
 /**/
 #define Q15_SHIFT 14
-#define MAX_FEATURES 2
+#define MAX_FEATURES 8
 #define MIN_DISTANCE 20
 
-void rgb565_to_grayscale(uint16_t *rgb565, unsigned char *gray, int width, int height);
+unsigned char rgb565_pixel_to_gray(uint16_t pixel);
+void rgb565_to_grayscale(const uint16_t *rgb565, unsigned char *gray, int width, int height);
 void build_image_pyramid(unsigned char *src, unsigned char *dst, int src_width, int src_height);
 void compute_gradient(unsigned char *pyr, int16_t *gradx, int16_t *grady, int width, int height);
 int find_strong_feature(unsigned char *gray, int width, int height, int32_t *point);
@@ -0,0 +1,134 @@
+#include "nv_params.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nv_optical_flow.h"
+
+typedef struct {
+    const char *name;
+    size_t offset;
+    int32_t min, max;
+} ParamInfo;
+
+// Defaults, active from the start so the kernels need no init call
+#define NV_PARAMS_DEFAULTS { \
+        PYR_LEVELS, WINDOW_SIZE, NUM_ITER, MAX_FEATURES, \
+        1000, 30, 100, \
+        205,    /* 0.0125 px in Q14 */ \
+        2, 2, 0, \
+        5 }
+
+static ParamInfo table[] = {
+    { "levels", offsetof(NvParams, levels), 1, PYR_LEVELS },        // max set by nv_params_init()
+    { "window", offsetof(NvParams, window), 3, MAX_WINDOW_SIZE },
+    { "iterations", offsetof(NvParams, iterations), 1, 20 },
+    { "features", offsetof(NvParams, features), 1, MAX_FEATURES },
+    { "min_det", offsetof(NvParams, min_det), 0, 1000000000 },
+    { "min_gradient", offsetof(NvParams, min_gradient), 0, 65535 },
+    { "min_score", offsetof(NvParams, min_score), 0, 100000000 },
+    { "threshold", offsetof(NvParams, threshold), 0, 1 << 20 },
+    { "filter", offsetof(NvParams, filter), 0, 2 },
+    { "hold", offsetof(NvParams, hold), 1, 16 },
+    { "events", offsetof(NvParams, events), 0, 2 },
+    { "fps", offsetof(NvParams, fps), 1, 100 },
+};
+#define NUM_PARAMS (int)(sizeof(table) / sizeof(table[0]))
+
+NvParams nv_params = NV_PARAMS_DEFAULTS;
+static NvParams pending = NV_PARAMS_DEFAULTS;
+static int dirty = 0;
+
+static int32_t *field(NvParams *params, const ParamInfo *info) {
+    return (int32_t *)((char *)params + info->offset);
+}
+
+static const ParamInfo *find(const char *name, size_t len) {
+    for (int i = 0; i < NUM_PARAMS; i++) {
+        if (strlen(table[i].name) == len && strncmp(table[i].name, name, len) == 0) return &table[i];
+    }
+    return NULL;
+}
+
+static int valid(const ParamInfo *info, long value) {
+    if (value < info->min || value > info->max) return 0;
+    return info->offset != offsetof(NvParams, window) || (value & 1);
+}
+
+/*
+ * Back to the defaults, active at once; levels may go up to those the
+ * context holds, and start there
+ */
+void nv_params_init(int max_levels) {
+    static const NvParams defaults = NV_PARAMS_DEFAULTS;
+    table[0].max = max_levels;
+    nv_params = defaults;
+    nv_params.levels = max_levels;
+    pending = nv_params;
+    dirty = 0;
+}
+
+int nv_params_set(const char *name, int32_t value) {
+    const ParamInfo *info = find(name, strlen(name));
+    if (info == NULL || !valid(info, value)) return 0;
+    *field(&pending, info) = value;
+    dirty = 1;
+    return 1;
+}
+
+int nv_params_get(const char *name, int32_t *value) {
+    const ParamInfo *info = find(name, strlen(name));
+    if (info == NULL) return 0;
+    *value = *field(&pending, info);
+    return 1;
+}
+
+/*
+ * Pending values become active. Returns 1 when any of them changed.
+ */
+int nv_params_apply(void) {
+    if (!dirty) return 0;
+    dirty = 0;
+    if (memcmp(&nv_params, &pending, sizeof(pending)) == 0) return 0;
+    nv_params = pending;
+    return 1;
+}
+
+static void print_param(const ParamInfo *info, int (*print)(const char *format, ...)) {
+    int32_t value = *field(&pending, info);
+    print("  %-12s %10ld  [%ld..%ld]%s\n", info->name, (long)value, (long)info->min, (long)info->max,
+          value != *field(&nv_params, info) ? " next frame" : "");
+}
+
+/*
+ * One command line, with or without the leading '$'. Returns 0 on an unknown
+ * parameter or a value out of range, after printing why.
+ */
+int nv_params_command(const char *line, int (*print)(const char *format, ...)) {
+    if (*line == '$') line++;
+    const char *eq = strchr(line, '=');
+    size_t len = eq != NULL ? (size_t)(eq - line) : strlen(line);
+
+    if (len == 0 && eq == NULL) {
+        print("Parameters:\n");
+        for (int i = 0; i < NUM_PARAMS; i++) print_param(&table[i], print);
+        return 1;
+    }
+    const ParamInfo *info = find(line, len);
+    if (info == NULL) {
+        print("Error: unknown parameter '%.*s'\n", (int)len, line);
+        return 0;
+    }
+    if (eq != NULL) {
+        char *end;
+        long value = strtol(eq + 1, &end, 0);
+        if (end == eq + 1 || *end != '\0' || !valid(info, value)) {
+            print("Error: %s takes %s%ld..%ld\n", info->name,
+                  info->offset == offsetof(NvParams, window) ? "odd " : "", (long)info->min, (long)info->max);
+            return 0;
+        }
+        *field(&pending, info) = (int32_t)value;
+        dirty = 1;
+    }
+    print_param(info, print);
+    return 1;
+}
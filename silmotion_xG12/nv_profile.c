@@ -0,0 +1,125 @@
+#include "nv_profile.h"
+
+#if NV_PROFILE
+#include <string.h>
+#if !defined(__ARM_ARCH)
+#include <time.h>
+#endif
+
+static NvProfStage stages[NV_PROF_NUM_STAGES];
+
+static const char *const stage_names[NV_PROF_NUM_STAGES] = {
+    "convert", "pyramid", "watch", "gate", "features", "gradient", "track", "motion", "frame"
+};
+
+#if !defined(__ARM_ARCH)
+uint32_t nv_profile_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+/*
+ * Bin of a tick count: exact below 4, then 4 bins per octave
+ */
+static int tick_bin(uint32_t ticks) {
+    if (ticks < 4) return (int)ticks;
+    int e = 2;
+    while (e < 31 && (ticks >> (e + 1)) != 0) e++;
+    return (e - 1) * 4 + (int)((ticks >> (e - 2)) & 3);
+}
+
+static uint32_t bin_upper(int bin) {
+    if (bin < 4) return (uint32_t)bin;
+    int e = bin / 4 + 1;
+    return (uint32_t)((((uint64_t)(5 + bin % 4)) << (e - 2)) - 1);
+}
+
+/*
+ * Enables the cycle counter on target; the stage table is cleared.
+ */
+void nv_profile_init(void) {
+#if defined(__ARM_ARCH)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    nv_profile_reset();
+}
+
+void nv_profile_reset(void) {
+    memset(stages, 0, sizeof(stages));
+}
+
+void nv_profile_begin(nv_prof_stage_t stage) {
+    stages[stage].start = nv_profile_now();
+}
+
+void nv_profile_end(nv_prof_stage_t stage) {
+    uint32_t now = nv_profile_now();
+    NvProfStage *s = &stages[stage];
+    uint32_t ticks = now - s->start;
+    int bin = tick_bin(ticks);
+
+    if (s->count == 0 || ticks < s->min) s->min = ticks;
+    if (ticks > s->max) s->max = ticks;
+    s->count++;
+    s->sum += ticks;
+    if (s->hist[bin] == UINT16_MAX) {
+        // Keep the shape of the distribution, weighted towards recent frames
+        for (int i = 0; i < NV_PROF_BINS; i++) s->hist[i] >>= 1;
+    }
+    s->hist[bin]++;
+}
+
+/*
+ * Upper edge of the bin holding the given percentile, clamped to [min, max]
+ */
+static uint32_t percentile(const NvProfStage *s, int pct) {
+    uint32_t total = 0, seen = 0;
+    for (int i = 0; i < NV_PROF_BINS; i++) total += s->hist[i];
+    uint32_t rank = (total * (uint32_t)pct + 99) / 100;
+
+    for (int i = 0; i < NV_PROF_BINS; i++) {
+        seen += s->hist[i];
+        if (seen >= rank && seen > 0) {
+            uint32_t v = bin_upper(i);
+            if (v > s->max) v = s->max;
+            if (v < s->min) v = s->min;
+            return v;
+        }
+    }
+    return s->max;
+}
+
+/*
+ * Statistics of one stage; 0 when it has not run since the last reset
+ */
+int nv_profile_summary(nv_prof_stage_t stage, NvProfSummary *summary) {
+    const NvProfStage *s = &stages[stage];
+    if (s->count == 0) return 0;
+    summary->count = s->count;
+    summary->min = s->min;
+    summary->mean = (uint32_t)(s->sum / s->count);
+    summary->p50 = percentile(s, 50);
+    summary->p90 = percentile(s, 90);
+    summary->p99 = percentile(s, 99);
+    summary->max = s->max;
+    return 1;
+}
+
+void nv_profile_report(int (*print)(const char *format, ...)) {
+    NvProfSummary s;
+
+    print("Profile (%s):\n", NV_PROF_UNIT);
+    print("  %-9s %7s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "min", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < NV_PROF_NUM_STAGES; i++) {
+        if (!nv_profile_summary((nv_prof_stage_t)i, &s)) continue;
+        print("  %-9s %7lu %10lu %10lu %10lu %10lu %10lu %10lu\n", stage_names[i], (unsigned long)s.count,
+              (unsigned long)s.min, (unsigned long)s.mean, (unsigned long)s.p50, (unsigned long)s.p90,
+              (unsigned long)s.p99, (unsigned long)s.max);
+    }
+}
+
+#endif /* NV_PROFILE */
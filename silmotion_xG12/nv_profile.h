@@ -0,0 +1,91 @@
+/*
+ * nv_profile.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Per-stage timing. Stages are bracketed with NV_PROF_BEGIN()/NV_PROF_END();
+ * each measurement goes into a fixed-size table with count, min, mean, max
+ * and a log-spaced histogram (4 bins per octave) for the percentiles, and
+ * nv_profile_report() prints it.
+ *
+ * Ticks are DWT CYCCNT core cycles on Cortex-M and nanoseconds from
+ * clock_gettime(CLOCK_MONOTONIC) on the host, so a stage up to ~4.2 s on the
+ * host or 2^32 cycles on target is measured correctly.
+ *
+ * Built with NV_PROFILE 0 (the default) every macro and call below expands to
+ * nothing, and nv_profile.c compiles to an empty unit.
+ *
+ * A stage must not nest inside itself; different stages may nest (TRACK
+ * contains GRADIENT).
+ */
+#ifndef NV_PROFILE_H_
+#define NV_PROFILE_H_
+#include <stdint.h>
+
+#ifndef NV_PROFILE
+#define NV_PROFILE 0
+#endif
+
+typedef enum {
+    NV_PROF_CONVERT,        // capture format to gray
+    NV_PROF_PYRAMID,        // coarse levels
+    NV_PROF_WATCH,          // watch stage, nv_watch.h
+    NV_PROF_GATE,           // motion gate, nv_motion_gate.h
+    NV_PROF_FEATURES,       // feature detection on the new reference
+    NV_PROF_GRADIENT,       // template gradients, inside TRACK
+    NV_PROF_TRACK,          // pyramidal LK over all features
+    NV_PROF_MOTION,         // global motion fit
+    NV_PROF_FRAME,          // whole frame, capture to report
+    NV_PROF_NUM_STAGES
+} nv_prof_stage_t;
+
+#define NV_PROF_BINS 128                // 4 per octave covers 32-bit ticks
+
+typedef struct {
+    uint32_t count;
+    uint32_t min, max;
+    uint64_t sum;
+    uint32_t start;                     // tick of the open NV_PROF_BEGIN()
+    uint16_t hist[NV_PROF_BINS];        // halved as a whole before a bin overflows
+} NvProfStage;
+
+typedef struct {
+    uint32_t count, min, mean, p50, p90, p99, max;
+} NvProfSummary;
+
+#if NV_PROFILE
+
+#if defined(__ARM_ARCH)
+#include "em_device.h"
+#define NV_PROF_UNIT "cycles"
+static inline uint32_t nv_profile_now(void) {
+    return DWT->CYCCNT;
+}
+#else
+#define NV_PROF_UNIT "ns"
+uint32_t nv_profile_now(void);
+#endif
+
+void nv_profile_init(void);
+void nv_profile_reset(void);
+void nv_profile_begin(nv_prof_stage_t stage);
+void nv_profile_end(nv_prof_stage_t stage);
+int nv_profile_summary(nv_prof_stage_t stage, NvProfSummary *summary);
+void nv_profile_report(int (*print)(const char *format, ...));
+
+#define NV_PROF_BEGIN(stage) nv_profile_begin(stage)
+#define NV_PROF_END(stage) nv_profile_end(stage)
+
+#else
+
+#define nv_profile_init() ((void)0)
+#define nv_profile_reset() ((void)0)
+#define nv_profile_summary(stage, summary) 0
+#define nv_profile_report(print) ((void)0)
+#define NV_PROF_BEGIN(stage) ((void)0)
+#define NV_PROF_END(stage) ((void)0)
+
+#endif
+
+#endif /* NV_PROFILE_H_ */
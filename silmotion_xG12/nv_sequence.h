@@ -0,0 +1,78 @@
+/*
+ * nv_sequence.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * NVSQ multi-frame container. The file is walked in place: on the host it is
+ * memory-mapped, on the MCU it is linked into flash (see utils/nvsq.py asm)
+ * and read directly from there.
+ *
+ * Layout, all fields little-endian and naturally aligned:
+ *   NvSeqHeader                 32 bytes
+ *   index[frame_count + 1]      uint32 byte offsets from the start of the file;
+ *                               frame i spans index[i] .. index[i + 1]
+ *   timestamps[frame_count]     uint32 milliseconds, only with NVSQ_FLAG_TIMESTAMPS
+ *   motion[frame_count]         NvSeqMotion, only with NVSQ_FLAG_MOTION; right
+ *                               after the index or the timestamps
+ *   frame data                  each frame starts 4-byte aligned
+ */
+#ifndef NV_SEQUENCE_H_
+#define NV_SEQUENCE_H_
+#include <stdint.h>
+
+#define NVSQ_MAGIC 0x5153564Eu      // "NVSQ"
+#define NVSQ_VERSION 1
+
+#define NVSQ_FLAG_TIMESTAMPS 0x01
+#define NVSQ_FLAG_MOTION 0x02       // ground truth of rendered sequences, utils/nvsynth.py
+
+// Pixel formats, same values as pixfmt_t (nv_context.h)
+#define NVSQ_FMT_RGB565 0
+#define NVSQ_FMT_YUYV 1
+#define NVSQ_FMT_GRAY8 2
+#define NVSQ_FMT_RGB565_DRLE 3      // frames vary in size, see nv_codec.h
+#define NVSQ_FMT_JPEG 4             // JPEG files as-is, width and height before scaling
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t fps_milli;             // frames per second * 1000
+    uint32_t frame_count;
+    uint32_t index_offset;
+    uint32_t timestamp_offset;      // 0 without NVSQ_FLAG_TIMESTAMPS
+} NvSeqHeader;
+
+/*
+ * Ground truth from frame i - 1 to frame i, identity for frame 0. m[] maps a
+ * point like GlobalMotion (nv_global_motion.h): linear terms Q14, translation
+ * Q14 pixels. Brightness follows I' = (gain * I + offset) >> 14, gain Q14 and
+ * offset Q14 gray levels.
+ */
+typedef struct {
+    int32_t m[6];
+    int32_t gain;
+    int32_t offset;
+} NvSeqMotion;
+
+typedef struct {
+    const uint8_t *base;
+    uint32_t size;
+    const NvSeqHeader *hdr;
+    const uint32_t *index;
+    const uint32_t *timestamps;     // NULL if absent
+    const NvSeqMotion *motion;      // NULL if absent
+} NvSequence;
+
+int nvsq_open_memory(NvSequence *seq, const uint8_t *data, uint32_t size);
+const uint8_t *nvsq_frame(const NvSequence *seq, uint32_t i, uint32_t *size);
+uint32_t nvsq_timestamp_ms(const NvSequence *seq, uint32_t i);
+const NvSeqMotion *nvsq_motion(const NvSequence *seq, uint32_t i);
+
+#endif /* NV_SEQUENCE_H_ */
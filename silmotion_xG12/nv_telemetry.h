@@ -0,0 +1,115 @@
+/*
+ * nv_telemetry.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Binary telemetry: fixed little-endian messages instead of text lines,
+ * decoded on the host by utils/nvtlm.py. A frame on the wire is
+ *
+ *   COBS(type, seq, body..., crc16 lo, crc16 hi) 0x00
+ *
+ * with the CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of type, seq and
+ * body. COBS leaves 0x00 only as the frame delimiter, so a receiver that
+ * starts mid-stream or loses bytes resynchronises at the next zero, and the
+ * per-message seq shows frames dropped on the way.
+ *
+ * Each frame goes out in one write() call, so with usart_write() a frame is
+ * either queued whole or dropped whole.
+ */
+#ifndef NV_TELEMETRY_H_
+#define NV_TELEMETRY_H_
+#include <stdint.h>
+#include <stdarg.h>
+
+#define NV_TLM_MAX_TEXT 127
+#define NV_TLM_MAX_PAYLOAD (2 + NV_TLM_MAX_TEXT + 2)
+#define NV_TLM_MAX_FRAME (NV_TLM_MAX_PAYLOAD + NV_TLM_MAX_PAYLOAD / 254 + 2)
+#define NV_TLM_CRC16_INIT 0xFFFF
+
+typedef enum {
+    NV_TLM_TEXT = 1,        // a text line, no terminator
+    NV_TLM_MOTION = 2,      // NvTlmMotion, one per frame
+    NV_TLM_STATS = 3,       // NvTlmStats, periodic
+    NV_TLM_PROFILE = 4,     // NvTlmProfile, one per stage on request
+    NV_TLM_LOG = 5,         // u16 site ID, then up to NV_LOG_MAX_ARGS u32 arguments, nv_log.h
+    NV_TLM_EVENT = 6        // NvTlmEvent, on a motion classifier change
+} nv_tlm_type_t;
+
+typedef enum {
+    NV_TLM_NO_REFERENCE,    // first frame, or first after watching
+    NV_TLM_UP,
+    NV_TLM_DOWN,
+    NV_TLM_UNKNOWN,         // motion fitted, below the direction threshold
+    NV_TLM_STILL,           // motion gate saw a static scene
+    NV_TLM_WATCHING,        // watch stage only, nv_watch.h
+    NV_TLM_FAILED           // no motion fit
+} nv_tlm_state_t;
+
+#define NV_TLM_FLAG_WATCH_ALARM 0x01    // watch stage saw motion, dx/dy is its shift
+#define NV_TLM_FLAG_BACK_TO_WATCH 0x02  // tracking handed back to the watch stage
+
+typedef struct {
+    uint32_t frame;
+    uint8_t state;          // nv_tlm_state_t
+    uint8_t flags;          // NV_TLM_FLAG_*
+    uint8_t confidence;     // motion fit or motion gate, 0..255
+    uint8_t features;       // features tracked from the reference
+    uint8_t tracked;        // of those, LK converged
+    uint8_t inliers;        // of those, agree with the fit
+    int32_t dx, dy;         // Q14 pixels
+    uint16_t change_q8;     // watch stage measure and threshold, saturated
+    uint16_t threshold_q8;
+} NvTlmMotion;
+
+typedef struct {
+    uint16_t frames;        // in this period
+    uint16_t still;
+    uint16_t watching;
+    uint16_t fps_x100;
+    uint8_t target_fps;
+    uint32_t dropped;       // frame ticks missed, total
+    uint32_t tx_dropped;    // telemetry bytes dropped, total
+} NvTlmStats;
+
+typedef struct {
+    uint8_t stage;          // nv_prof_stage_t
+    uint8_t unit;           // 0 ns, 1 cycles
+    uint32_t count, min, mean, p50, p90, p99, max;
+} NvTlmProfile;
+
+typedef struct {
+    uint32_t frame;
+    uint8_t direction;      // mc_direction_t, nv_motion_class.h
+    uint8_t previous;
+    uint8_t confidence;     // 0..255
+    uint32_t duration;      // frames the previous state lasted
+    int32_t dx, dy;         // filtered, Q14 px/frame
+    uint32_t magnitude;     // Q14 px/frame
+    uint32_t speed;         // Q14 px/s
+} NvTlmEvent;
+
+typedef int (*nv_tlm_write_t)(const uint8_t *data, uint32_t len);   // returns len, or 0 when dropped
+
+typedef struct {
+    nv_tlm_write_t write;
+    uint8_t seq;
+    uint32_t sent, dropped;     // frames
+} NvTelemetry;
+
+void nv_tlm_init(NvTelemetry *tlm, nv_tlm_write_t write);
+int nv_tlm_send_text(NvTelemetry *tlm, const char *text, uint32_t len);
+int nv_tlm_vprintf(NvTelemetry *tlm, const char *format, va_list args);
+int nv_tlm_send_motion(NvTelemetry *tlm, const NvTlmMotion *m);
+int nv_tlm_send_stats(NvTelemetry *tlm, const NvTlmStats *s);
+int nv_tlm_send_profile(NvTelemetry *tlm, const NvTlmProfile *p);
+int nv_tlm_send_event(NvTelemetry *tlm, const NvTlmEvent *e);
+int nv_tlm_send_log(NvTelemetry *tlm, uint16_t id, const uint32_t *args, int nargs);
+
+// CRC-16/CCITT-FALSE; _update() continues one over data arriving in pieces,
+// starting from NV_TLM_CRC16_INIT
+uint16_t nv_tlm_crc16(const uint8_t *data, uint32_t len);
+uint16_t nv_tlm_crc16_update(uint16_t crc, const uint8_t *data, uint32_t len);
+uint32_t nv_tlm_cobs_encode(const uint8_t *src, uint32_t len, uint8_t *dst);
+
+#endif /* NV_TELEMETRY_H_ */
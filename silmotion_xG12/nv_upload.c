@@ -0,0 +1,227 @@
+/*
+ * nv_upload.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ */
+#include "nv_upload.h"
+#include <stddef.h>
+#include <string.h>
+#include "em_device.h"
+#include "nv_telemetry.h"
+
+typedef enum {
+  SLOT_FREE,
+  SLOT_FILLING,         // header in, rows arriving
+  SLOT_FULL             // rows and CRC in
+} slot_state_t;
+
+typedef enum {
+  RX_HUNT,              // matching the magic, anything else is the console's
+  RX_HEADER,
+  RX_DATA,
+  RX_CRC,
+  RX_SKIP               // rows and CRC of a frame nobody takes
+} rx_state_t;
+
+typedef struct {
+  uint8_t *data;
+  volatile uint32_t received;   // bytes of rows, written after the byte itself
+  volatile uint8_t state;       // slot_state_t
+  uint8_t taken;                // by the pipeline, upload_take()
+  uint8_t crc_ok;
+  uint16_t crc;
+  uint16_t frame;
+  uint32_t order;               // arrival order, the oldest is taken first
+} UploadSlot;
+
+static UploadSlot slots[UPLOAD_SLOTS];
+static uint32_t frame_bytes, stride;
+static int width, height;
+static pixfmt_t format;
+static uint32_t next_order;
+
+// Receiver state, owned by the RX interrupt
+static rx_state_t rx_state = RX_HUNT;
+static uint8_t header[UPLOAD_HEADER_BYTES];
+static uint32_t rx_count;       // bytes of the magic, header or CRC so far; bytes left to skip
+static UploadSlot *rx_slot;
+static upload_stats_t stats;
+
+int upload_init(uint8_t *slot_memory, uint32_t slot_bytes, int frame_width, int frame_height, pixfmt_t frame_format) {
+  memset(slots, 0, sizeof(slots));
+  memset(&stats, 0, sizeof(stats));
+  width = frame_width;
+  height = frame_height;
+  format = frame_format;
+  stride = (uint32_t)width * pixfmt_bytes_per_pixel(format);
+  frame_bytes = stride * (uint32_t)height;
+  rx_state = RX_HUNT;
+  rx_count = 0;
+  if (format > PIXFMT_GRAY8 || frame_bytes == 0 || frame_bytes > slot_bytes) return 0;
+  for (int i = 0; i < UPLOAD_SLOTS; i++) slots[i].data = slot_memory + i * slot_bytes;
+  return 1;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+/*
+ * Header complete: pick a slot, or skip the frame's rows and CRC when it
+ * cannot be taken. A header in a format with no fixed size leaves nothing to
+ * skip by, so the receiver just hunts for the next magic.
+ */
+static void start_frame(void) {
+  uint16_t w = get_u16(header + 4), h = get_u16(header + 6);
+  pixfmt_t f = (pixfmt_t)header[8];
+
+  if (w != width || h != height || f != format) {
+    stats.bad_header++;
+    if (f > PIXFMT_GRAY8) {
+      rx_state = RX_HUNT;
+      return;
+    }
+    rx_state = RX_SKIP;
+    rx_count = (uint32_t)w * h * pixfmt_bytes_per_pixel(f) + 2;
+    return;
+  }
+  for (int i = 0; i < UPLOAD_SLOTS; i++) {
+    if (slots[i].state == SLOT_FREE) {
+      rx_slot = &slots[i];
+      rx_slot->received = 0;
+      rx_slot->crc = NV_TLM_CRC16_INIT;
+      rx_slot->crc_ok = 0;
+      rx_slot->frame = get_u16(header + 10);
+      rx_slot->order = next_order++;
+      rx_slot->state = SLOT_FILLING;
+      rx_state = RX_DATA;
+      return;
+    }
+  }
+  stats.dropped++;
+  rx_state = RX_SKIP;
+  rx_count = frame_bytes + 2;
+}
+
+int upload_rx_byte(uint8_t data) {
+  switch (rx_state) {
+  case RX_HUNT:
+    if (data != (uint8_t)UPLOAD_MAGIC[rx_count]) {
+      // a broken magic may still start a new one
+      rx_count = data == (uint8_t)UPLOAD_MAGIC[0];
+      return rx_count != 0;
+    }
+    header[rx_count++] = data;
+    if (rx_count == 4) rx_state = RX_HEADER;
+    break;
+  case RX_HEADER:
+    header[rx_count++] = data;
+    if (rx_count == UPLOAD_HEADER_BYTES) {
+      rx_count = 0;
+      start_frame();
+    }
+    break;
+  case RX_DATA: {
+    uint32_t received = rx_slot->received;
+    rx_slot->data[received] = data;
+    rx_slot->crc = nv_tlm_crc16_update(rx_slot->crc, &data, 1);
+    rx_slot->received = received + 1;
+    if (received + 1 == frame_bytes) {
+      rx_state = RX_CRC;
+      rx_count = 0;
+    }
+    break;
+  }
+  case RX_CRC:
+    header[rx_count++] = data;
+    if (rx_count == 2) {
+      rx_slot->crc_ok = get_u16(header) == rx_slot->crc;
+      if (rx_slot->crc_ok) {
+        stats.frames++;
+      } else {
+        stats.bad_crc++;
+      }
+      rx_slot->state = SLOT_FULL;
+      rx_state = RX_HUNT;
+      rx_count = 0;
+    }
+    break;
+  case RX_SKIP:
+    if (--rx_count == 0) rx_state = RX_HUNT;
+    break;
+  }
+  stats.bytes++;
+  return 1;
+}
+
+static UploadSlot *oldest_pending(void) {
+  UploadSlot *oldest = NULL;
+  for (int i = 0; i < UPLOAD_SLOTS; i++) {
+    UploadSlot *slot = &slots[i];
+    if (slot->state != SLOT_FREE && !slot->taken && (oldest == NULL || (int32_t)(slot->order - oldest->order) < 0)) {
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+static UploadSlot *slot_of(const CaptureFrame *frame) {
+  for (int i = 0; i < UPLOAD_SLOTS; i++) {
+    if (slots[i].data == frame->data) return &slots[i];
+  }
+  return NULL;
+}
+
+int upload_pending(void) {
+  return oldest_pending() != NULL;
+}
+
+int upload_take(CaptureFrame *frame) {
+  UploadSlot *slot = oldest_pending();
+  if (slot == NULL) return 0;
+  slot->taken = 1;
+  frame->index = slot->frame;
+  frame->data = slot->data;
+  frame->address = 0;
+  frame->stride = stride;
+  frame->size = frame_bytes;
+  return 1;
+}
+
+int upload_rows_ready(const CaptureFrame *frame) {
+  UploadSlot *slot = slot_of(frame);
+  return slot != NULL ? (int)(slot->received / stride) : 0;
+}
+
+int upload_complete(const CaptureFrame *frame) {
+  UploadSlot *slot = slot_of(frame);
+  return slot != NULL && slot->state == SLOT_FULL;
+}
+
+int upload_release(const CaptureFrame *frame) {
+  UploadSlot *slot = slot_of(frame);
+  if (slot == NULL) return 0;
+  int ok = slot->state == SLOT_FULL && slot->crc_ok;
+  slot->taken = 0;
+  slot->state = SLOT_FREE;
+  return ok;
+}
+
+void upload_abort(const CaptureFrame *frame) {
+  UploadSlot *slot = slot_of(frame);
+  if (slot == NULL) return;
+  __disable_irq();
+  if (slot == rx_slot && (rx_state == RX_DATA || rx_state == RX_CRC)) {
+    rx_state = RX_HUNT;
+    rx_count = 0;
+  }
+  if (slot->state == SLOT_FILLING) stats.aborted++;
+  slot->taken = 0;
+  slot->state = SLOT_FREE;
+  __enable_irq();
+}
+
+const upload_stats_t *upload_stats(void) {
+  return &stats;
+}
@@ -0,0 +1,67 @@
+/*
+ * nv_upload.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Frame upload over the USART, for feeding the pipeline arbitrary sequences
+ * from the host (utils/nvupload.py, or renode_bench.py --upload). The RX
+ * interrupt hands every byte to upload_rx_byte(); on the wire a frame is
+ *
+ *   "NVUP" width:u16 height:u16 format:u8 0:u8 frame:u16     little-endian
+ *   width * height * bytes per pixel of rows, uncoded formats only
+ *   crc16:u16 of the rows, CRC-16/CCITT-FALSE as in nv_telemetry.h
+ *
+ * Outside an upload bytes are left to the console as before; inside one
+ * every byte is frame data, so a console command waits for the frame's end.
+ *
+ * Frames fill UPLOAD_SLOTS capture slots in turn. The pipeline takes a slot
+ * as soon as its header is in and converts rows as they arrive
+ * (upload_rows_ready()), so little is left to do when the last byte lands;
+ * releasing the slot after conversion frees it for the frame after next,
+ * while the next one fills the other slot. A frame that finds no free slot
+ * is skipped and counted, as is one whose header does not match the
+ * configured geometry and format.
+ */
+#ifndef NV_UPLOAD_H_
+#define NV_UPLOAD_H_
+#include <stdint.h>
+#include "nv_capture.h"
+
+#define UPLOAD_SLOTS 2
+#define UPLOAD_HEADER_BYTES 12
+#define UPLOAD_MAGIC "NVUP"
+
+typedef struct {
+  uint32_t frames;            // complete with a good CRC
+  uint32_t bad_crc;
+  uint32_t bad_header;        // not the configured geometry or format, skipped
+  uint32_t dropped;           // no free slot, skipped
+  uint32_t aborted;           // stalled mid-frame, upload_abort()
+  uint32_t bytes;             // taken by the receiver
+} upload_stats_t;
+
+// slots holds UPLOAD_SLOTS frames of slot_bytes each
+int upload_init(uint8_t *slots, uint32_t slot_bytes, int width, int height, pixfmt_t format);
+
+// From the RX interrupt. Returns 1 when the byte belonged to an upload
+int upload_rx_byte(uint8_t data);
+
+// A frame has started arriving that nobody took yet
+int upload_pending(void);
+
+// Oldest pending frame as a view onto its slot; rows fill in behind it
+int upload_take(CaptureFrame *frame);
+int upload_rows_ready(const CaptureFrame *frame);
+int upload_complete(const CaptureFrame *frame);
+
+// Frees the slot. Returns 1 when the frame arrived whole with a good CRC
+int upload_release(const CaptureFrame *frame);
+
+// Gives up on a frame still arriving, e.g. the sender stopped mid-frame; the
+// receiver goes back to looking for a header
+void upload_abort(const CaptureFrame *frame);
+
+const upload_stats_t *upload_stats(void);
+
+#endif /* NV_UPLOAD_H_ */
@@ -10,6 +10,10 @@
  * handles RX and TX interrupts, and supports callback functions for data
  * reception and transmission completion.
  *
+ * Transmission never waits: bytes are queued in a ring that the TX buffer
+ * level interrupt drains, and a write that does not fit is dropped whole and
+ * counted, so reporting cannot stall the pipeline.
+ *
  * Based on Silicon Labs example for xG12 (main_xg1_xg12_xg13_xg14.c).
  */
 #include <stdio.h>
@@ -21,12 +25,19 @@
 #include "em_gpio.h"
 #include "em_usart.h"
 #include "bsp.h"
-#define USART_TX_BUFFER_SIZE 128
+#define USART_TX_BUFFER_SIZE 128     // one usart_printf() line
+#define USART_TX_RING_SIZE 1024      // power of two
 
 // Callback function pointers
 static usart_rx_callback_t rx_callback = NULL;
 static usart_tx_callback_t tx_callback = NULL;
 
+// Free-running indices: the writers own tx_head, the TX interrupt tx_tail
+static uint8_t tx_ring[USART_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static usart_tx_stats_t tx_stats;
+
 /*
  * Initialize GPIO for VCOM communication
  */
@@ -90,11 +101,53 @@ void usart_set_tx_callback(usart_tx_callback_t cb)
  */
 void usart_send(uint8_t data)
 {
-  // Enable TX buffer level interrupt
+  usart_write(&data, 1);
+}
+
+/*
+ * Queue bytes for the TX interrupt. Interrupts are masked while the space is
+ * claimed because the RX callback may print from interrupt context.
+ */
+int usart_write(const uint8_t *data, uint32_t len)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t used = tx_head - tx_tail;
+  if (len > USART_TX_RING_SIZE - used) {
+    tx_stats.dropped_bytes += len;
+    tx_stats.dropped_writes++;
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  for (uint32_t i = 0; i < len; i++) {
+    tx_ring[(tx_head + i) & (USART_TX_RING_SIZE - 1)] = data[i];
+  }
+  tx_head += len;
+  tx_stats.bytes += len;
+  if (used + len > tx_stats.high_water) {
+    tx_stats.high_water = used + len;
+  }
+
+  // Enable TX buffer level interrupt, it drains the ring
   USART_IntEnable(USART2, USART_IEN_TXBL);
+  __set_PRIMASK(primask);
+  return (int)len;
+}
+
+uint32_t usart_tx_free(void)
+{
+  return USART_TX_RING_SIZE - (tx_head - tx_tail);
+}
 
-  // Write data to TX register
-  USART2->TXDATA = data;
+bool usart_tx_idle(void)
+{
+  return tx_head == tx_tail && (USART2->STATUS & USART_STATUS_TXC);
+}
+
+const usart_tx_stats_t *usart_tx_stats(void)
+{
+  return &tx_stats;
 }
 
 /*
@@ -112,14 +165,20 @@ void USART2_RX_IRQHandler(void)
 }
 
 /*
- * USART2 TX interrupt handler
+ * USART2 TX interrupt handler: fills the TX buffer from the ring
  */
 void USART2_TX_IRQHandler(void)
 {
   // Clear TX buffer level interrupt
   USART_IntClear(USART2, USART_IF_TXBL);
 
-  // Disable TX buffer level interrupt
+  while ((USART2->STATUS & USART_STATUS_TXBL) && tx_tail != tx_head) {
+    USART2->TXDATA = tx_ring[tx_tail & (USART_TX_RING_SIZE - 1)];
+    tx_tail++;
+  }
+  if (tx_tail != tx_head) return;
+
+  // Ring drained: disable TX buffer level interrupt until the next write
   USART_IntDisable(USART2, USART_IEN_TXBL);
 
   // Call TX callback if registered
@@ -140,11 +199,7 @@ int usart_printf(const char *format, ...) {
     int len = vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
 
-    if (len > 0) {
-        for (int i = 0; i < len; i++) {
-            usart_send((uint8_t)buffer[i]);
-        }
-    }
-
-    return len;
+    if (len <= 0) return len;
+    if (len >= (int)sizeof(buffer)) len = sizeof(buffer) - 1;   // truncated line
+    return usart_write((const uint8_t *)buffer, (uint32_t)len);
 }
@@ -23,8 +23,27 @@ void usart_set_rx_callback(usart_rx_callback_t cb);
 // Register TX callback
 void usart_set_tx_callback(usart_tx_callback_t cb);
 
-// Transmit a byte (non-blocking)
+typedef struct {
+  uint32_t bytes;             // accepted into the TX ring
+  uint32_t dropped_bytes;     // rejected because the ring was full
+  uint32_t dropped_writes;
+  uint32_t high_water;        // most bytes waiting at once
+} usart_tx_stats_t;
+
+// Queue a byte for transmission (non-blocking)
 void usart_send(uint8_t data);
 
+// Queue len bytes, all or nothing, without waiting. Returns len, or 0 when the
+// TX ring cannot take them; the drop is counted in usart_tx_stats()
+int usart_write(const uint8_t *data, uint32_t len);
+
+// Bytes the TX ring can take right now, for callers that would rather wait
+uint32_t usart_tx_free(void);
+
+// TX ring empty and the last byte shifted out
+bool usart_tx_idle(void);
+
+const usart_tx_stats_t *usart_tx_stats(void);
+
 int usart_printf(const char *format, ...);
 #endif // USART_H
@@ -0,0 +1,178 @@
+#include "nv_watch.h"
+#include <string.h>
+
+/*
+ * Pick the watch size: the frame halved until it fits WATCH_MAX_WIDTH x
+ * WATCH_MAX_HEIGHT. A frame too small for that, or for the shift search,
+ * leaves the watch WATCH_OFF and returns 0; tracking then runs alone.
+ */
+int watch_init(Watch *watch, int frame_width, int frame_height, int timeout_frames) {
+    int width = frame_width, height = frame_height;
+
+    memset(watch, 0, sizeof(*watch));
+    watch->mode = WATCH_OFF;
+    while (width > WATCH_MAX_WIDTH || height > WATCH_MAX_HEIGHT) {
+        width >>= 1;
+        height >>= 1;
+        watch->shift++;
+    }
+    if (watch->shift < WATCH_SAMPLE_SHIFT || width < 2 * WATCH_MAX_SHIFT + 1 || height < 2 * WATCH_MAX_SHIFT + 1) return 0;
+
+    watch->width = width;
+    watch->height = height;
+    watch->step = 1 << (watch->shift - WATCH_SAMPLE_SHIFT);
+    watch->sample_width = width * WATCH_SAMPLES;
+    watch->sample_height = height * WATCH_SAMPLES;
+    watch->timeout = timeout_frames > 0 ? timeout_frames : 1;
+    watch->mode = WATCH_WATCHING;
+    watch->noise_q8 = WATCH_INITIAL_NOISE_Q8;
+    return 1;
+}
+
+/*
+ * Samples from a frame already converted to gray, for coded captures
+ */
+void watch_sample_gray(Watch *watch, const unsigned char *gray, int frame_width) {
+    const unsigned char *row = gray + (watch->step >> 1) * frame_width + (watch->step >> 1);
+    unsigned char *out = watch->work;
+
+    for (int y = 0; y < watch->sample_height; y++, row += watch->step * frame_width) {
+        for (int x = 0; x < watch->sample_width; x++) *out++ = row[x * watch->step];
+    }
+}
+
+/*
+ * Samples to the watch image, in place: each output pixel lands at or before
+ * the input pixels still to be read
+ */
+static void build_watch_image(Watch *watch) {
+    int width = watch->sample_width;
+    int height = watch->sample_height;
+
+    for (int i = 0; i < WATCH_SAMPLE_SHIFT; i++) {
+        build_image_pyramid(watch->work, watch->work, width, height);
+        width >>= 1;
+        height >>= 1;
+    }
+}
+
+static void project(const Watch *watch, int32_t *col, int32_t *row) {
+    memset(col, 0, sizeof(int32_t) * watch->width);
+    memset(row, 0, sizeof(int32_t) * watch->height);
+    for (int y = 0; y < watch->height; y++) {
+        for (int x = 0; x < watch->width; x++) {
+            int v = watch->work[y * watch->width + x];
+            col[x] += v;
+            row[y] += v;
+        }
+    }
+}
+
+/*
+ * Mean residual per pixel, Q8, of cur[i] against ref[i - shift] over the
+ * overlap, after removing the mean brightness change. depth is the number of
+ * pixels summed into each profile entry.
+ */
+static uint32_t profile_cost(const int32_t *cur, const int32_t *ref, int n, int depth, int shift) {
+    int32_t diff = 0;
+    uint32_t sad = 0;
+    int count = 0;
+
+    for (int i = 0; i < n; i++) diff += cur[i] - ref[i];
+    int32_t offset = diff / n;
+    for (int i = 0; i < n; i++) {
+        int j = i - shift;
+        if (j < 0 || j >= n) continue;
+        int32_t d = cur[i] - ref[j] - offset;
+        sad += (uint32_t)(d < 0 ? -d : d);
+        count++;
+    }
+    return (uint32_t)(((uint64_t)sad << 8) / ((uint32_t)count * depth));
+}
+
+static int best_shift(const int32_t *cur, const int32_t *ref, int n, int depth) {
+    int best = 0;
+    uint32_t best_cost = profile_cost(cur, ref, n, depth, 0);
+    for (int s = -WATCH_MAX_SHIFT; s <= WATCH_MAX_SHIFT; s++) {
+        uint32_t cost = profile_cost(cur, ref, n, depth, s);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = s;
+        }
+    }
+    return best;
+}
+
+/*
+ * Watch stage for one frame, sampled into watch->work. The first frame after
+ * (re)starting becomes the reference. Returns 1 when motion is seen; the
+ * watch is then WATCH_ACTIVE and the caller runs full tracking.
+ */
+int watch_update(Watch *watch) {
+    int32_t col[WATCH_MAX_WIDTH], row[WATCH_MAX_HEIGHT];
+
+    if (watch->mode != WATCH_WATCHING) return 1;
+    build_watch_image(watch);
+    project(watch, col, row);
+
+    if (!watch->have_ref) {
+        int32_t point[2];
+        memcpy(watch->ref_col, col, sizeof(int32_t) * watch->width);
+        memcpy(watch->ref_row, row, sizeof(int32_t) * watch->height);
+        watch->textured = find_strong_feature(watch->work, watch->width, watch->height, point);
+        watch->have_ref = 1;
+        watch->change_q8 = 0;
+        return 0;
+    }
+
+    watch->change_q8 = (profile_cost(col, watch->ref_col, watch->width, watch->height, 0) +
+                        profile_cost(row, watch->ref_row, watch->height, watch->width, 0)) / 2;
+    watch->threshold_q8 = watch->noise_q8 * WATCH_THRESHOLD_FACTOR;
+    if (watch->threshold_q8 < WATCH_MIN_THRESHOLD_Q8) watch->threshold_q8 = WATCH_MIN_THRESHOLD_Q8;
+
+    if (watch->change_q8 <= watch->threshold_q8) {
+        // Like the motion gate, quiet frames only lower the floor
+        if (watch->change_q8 < watch->noise_q8) {
+            watch->noise_q8 -= (watch->noise_q8 - watch->change_q8) >> WATCH_NOISE_RATE_SHIFT;
+        }
+        return 0;
+    }
+
+    watch->dx = watch->dy = 0;
+    if (watch->textured) {
+        watch->dx = best_shift(col, watch->ref_col, watch->width, watch->height) << watch->shift;
+        watch->dy = best_shift(row, watch->ref_row, watch->height, watch->width) << watch->shift;
+    }
+    watch->alarm_q8 = watch->change_q8;
+    watch->mode = WATCH_ACTIVE;
+    watch->idle_frames = 0;
+    watch->tracked_motion = 0;
+    watch->have_ref = 0;
+    return 1;
+}
+
+/*
+ * Feed back whether full tracking saw motion on this frame. Returns 0 once
+ * the timeout has run out and the watch stage takes over again. A hand-over
+ * that tracking never confirmed raises the noise floor just enough that the
+ * same change would not trigger again. A watch that is WATCH_OFF keeps
+ * tracking.
+ */
+int watch_track_result(Watch *watch, int moved) {
+    if (watch->mode == WATCH_OFF) return 1;
+    if (watch->mode != WATCH_ACTIVE) return 0;
+    if (moved) {
+        watch->idle_frames = 0;
+        watch->tracked_motion = 1;
+        return 1;
+    }
+    if (++watch->idle_frames < watch->timeout) return 1;
+
+    if (!watch->tracked_motion) {
+        uint32_t floor_q8 = (watch->alarm_q8 + WATCH_THRESHOLD_FACTOR - 1) / WATCH_THRESHOLD_FACTOR;
+        if (floor_q8 > watch->noise_q8) watch->noise_q8 = floor_q8;
+    }
+    watch->mode = WATCH_WATCHING;
+    watch->have_ref = 0;
+    return 0;
+}
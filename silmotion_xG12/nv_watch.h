@@ -0,0 +1,75 @@
+/*
+ * nv_watch.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: nvd
+ *
+ * Tiered operation: an always-on watch stage on a tiny image (about 20x12)
+ * that hands over to full tracking when something moves, and takes over again
+ * after a timeout without tracked motion.
+ *
+ * The watch image is built without converting the frame or building its
+ * pyramid: the caller samples every step-th pixel of every step-th row
+ * straight from the capture (frame_view_sample_gray(), capture_sample_gray()
+ * in the firmware) into watch->work, and watch_update() averages the samples
+ * in place, WATCH_SAMPLES x WATCH_SAMPLES per watch pixel. Coded frames, which
+ * cannot be read out of order, are decoded as usual and sampled with
+ * watch_sample_gray(). Its column and row projections are aligned against
+ * those of a reference taken when watching started: the residual at zero
+ * shift, after removing the mean brightness change, is compared with an
+ * adaptive noise floor, and the best shift gives a coarse direction.
+ * find_strong_feature() on the reference tells whether the scene has enough
+ * texture for that shift to mean anything.
+ */
+#ifndef NV_WATCH_H_
+#define NV_WATCH_H_
+#include <stdint.h>
+#include "nv_optical_flow.h"
+
+#define WATCH_MAX_WIDTH 20
+#define WATCH_MAX_HEIGHT 16
+#define WATCH_SAMPLE_SHIFT 1        // log2 of WATCH_SAMPLES
+#define WATCH_SAMPLES (1 << WATCH_SAMPLE_SHIFT)
+#define WATCH_WORK_BYTES (WATCH_MAX_WIDTH * WATCH_SAMPLES * WATCH_MAX_HEIGHT * WATCH_SAMPLES)
+#define WATCH_MAX_SHIFT 2           // projection search range, watch pixels
+
+#define WATCH_INITIAL_NOISE_Q8 256  // 1 gray level until the floor is learned
+#define WATCH_MIN_THRESHOLD_Q8 192
+#define WATCH_THRESHOLD_FACTOR 3
+#define WATCH_NOISE_RATE_SHIFT 3
+
+typedef enum {
+    WATCH_OFF,              // frame too small to watch, always tracking
+    WATCH_WATCHING,         // watch stage only
+    WATCH_ACTIVE            // full tracking
+} watch_mode_t;
+
+typedef struct {
+    watch_mode_t mode;
+    int width, height;              // watch image
+    int shift;                      // log2 of the frame pixels per watch pixel
+    int step;                       // frame pixels between samples
+    int sample_width, sample_height;
+    int timeout;                    // active frames without tracked motion before watching again
+    int idle_frames;
+    int tracked_motion;             // tracking has seen motion since the last hand-over
+
+    unsigned char work[WATCH_WORK_BYTES];   // samples, then the watch image at the front
+    int32_t ref_col[WATCH_MAX_WIDTH];
+    int32_t ref_row[WATCH_MAX_HEIGHT];
+    int have_ref;
+    int textured;                   // find_strong_feature() succeeded on the reference
+
+    uint32_t noise_q8;              // zero-shift residual of a static scene, Q8 gray levels
+    uint32_t change_q8;             // last zero-shift residual
+    uint32_t threshold_q8;
+    uint32_t alarm_q8;              // residual that triggered the last hand-over
+    int dx, dy;                     // projection shift of the last hand-over, full-size pixels
+} Watch;
+
+int watch_init(Watch *watch, int frame_width, int frame_height, int timeout_frames);
+void watch_sample_gray(Watch *watch, const unsigned char *gray, int frame_width);
+int watch_update(Watch *watch);
+int watch_track_result(Watch *watch, int moved);
+
+#endif /* NV_WATCH_H_ */
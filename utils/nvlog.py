@@ -0,0 +1,122 @@
+"""
+String table of the tokenized log sites, see algo/optical-flow/nv_log.h.
+
+  python nvlog.py silmotion_xG12.axf -o nv_log_strings.json
+  python nvlog.py build/run.exe --list
+
+Every NV_LOGx() site puts "level<US>file:line<US>format" into the nv_log
+section of the ELF, and its offset there is the ID the target sends. This
+reads the section and writes the table as JSON, keyed by ID. Run it after
+each build: IDs change whenever a site is added, removed or edited.
+utils/nvtlm.py --strings takes the JSON or the ELF itself.
+
+format_message() renders a format with the raw 32-bit arguments of a
+message, the way printf would have on the target.
+"""
+import argparse
+import json
+import re
+import struct
+import sys
+
+SECTION = 'nv_log'
+SEPARATOR = '\x1f'
+LEVELS = {'E': 'error', 'W': 'warn', 'I': 'info', 'D': 'debug'}
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcs%])')
+
+
+def elf_section(data, name):
+    """Contents of the named section of a 32- or 64-bit little-endian ELF."""
+    if data[:4] != b'\x7fELF' or data[5] != 1:
+        raise ValueError("not a little-endian ELF file")
+    if data[4] == 1:
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+        header = lambda i: struct.unpack_from('<IIIIII', data, shoff + i * shentsize)
+    else:
+        shoff, = struct.unpack_from('<Q', data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x3A)
+        header = lambda i: struct.unpack_from('<IIQQQQ', data, shoff + i * shentsize)
+    names = header(shstrndx)
+    for i in range(shnum):
+        name_offset, _, _, _, offset, size = header(i)
+        start = names[4] + name_offset
+        if data[start:data.index(b'\0', start)].decode() == name:
+            return data[offset:offset + size]
+    return None
+
+
+def extract(path):
+    """{id: {'level', 'site', 'format'}} of every site in the ELF."""
+    with open(path, 'rb') as f:
+        section = elf_section(f.read(), SECTION)
+    table = {}
+    if section is None:
+        return table
+    i = 0
+    while i < len(section):
+        # Sites are NUL terminated; the compiler may pad between them
+        if section[i] == 0:
+            i += 1
+            continue
+        end = section.index(b'\0', i)
+        level, site, fmt = section[i:end].decode(errors='replace').split(SEPARATOR, 2)
+        table[i] = {'level': LEVELS.get(level, level), 'site': site, 'format': fmt}
+        i = end + 1
+    return table
+
+
+def load(path):
+    """Table from nvlog.py JSON or straight from an ELF."""
+    with open(path, 'rb') as f:
+        magic = f.read(4)
+    if magic == b'\x7fELF':
+        return extract(path)
+    with open(path) as f:
+        return {int(k): v for k, v in json.load(f).items()}
+
+
+def format_message(fmt, args):
+    """printf of 32-bit integer arguments; %s has no string to show."""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, kind = match.groups()
+        if kind == '%':
+            return '%'
+        if not args:
+            return '<missing>'
+        value = args.pop(0)
+        if kind == 's':
+            return '<str>'
+        if kind in 'di' and value >= 1 << 31:
+            value -= 1 << 32
+        spec = '%' + flags + width + ('.' + precision if precision else '') + ('d' if kind == 'u' else kind)
+        return spec % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Extract the tokenized log string table from an ELF")
+    parser.add_argument('elf', help="silmotion_xG12.axf or an ELF run.exe")
+    parser.add_argument('-o', '--output', help="JSON table")
+    parser.add_argument('--list', action='store_true', help="print the sites")
+    args = parser.parse_args()
+
+    try:
+        table = extract(args.elf)
+        if args.list:
+            for key, entry in sorted(table.items()):
+                print(f"{key:5d} {entry['level']:<5} {entry['site']:<30} {entry['format']!r}")
+        if args.output:
+            with open(args.output, 'w') as f:
+                json.dump({str(k): v for k, v in sorted(table.items())}, f, indent=1)
+            print(f"Wrote {len(table)} log sites to '{args.output}'.")
+    except Exception as e:
+        print(f"An error occurred: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
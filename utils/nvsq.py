@@ -0,0 +1,373 @@
+"""
+NVSQ multi-frame container tool, see algo/optical-flow/nv_sequence.h for the layout.
+
+  python nvsq.py pack -o test.nvsq --fps 5 frame1.jpg frame2.jpg
+  python nvsq.py pack -o test.nvsq frame1_rgb565.h frame2_rgb565.h
+  python nvsq.py pack -o test.nvsq --width 160 --height 90 --format gray8 capture.raw
+  python nvsq.py pack -o test.nvsq --format rgb565-drle --tolerance 1 frame*.jpg
+  python nvsq.py pack -o test.nvsq --format jpeg capture*.jpg
+  python nvsq.py info test.nvsq
+  python nvsq.py asm test.nvsq nvsq_test > nvsq_test.S
+
+Inputs to pack may be images (needs Pillow), headers generated by jpg_to_h.py,
+or raw files holding one or more frames back to back. The asm command emits
+an assembler file that links the container into flash with .incbin, so the
+firmware can walk it in place with nvsq_open_memory().
+
+rgb565-drle stores RGB565 frames delta + run-length coded (nv_codec.h); the
+firmware decodes them straight to gray. It is lossless by default; with
+--tolerance T each channel may be off by up to T steps, which lengthens runs.
+
+jpeg stores baseline JPEG files unchanged, as the OV2640 sends them in JPEG
+mode; nv_jpeg.h decodes them to 1/8 or 1/4 size gray.
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0x5153564E
+VERSION = 1
+HEADER_FORMAT = '<IHHHHBBHIIII'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+FLAG_TIMESTAMPS = 0x01
+FLAG_MOTION = 0x02
+MOTION_FORMAT = '<8i'           # NvSeqMotion: m[6], gain, offset
+
+FORMATS = {'rgb565': 0, 'yuyv': 1, 'gray8': 2, 'rgb565-drle': 3, 'jpeg': 4}
+BYTES_PER_PIXEL = {0: 2, 1: 2, 2: 1, 3: 2}
+
+# DRLE token opcodes and channel masks, see nv_codec.h
+DRLE_RUN, DRLE_DIFF, DRLE_DELTA, DRLE_LITERAL = 0x00, 0x40, 0x80, 0xC0
+DRLE_MAX_COUNT = 64
+CHANNEL_MASKS = (0x1F, 0x3F, 0x1F)
+
+
+def rgb888_to_rgb565(r, g, b):
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
+
+
+def align4(n):
+    return (n + 3) & ~3
+
+
+def split565(p):
+    return (p >> 11, (p >> 5) & 0x3F, p & 0x1F)
+
+
+def wrap_delta(a, b, mask):
+    """b - a as the signed value that wraps back to b under mask."""
+    d = (b - a) & mask
+    return d - (mask + 1) if d > mask >> 1 else d
+
+
+def fit_delta(d, lo, hi, tolerance):
+    """The value in lo..hi nearest to d, or None when it is more than tolerance away."""
+    q = min(max(d, lo), hi)
+    return q if abs(q - d) <= tolerance else None
+
+
+def drle_encode(frame, tolerance=0):
+    """Code one RGB565 frame. The encoder tracks what the decoder reconstructs,
+    so with a tolerance the error never exceeds it and does not accumulate."""
+    pixels = struct.unpack(f'<{len(frame) // 2}H', frame)
+    out = bytearray()
+    prev = (0, 0, 0)
+    run = 0
+    literals = []
+
+    def flush():
+        nonlocal run
+        if run:
+            out.append(DRLE_RUN | (run - 1))
+            run = 0
+        if literals:
+            out.append(DRLE_LITERAL | (len(literals) - 1))
+            out.extend(struct.pack(f'<{len(literals)}H', *literals))
+            literals.clear()
+
+    for p in pixels:
+        d = [wrap_delta(a, b, m) for a, b, m in zip(prev, split565(p), CHANNEL_MASKS)]
+        if all(abs(v) <= tolerance for v in d):
+            if literals:
+                flush()
+            run += 1
+            if run == DRLE_MAX_COUNT:
+                flush()
+            continue
+
+        diff = [fit_delta(v, -2, 1, tolerance) for v in d]
+        delta = [fit_delta(d[0], -8, 7, tolerance), fit_delta(d[1], -32, 31, tolerance),
+                 fit_delta(d[2], -8, 7, tolerance)]
+        if None not in diff:
+            flush()
+            out.append(DRLE_DIFF | ((diff[0] + 2) << 4) | ((diff[1] + 2) << 2) | (diff[2] + 2))
+            q = diff
+        elif None not in delta:
+            flush()
+            out.append(DRLE_DELTA | (delta[1] + 32))
+            out.append(((delta[0] + 8) << 4) | (delta[2] + 8))
+            q = delta
+        else:
+            if run:
+                flush()
+            literals.append(p)
+            if len(literals) == DRLE_MAX_COUNT:
+                flush()
+            prev = split565(p)
+            continue
+        prev = tuple((a + v) & m for a, v, m in zip(prev, q, CHANNEL_MASKS))
+    flush()
+    return bytes(out)
+
+
+def drle_decode(data, pixels):
+    """Reference decoder back to RGB565, for checking the encoder."""
+    out = []
+    prev = (0, 0, 0)
+    pos = 0
+    while len(out) < pixels:
+        token = data[pos]
+        pos += 1
+        op, n = token & 0xC0, (token & 0x3F) + 1
+        if op == DRLE_RUN:
+            out.extend([(prev[0] << 11) | (prev[1] << 5) | prev[2]] * n)
+            continue
+        if op == DRLE_LITERAL:
+            lits = struct.unpack_from(f'<{n}H', data, pos)
+            pos += n * 2
+            out.extend(lits)
+            prev = split565(lits[-1])
+            continue
+        if op == DRLE_DIFF:
+            d = (((token >> 4) & 3) - 2, ((token >> 2) & 3) - 2, (token & 3) - 2)
+        else:
+            d = ((data[pos] >> 4) - 8, (token & 0x3F) - 32, (data[pos] & 0x0F) - 8)
+            pos += 1
+        prev = tuple((a + v) & m for a, v, m in zip(prev, d, CHANNEL_MASKS))
+        out.append((prev[0] << 11) | (prev[1] << 5) | prev[2])
+    return out
+
+
+def load_jpeg(path):
+    """File bytes and size from the frame header. Only sequential Huffman
+    JPEGs (SOF0, SOF1) are accepted, as nv_jpeg.h decodes nothing else."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:2] != b'\xff\xd8':
+        raise ValueError(f"{path}: not a JPEG file")
+    pos = 2
+    while pos + 4 <= len(data):
+        marker = data[pos + 1]
+        if data[pos] != 0xFF or marker in (0xD9, 0xDA):
+            break
+        length = struct.unpack_from('>H', data, pos + 2)[0]
+        if marker in (0xC0, 0xC1):
+            height, width = struct.unpack_from('>HH', data, pos + 5)
+            return width, height, [data]
+        if 0xC2 <= marker <= 0xCF and marker not in (0xC4, 0xC8, 0xCC):
+            raise ValueError(f"{path}: only baseline JPEG is supported")
+        pos += 2 + length
+    raise ValueError(f"{path}: no frame header")
+
+
+def load_image(path, fmt):
+    from PIL import Image
+    img = Image.open(path).convert('RGB')
+    width, height = img.size
+    if fmt == FORMATS['gray8']:
+        data = bytes(img.convert('L').getdata())
+    elif fmt in (FORMATS['rgb565'], FORMATS['rgb565-drle']):
+        data = b''.join(struct.pack('<H', rgb888_to_rgb565(r, g, b)) for r, g, b in img.getdata())
+    else:
+        raise ValueError("images can only be packed as rgb565 or gray8")
+    return width, height, [data]
+
+
+def load_header(path):
+    """Frame array and size from a header written by jpg_to_h.py."""
+    with open(path) as f:
+        text = f.read()
+    width = int(re.search(r'_width\s*=\s*(\d+)', text).group(1))
+    height = int(re.search(r'_height\s*=\s*(\d+)', text).group(1))
+    body = text[text.index('{') + 1:text.index('}')]
+    pixels = [int(v, 16) for v in re.findall(r'0x[0-9A-Fa-f]+', body)]
+    if len(pixels) != width * height:
+        raise ValueError(f"{path}: {len(pixels)} pixels, expected {width}x{height}")
+    return width, height, [struct.pack(f'<{len(pixels)}H', *pixels)]
+
+
+def load_raw(path, width, height, fmt):
+    if not width or not height:
+        raise ValueError("raw input needs --width and --height")
+    frame_bytes = width * height * BYTES_PER_PIXEL[fmt]
+    with open(path, 'rb') as f:
+        data = f.read()
+    count = len(data) // frame_bytes
+    if count == 0:
+        raise ValueError(f"{path}: shorter than one {width}x{height} frame")
+    return width, height, [data[i * frame_bytes:(i + 1) * frame_bytes] for i in range(count)]
+
+
+def load_frames(path, args, fmt):
+    ext = os.path.splitext(path)[1].lower()
+    if fmt == FORMATS['jpeg']:
+        if ext not in ('.jpg', '.jpeg'):
+            raise ValueError(f"{path}: jpeg sequences are packed from .jpg files")
+        return load_jpeg(path)
+    if ext in ('.jpg', '.jpeg', '.png', '.bmp'):
+        return load_image(path, fmt)
+    if ext == '.h':
+        if fmt not in (FORMATS['rgb565'], FORMATS['rgb565-drle']):
+            raise ValueError("generated headers hold rgb565 frames")
+        return load_header(path)
+    return load_raw(path, args.width, args.height, fmt)
+
+
+def write_sequence(path, width, height, fmt, fps, frames, timestamps=None, motion=None):
+    """motion: one NvSeqMotion tuple per frame (m0..m5, gain, offset), or None."""
+    count = len(frames)
+    flags = (FLAG_TIMESTAMPS if timestamps else 0) | (FLAG_MOTION if motion else 0)
+    index_offset = HEADER_SIZE
+    pos = index_offset + (count + 1) * 4
+    ts_offset = 0
+    if timestamps:
+        ts_offset = pos
+        pos += count * 4
+    if motion:
+        if len(motion) != count:
+            raise ValueError(f"{len(motion)} motion records for {count} frames")
+        pos += count * struct.calcsize(MOTION_FORMAT)
+
+    offsets = []
+    pos = align4(pos)
+    for frame in frames:
+        offsets.append(pos)
+        pos = align4(pos + len(frame))
+    offsets.append(offsets[-1] + len(frames[-1]))
+
+    with open(path, 'wb') as f:
+        f.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, HEADER_SIZE, width, height, fmt, flags, 0,
+                            int(round(fps * 1000)), count, index_offset, ts_offset))
+        f.write(struct.pack(f'<{count + 1}I', *offsets))
+        if timestamps:
+            f.write(struct.pack(f'<{count}I', *timestamps))
+        if motion:
+            for record in motion:
+                f.write(struct.pack(MOTION_FORMAT, *record))
+        for i, frame in enumerate(frames):
+            f.write(b'\0' * (offsets[i] - f.tell()))
+            f.write(frame)
+
+
+def read_header(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    fields = struct.unpack_from(HEADER_FORMAT, data)
+    if fields[0] != MAGIC:
+        raise ValueError(f"{path}: not an NVSQ file")
+    return data, fields
+
+
+def cmd_pack(args):
+    fmt = FORMATS[args.format]
+    width = height = None
+    frames = []
+    for path in args.inputs:
+        w, h, data = load_frames(path, args, fmt)
+        if width is None:
+            width, height = w, h
+        elif (w, h) != (width, height):
+            raise ValueError(f"{path}: {w}x{h} does not match {width}x{height}")
+        frames.extend(data)
+
+    timestamps = None
+    if args.timestamps:
+        timestamps = [int(t) for t in args.timestamps.split(',')]
+        if len(timestamps) != len(frames):
+            raise ValueError(f"{len(timestamps)} timestamps for {len(frames)} frames")
+
+    raw_bytes = sum(len(frame) for frame in frames)
+    if fmt == FORMATS['rgb565-drle']:
+        coded = [drle_encode(frame, args.tolerance) for frame in frames]
+        if args.tolerance == 0:
+            for i, (frame, code) in enumerate(zip(frames, coded)):
+                if drle_decode(code, width * height) != list(struct.unpack(f'<{width * height}H', frame)):
+                    raise ValueError(f"frame {i} does not decode back losslessly")
+        frames = coded
+    write_sequence(args.output, width, height, fmt, args.fps, frames, timestamps)
+    print(f"Wrote {len(frames)} {width}x{height} {args.format} frames to '{args.output}'.")
+    if fmt == FORMATS['rgb565-drle']:
+        coded = sum(len(frame) for frame in frames)
+        print(f"Coded {raw_bytes} bytes of rgb565 into {coded} ({raw_bytes / coded:.2f}:1).")
+
+
+def cmd_info(args):
+    data, (magic, version, header_size, width, height, fmt, flags, _, fps_milli,
+           count, index_offset, ts_offset) = read_header(args.input)
+    names = {v: k for k, v in FORMATS.items()}
+    print(f"{args.input}: version {version}, {count} frames, {width}x{height} "
+          f"{names.get(fmt, fmt)}, {fps_milli / 1000:g} fps, {len(data)} bytes")
+    offsets = struct.unpack_from(f'<{count + 1}I', data, index_offset)
+    stamps = struct.unpack_from(f'<{count}I', data, ts_offset) if flags & FLAG_TIMESTAMPS else None
+    motion_offset = index_offset + (count + 1) * 4 + (count * 4 if stamps else 0)
+    for i in range(count):
+        ts = f", t={stamps[i]} ms" if stamps else ""
+        gt = ""
+        if flags & FLAG_MOTION:
+            m = struct.unpack_from(MOTION_FORMAT, data, motion_offset + i * struct.calcsize(MOTION_FORMAT))
+            gt = (f", motion [{m[0] / 16384:.4f} {m[1] / 16384:.4f} {m[2] / 16384:+.3f};"
+                  f" {m[3] / 16384:.4f} {m[4] / 16384:.4f} {m[5] / 16384:+.3f}]"
+                  f" gain {m[6] / 16384:.3f} offset {m[7] / 16384:+.2f}")
+        print(f"  frame {i}: offset {offsets[i]}, {offsets[i + 1] - offsets[i]} bytes{ts}{gt}")
+
+
+def cmd_asm(args):
+    read_header(args.input)
+    path = os.path.abspath(args.input).replace('\\', '/')
+    print(f"/* Generated by nvsq.py from {os.path.basename(args.input)} */")
+    print(f'    .section .rodata.{args.symbol},"a",%progbits')
+    print("    .balign 4")
+    print(f"    .global {args.symbol}")
+    print(f"{args.symbol}:")
+    print(f'    .incbin "{path}"')
+    print(f"    .global {args.symbol}_end")
+    print(f"{args.symbol}_end:")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="NVSQ multi-frame container tool")
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    pack = sub.add_parser('pack', help="pack frames into a container")
+    pack.add_argument('inputs', nargs='+')
+    pack.add_argument('-o', '--output', required=True)
+    pack.add_argument('--format', choices=FORMATS, default='rgb565')
+    pack.add_argument('--fps', type=float, default=5.0)
+    pack.add_argument('--width', type=int)
+    pack.add_argument('--height', type=int)
+    pack.add_argument('--timestamps', help="comma separated capture times in ms, one per frame")
+    pack.add_argument('--tolerance', type=int, default=0,
+                      help="rgb565-drle: allowed error per channel, 0 for lossless")
+    pack.set_defaults(func=cmd_pack)
+
+    info = sub.add_parser('info', help="print header and frame index")
+    info.add_argument('input')
+    info.set_defaults(func=cmd_info)
+
+    asm = sub.add_parser('asm', help="emit an .incbin assembler file for linking into flash")
+    asm.add_argument('input')
+    asm.add_argument('symbol')
+    asm.set_defaults(func=cmd_asm)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except Exception as e:
+        print(f"An error occurred: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
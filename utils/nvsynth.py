@@ -0,0 +1,176 @@
+"""
+Synthetic sequences with known motion, written as NVSQ with ground truth attached
+(NVSQ_FLAG_MOTION, see algo/optical-flow/nv_sequence.h). Needs Pillow.
+
+  python nvsynth.py -o shift.nvsq --tx 1.3 --ty -0.7
+  python nvsynth.py -o spin.nvsq --size 640x480 --frames 30 --rotate 0.5 --scale 1.01
+  python nvsynth.py -o noisy.nvsq --tx 2 --noise 4 --gain 0.98 --offset 2 --jitter 0.3
+  python nvsynth.py -o seed.nvsq --seed-image photo.jpg --format rgb565-drle --tx 0.25
+
+Every frame is rendered from the seed image (default: the compiled-in
+frame1_rgb565.h), resized to --size, under the accumulated motion: per frame a
+similarity about the image centre (--rotate degrees, --scale factor) followed
+by a translation (--tx, --ty pixels plus up to --jitter of uniform noise).
+Pixels beyond the seed are filled from its mirror images, so there are no
+borders. Brightness changes by --gain and --offset per frame, and Gaussian
+noise of --noise gray levels is added independently to every frame.
+
+Frame i carries the motion from frame i - 1 as an NvSeqMotion record, in
+pixel-index coordinates. --random-seed makes jitter and noise repeatable.
+"""
+import argparse
+import math
+import os
+import random
+import struct
+import sys
+from statistics import NormalDist
+
+import nvsq
+
+Q14 = 1 << 14
+DEFAULT_SEED = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'algo', 'optical-flow',
+                            'frame1_rgb565.h')
+
+
+def load_seed(path):
+    from PIL import Image
+    if os.path.splitext(path)[1].lower() == '.h':
+        width, height, frames = nvsq.load_header(path)
+        pixels = struct.unpack(f'<{width * height}H', frames[0])
+        rgb = bytearray()
+        for p in pixels:
+            r, g, b = p >> 11, (p >> 5) & 0x3F, p & 0x1F
+            rgb += bytes(((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)))
+        return Image.frombytes('RGB', (width, height), bytes(rgb))
+    return Image.open(path).convert('RGB')
+
+
+def mirrored_canvas(img):
+    """3x3 tiling with mirrored neighbours; the original is the centre tile."""
+    from PIL import Image, ImageOps
+    w, h = img.size
+    mirrored = ImageOps.mirror(img)
+    tiles = {(False, False): img, (True, False): mirrored,
+             (False, True): ImageOps.flip(img), (True, True): ImageOps.flip(mirrored)}
+    canvas = Image.new('RGB', (3 * w, 3 * h))
+    for ty in range(3):
+        for tx in range(3):
+            canvas.paste(tiles[(tx != 1, ty != 1)], (tx * w, ty * h))
+    return canvas
+
+
+def compose(outer, inner):
+    """outer after inner; an affine is (a, b, c, d, e, f) for x' = a x + b y + c, y' = d x + e y + f."""
+    a, b, c, d, e, f = outer
+    p, q, r, s, t, u = inner
+    return (a * p + b * s, a * q + b * t, a * r + b * u + c,
+            d * p + e * s, d * q + e * t, d * r + e * u + f)
+
+
+def invert(m):
+    a, b, c, d, e, f = m
+    det = a * e - b * d
+    ia, ib, id_, ie = e / det, -b / det, -d / det, a / det
+    return (ia, ib, -(ia * c + ib * f), id_, ie, -(id_ * c + ie * f))
+
+
+def frame_motion(args, width, height, rng):
+    """One frame of motion in pixel-index coordinates, about the image centre."""
+    cx, cy = (width - 1) / 2, (height - 1) / 2
+    angle = math.radians(args.rotate)
+    a, b = args.scale * math.cos(angle), -args.scale * math.sin(angle)
+    d, e = -b, a
+    tx = args.tx + rng.uniform(-args.jitter, args.jitter)
+    ty = args.ty + rng.uniform(-args.jitter, args.jitter)
+    return (a, b, cx - a * cx - b * cy + tx, d, e, cy - d * cx - e * cy + ty)
+
+
+def noise_image(size, sigma, rng):
+    """Gaussian noise around 128 from uniform bytes through the inverse CDF."""
+    from PIL import Image
+    dist = NormalDist(128, sigma)
+    lut = [min(255, max(0, round(dist.inv_cdf((u + 0.5) / 256)))) for u in range(256)]
+    return Image.frombytes('L', size, rng.randbytes(size[0] * size[1])).point(lut)
+
+
+def render(canvas, width, height, to_frame, gain, offset, sigma, rng):
+    """Frame showing the seed moved by to_frame (seed to frame, index coordinates)."""
+    from PIL import Image, ImageChops
+    # Pillow maps output to input in coordinates where pixel centres are at +0.5
+    a, b, c, d, e, f = invert(to_frame)
+    data = (a, b, c + 0.5 - 0.5 * (a + b) + width, d, e, f + 0.5 - 0.5 * (d + e) + height)
+    img = canvas.transform((width, height), Image.AFFINE, data, resample=Image.BICUBIC)
+    if gain != 1 or offset != 0:
+        img = img.point([min(255, max(0, round(v * gain + offset))) for v in range(256)] * 3)
+    if sigma > 0:
+        bands = [ImageChops.add(band, noise_image(img.size, sigma, rng), 1, -128) for band in img.split()]
+        img = Image.merge('RGB', bands)
+    return img
+
+
+def encode(img, fmt):
+    if fmt == nvsq.FORMATS['gray8']:
+        return img.convert('L').tobytes()
+    rgb = img.tobytes()
+    return b''.join(struct.pack('<H', nvsq.rgb888_to_rgb565(*rgb[i:i + 3])) for i in range(0, len(rgb), 3))
+
+
+def to_record(m, gain, offset):
+    a, b, c, d, e, f = m
+    return tuple(int(round(v * Q14)) for v in (a, b, c, d, e, f, gain, offset))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Render an NVSQ sequence with known motion")
+    parser.add_argument('-o', '--output', required=True)
+    parser.add_argument('--seed-image', default=DEFAULT_SEED, help="image or jpg_to_h.py header")
+    parser.add_argument('--size', help="WxH, default the seed image size")
+    parser.add_argument('--frames', type=int, default=10)
+    parser.add_argument('--format', choices=('gray8', 'rgb565', 'rgb565-drle'), default='rgb565')
+    parser.add_argument('--fps', type=float, default=5.0)
+    parser.add_argument('--tx', type=float, default=0.0, help="pixels per frame")
+    parser.add_argument('--ty', type=float, default=0.0, help="pixels per frame")
+    parser.add_argument('--rotate', type=float, default=0.0, help="degrees per frame, about the centre")
+    parser.add_argument('--scale', type=float, default=1.0, help="zoom factor per frame")
+    parser.add_argument('--jitter', type=float, default=0.0, help="uniform translation noise, pixels")
+    parser.add_argument('--noise', type=float, default=0.0, help="Gaussian noise sigma, gray levels")
+    parser.add_argument('--gain', type=float, default=1.0, help="brightness gain per frame")
+    parser.add_argument('--offset', type=float, default=0.0, help="brightness offset per frame, gray levels")
+    parser.add_argument('--random-seed', type=int, default=1)
+    args = parser.parse_args()
+
+    try:
+        seed = load_seed(args.seed_image)
+        if args.size:
+            width, height = (int(v) for v in args.size.lower().split('x'))
+            seed = seed.resize((width, height), resample=3)
+        width, height = seed.size
+        canvas = mirrored_canvas(seed)
+        rng = random.Random(args.random_seed)
+        fmt = nvsq.FORMATS[args.format]
+
+        to_frame = (1, 0, 0, 0, 1, 0)
+        gain, offset = 1.0, 0.0
+        frames, motion = [], []
+        for i in range(args.frames):
+            step, step_gain, step_offset = (1, 0, 0, 0, 1, 0), 1.0, 0.0
+            if i > 0:
+                step = frame_motion(args, width, height, rng)
+                step_gain, step_offset = args.gain, args.offset
+                to_frame = compose(step, to_frame)
+                gain, offset = gain * step_gain, offset * step_gain + step_offset
+            frames.append(encode(render(canvas, width, height, to_frame, gain, offset, args.noise, rng), fmt))
+            motion.append(to_record(step, step_gain, step_offset))
+
+        if args.format == 'rgb565-drle':
+            frames = [nvsq.drle_encode(frame) for frame in frames]
+        nvsq.write_sequence(args.output, width, height, fmt, args.fps, frames, motion=motion)
+        print(f"Wrote {len(frames)} {width}x{height} {args.format} frames with ground truth to '{args.output}'.")
+    except Exception as e:
+        print(f"An error occurred: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,272 @@
+"""
+Decoder for the firmware's binary telemetry, see algo/optical-flow/nv_telemetry.h
+for the wire format.
+
+  python nvtlm.py file telemetry.bin
+  python nvtlm.py tcp localhost:12345              # Renode USART socket, emulate/README.md
+  python nvtlm.py serial /dev/ttyACM0 --baud 115200 --json
+  python nvtlm.py tcp localhost:12345 --send p      # request the stage timings first
+  python nvtlm.py tcp localhost:12345 --send '$window=7;$iterations=3;'   # tune the tracker
+  python nvtlm.py file telemetry.bin --strings build/run.exe
+
+Frames are COBS encoded and end at a 0x00 byte; each carries a type, a
+sequence number and a CRC-16/CCITT-FALSE. Frames with a bad CRC or length are
+counted and skipped, and gaps in the sequence numbers count the frames lost
+on the way (a full TX ring on the target drops whole frames). The summary on
+exit, or on Ctrl-C, shows both.
+
+Messages print as the text lines the firmware used to send, or with --json as
+one JSON object per line. The host build writes the same stream with
+`run.exe -t file`.
+
+LOG messages carry only a site ID and raw arguments (nv_log.h); --strings
+gives the table to render them with, as JSON from utils/nvlog.py or the ELF
+(AXF) itself. Without it they print as the ID and argument words.
+
+The serial command needs pyserial.
+"""
+import argparse
+import json
+import socket
+import struct
+import sys
+
+import nvlog
+
+TEXT, MOTION, STATS, PROFILE, LOG, EVENT = 1, 2, 3, 4, 5, 6
+
+STATES = ('no reference', 'Up', 'Down', 'Unknown', 'still', 'watching', 'failed')
+DIRECTIONS = ('Still', 'Right', 'Up-Right', 'Up', 'Up-Left', 'Left', 'Down-Left', 'Down', 'Down-Right')
+STAGES = ('convert', 'pyramid', 'watch', 'gate', 'features', 'gradient', 'track', 'motion', 'frame')
+UNITS = ('ns', 'cycles')
+FLAG_WATCH_ALARM = 0x01
+FLAG_BACK_TO_WATCH = 0x02
+
+# Bodies after type and seq, little-endian as nv_telemetry.c writes them
+MOTION_BODY = struct.Struct('<I6BiiHH')
+STATS_BODY = struct.Struct('<4HBII')
+PROFILE_BODY = struct.Struct('<2B7I')
+EVENT_BODY = struct.Struct('<I3BIiiII')
+
+Q14 = 1 << 14
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse(payload, strings=None):
+    """Message dict of a decoded, CRC-checked payload."""
+    kind, seq, body = payload[0], payload[1], payload[2:]
+    if kind == TEXT:
+        return {'type': 'text', 'seq': seq, 'text': body.decode(errors='replace')}
+    if kind == LOG and len(body) >= 2 and len(body) % 4 == 2:
+        site, = struct.unpack_from('<H', body)
+        args = list(struct.unpack_from(f'<{(len(body) - 2) // 4}I', body, 2))
+        message = {'type': 'log', 'seq': seq, 'id': site, 'args': args}
+        entry = strings.get(site) if strings else None
+        if entry:
+            message.update(level=entry['level'], site=entry['site'], text=nvlog.format_message(entry['format'], args))
+        return message
+    if kind == MOTION and len(body) == MOTION_BODY.size:
+        (frame, state, flags, confidence, features, tracked, inliers, dx, dy, change_q8,
+         threshold_q8) = MOTION_BODY.unpack(body)
+        return {'type': 'motion', 'seq': seq, 'frame': frame,
+                'state': STATES[state] if state < len(STATES) else state,
+                'watch_alarm': bool(flags & FLAG_WATCH_ALARM), 'back_to_watch': bool(flags & FLAG_BACK_TO_WATCH),
+                'confidence': confidence, 'features': features, 'tracked': tracked, 'inliers': inliers,
+                'dx': dx / Q14, 'dy': dy / Q14, 'dy_q14': dy, 'change_q8': change_q8, 'threshold_q8': threshold_q8}
+    if kind == STATS and len(body) == STATS_BODY.size:
+        frames, still, watching, fps_x100, target_fps, dropped, tx_dropped = STATS_BODY.unpack(body)
+        return {'type': 'stats', 'seq': seq, 'frames': frames, 'still': still, 'watching': watching,
+                'fps': fps_x100 / 100, 'target_fps': target_fps, 'dropped': dropped, 'tx_dropped': tx_dropped}
+    if kind == PROFILE and len(body) == PROFILE_BODY.size:
+        stage, unit, *values = PROFILE_BODY.unpack(body)
+        message = {'type': 'profile', 'seq': seq,
+                   'stage': STAGES[stage] if stage < len(STAGES) else stage,
+                   'unit': UNITS[unit] if unit < len(UNITS) else unit}
+        message.update(zip(('count', 'min', 'mean', 'p50', 'p90', 'p99', 'max'), values))
+        return message
+    if kind == EVENT and len(body) == EVENT_BODY.size:
+        frame, direction, previous, confidence, duration, dx, dy, magnitude, speed = EVENT_BODY.unpack(body)
+        return {'type': 'event', 'seq': seq, 'frame': frame,
+                'direction': DIRECTIONS[direction] if direction < len(DIRECTIONS) else direction,
+                'previous': DIRECTIONS[previous] if previous < len(DIRECTIONS) else previous,
+                'confidence': confidence, 'duration': duration, 'dx': dx / Q14, 'dy': dy / Q14,
+                'px_per_frame': magnitude / Q14, 'px_per_s': speed / Q14}
+    raise ValueError(f"unknown message type {kind} or length {len(body)}")
+
+
+class Decoder:
+    """Byte stream in, messages out; keeps error and loss counts."""
+
+    def __init__(self, strings=None):
+        self.strings = strings
+        self.pending = bytearray()
+        self.expected_seq = None
+        self.messages = 0
+        self.bad_frames = 0
+        self.lost = 0
+
+    def feed(self, data):
+        messages = []
+        self.pending += data
+        while True:
+            end = self.pending.find(0)
+            if end < 0:
+                return messages
+            frame = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if not frame:
+                continue
+            try:
+                payload = cobs_decode(frame)
+                if len(payload) < 4 or crc16(payload[:-2]) != struct.unpack_from('<H', payload, len(payload) - 2)[0]:
+                    raise ValueError("bad CRC")
+                message = parse(payload[:-2], self.strings)
+            except ValueError:
+                self.bad_frames += 1
+                continue
+            if self.expected_seq is not None:
+                self.lost += (message['seq'] - self.expected_seq) & 0xFF
+            self.expected_seq = (message['seq'] + 1) & 0xFF
+            self.messages += 1
+            messages.append(message)
+
+    def summary(self):
+        return f"{self.messages} messages, {self.bad_frames} bad frames, {self.lost} lost"
+
+
+def render(message):
+    """The text the firmware printed before telemetry: TEXT as sent, which may be
+    part of a line, anything else as whole lines without the last newline."""
+    kind = message['type']
+    if kind == 'text':
+        return message['text']
+    if kind == 'log':
+        if 'text' in message:
+            return message['text']
+        return f"log #{message['id']} " + ' '.join(f"{v:#x}" for v in message['args']) + '\n'
+    if kind == 'motion':
+        frame, state = message['frame'], message['state']
+        lines = []
+        if message['watch_alarm']:
+            lines.append(f"{frame}: => Watch saw motion, shift ({message['dx']:.0f},{message['dy']:.0f})")
+        if state == 'watching':
+            lines.append(f"{frame}: => Watching change={message['change_q8']} threshold={message['threshold_q8']}")
+        elif state == 'still':
+            lines.append(f"{frame}: => No motion confidence={message['confidence']}")
+        elif state == 'failed':
+            lines.append(f"{frame}: Optical flow failed")
+        elif state != 'no reference':
+            lines.append(f"{frame}: => {state} dy={message['dy_q14']} ({message['dx']:+.2f},{message['dy']:+.2f}) px, "
+                         f"{message['inliers']}/{message['tracked']}/{message['features']} inliers/tracked/features, "
+                         f"confidence {message['confidence']}")
+        if message['back_to_watch']:
+            lines.append(f"{frame}: => Back to watching")
+        return '\n'.join(lines) if lines else None
+    if kind == 'event':
+        return (f"{message['frame']}: => Event {message['direction']} (was {message['previous']} for "
+                f"{message['duration']} frames), {message['px_per_frame']:.2f} px/frame, {message['px_per_s']:.1f} px/s, "
+                f"confidence {message['confidence']}")
+    if kind == 'stats':
+        f = message['frames']
+        return (f"FPS: {message['fps']:.2f} (target {message['target_fps']}), dropped {message['dropped']}, "
+                f"static {message['still']}/{f}, watching {message['watching']}/{f}, "
+                f"tx dropped {message['tx_dropped']} B")
+    return (f"  {message['stage']:<9} {message['count']:>7} {message['min']:>10} {message['mean']:>10} "
+            f"{message['p50']:>10} {message['p90']:>10} {message['p99']:>10} {message['max']:>10}")
+
+
+def chunks_file(args):
+    with open(args.target, 'rb') as f:
+        while True:
+            chunk = f.read(4096)
+            if not chunk:
+                return
+            yield chunk
+
+
+def chunks_tcp(args):
+    host, _, port = args.target.rpartition(':')
+    with socket.create_connection((host or 'localhost', int(port))) as sock:
+        if args.send:
+            sock.sendall(args.send.encode())
+        while True:
+            chunk = sock.recv(4096)
+            if not chunk:
+                return
+            yield chunk
+
+
+def chunks_serial(args):
+    import serial
+    with serial.Serial(args.target, args.baud, timeout=0.5) as port:
+        if args.send:
+            port.write(args.send.encode())
+        while True:
+            yield port.read(4096)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the firmware's binary telemetry")
+    sub = parser.add_subparsers(dest='command', required=True)
+    for name, func, target in (('file', chunks_file, "captured stream, e.g. from run.exe -t"),
+                               ('tcp', chunks_tcp, "host:port, e.g. the Renode USART socket"),
+                               ('serial', chunks_serial, "serial device")):
+        source = sub.add_parser(name, help=f"read a {target}")
+        source.add_argument('target', help=target)
+        source.add_argument('--json', action='store_true', help="one JSON object per message")
+        source.add_argument('--strings', help="log string table: nvlog.py JSON or the ELF")
+        if name != 'file':
+            source.add_argument('--send', help="characters to send first: p, r, m or '$name=value;', see app.c")
+        if name == 'serial':
+            source.add_argument('--baud', type=int, default=115200)
+        source.set_defaults(func=func)
+    args = parser.parse_args()
+
+    decoder = Decoder(nvlog.load(args.strings) if args.strings else None)
+    previous = None
+    try:
+        for chunk in args.func(args):
+            for message in decoder.feed(chunk):
+                if args.json:
+                    print(json.dumps(message), flush=True)
+                    continue
+                # The firmware sends the table header as text, run.exe -t does not
+                if message['type'] == 'profile' and previous not in ('profile', 'text', 'log'):
+                    print(f"Profile ({message['unit']}):")
+                previous = message['type']
+                line = render(message)
+                if line is not None:
+                    print(line, end='' if message['type'] in ('text', 'log') else '\n', flush=True)
+    except KeyboardInterrupt:
+        pass
+    except Exception as e:
+        print(f"An error occurred: {e}")
+        sys.exit(1)
+    print(decoder.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,226 @@
+"""
+Streams frames to the firmware over its USART, see silmotion_xG12/nv_upload.h
+for the protocol. The firmware must be built with APP_SOURCE=APP_SOURCE_UPLOAD
+(3) and the frames must match its APP_WIDTH x APP_HEIGHT and APP_UPLOAD_FORMAT.
+
+  python nvupload.py tcp localhost:12345 walk.nvsq --loop     # Renode USART socket
+  python nvupload.py serial /dev/ttyACM0 walk.nvsq --fps 5
+  python nvupload.py tcp localhost:12345 capture.raw --width 160 --height 90 --format gray8
+  python nvupload.py file upload.bin walk.nvsq                 # the byte stream, e.g. for ncat
+
+Frames come from an NVSQ file, uncoded or rgb565-drle (decoded back to
+rgb565 here; JPEG sequences cannot be uploaded), or from a raw file of frames
+back to back. Each goes out as a header, its rows and a CRC-16/CCITT-FALSE.
+Without --fps frames go back to back as fast as the link takes them; the
+firmware converts rows as they arrive and skips, and counts, a frame that
+finds both of its slots busy.
+
+What the firmware sends back is decoded as telemetry (utils/nvtlm.py) and
+printed, or passed through as text with --text for APP_TELEMETRY=0 builds.
+The summary on exit counts frames and bytes sent and frame reports received.
+
+The serial command needs pyserial.
+"""
+import argparse
+import binascii
+import socket
+import struct
+import sys
+import threading
+import time
+
+import nvlog
+import nvsq
+import nvtlm
+
+MAGIC = b'NVUP'
+HEADER = struct.Struct('<4sHHBBH')
+UPLOAD_FORMATS = ('rgb565', 'yuyv', 'gray8')
+
+
+def packet(frame, index, width, height, fmt):
+    """One frame on the wire: header, rows, CRC of the rows."""
+    return (HEADER.pack(MAGIC, width, height, fmt, 0, index & 0xFFFF) + frame +
+            struct.pack('<H', binascii.crc_hqx(frame, 0xFFFF)))
+
+
+def load(path, args):
+    """(width, height, format, frames) of an NVSQ or raw file, frames uncoded.
+    args gives the geometry of raw files; without it only NVSQ is read."""
+    with open(path, 'rb') as f:
+        magic = f.read(4)
+    if len(magic) == 4 and struct.unpack('<I', magic)[0] == nvsq.MAGIC:
+        data, (_, _, _, width, height, fmt, _, _, _, count, index_offset, _) = nvsq.read_header(path)
+        if fmt not in nvsq.BYTES_PER_PIXEL:
+            raise ValueError(f"{path}: JPEG frames cannot be uploaded, pack the sequence uncoded")
+        offsets = struct.unpack_from(f'<{count + 1}I', data, index_offset)
+        pixels = width * height
+        frames = []
+        for i in range(count):
+            if fmt == nvsq.FORMATS['rgb565-drle']:
+                coded = data[offsets[i]:offsets[i + 1]]
+                frames.append(struct.pack(f'<{pixels}H', *nvsq.drle_decode(coded, pixels)))
+            else:
+                frames.append(data[offsets[i]:offsets[i] + pixels * nvsq.BYTES_PER_PIXEL[fmt]])
+        if fmt == nvsq.FORMATS['rgb565-drle']:
+            fmt = nvsq.FORMATS['rgb565']
+        return width, height, fmt, frames
+    if args is None:
+        raise ValueError(f"{path}: not an NVSQ file")
+    fmt = nvsq.FORMATS[args.format]
+    width, height, frames = nvsq.load_raw(path, args.width, args.height, fmt)
+    return width, height, fmt, frames
+
+
+class Link:
+    """The firmware's USART: a socket, a serial port or an output file."""
+
+    def __init__(self, args):
+        self.sock = self.port = self.file = None
+        if args.command == 'tcp':
+            host, _, port = args.target.rpartition(':')
+            self.sock = socket.create_connection((host or 'localhost', int(port)))
+            self.sock.settimeout(0.5)
+        elif args.command == 'serial':
+            import serial
+            self.port = serial.Serial(args.target, args.baud, timeout=0.5)
+        else:
+            self.file = open(args.target, 'wb')
+
+    def send(self, data):
+        if self.sock:
+            self.sock.sendall(data)
+        elif self.port:
+            self.port.write(data)
+        else:
+            self.file.write(data)
+
+    def recv(self):
+        """Whatever arrived within half a second; b'' on timeout, None when closed."""
+        if self.sock:
+            try:
+                return self.sock.recv(4096) or None
+            except socket.timeout:
+                return b''
+        return self.port.read(4096)
+
+    def close(self):
+        for handle in (self.sock, self.port, self.file):
+            if handle:
+                handle.close()
+
+
+def receive(link, args, decoder, counts, stop):
+    """Prints what the firmware sends back until stop is set."""
+    pending = b''
+    while not stop.is_set():
+        chunk = link.recv()
+        if chunk is None:
+            return
+        if decoder is None:
+            pending += chunk
+            *lines, pending = pending.split(b'\n')
+            for line in lines:
+                counts['reports'] += line[:1].isdigit()
+                if not args.quiet:
+                    print(line.decode(errors='replace').rstrip('\r'), flush=True)
+            continue
+        for message in decoder.feed(chunk):
+            counts['reports'] += message['type'] == 'motion'
+            line = nvtlm.render(message)
+            if line is not None and not args.quiet:
+                print(line, end='' if message['type'] in ('text', 'log') else '\n', flush=True)
+
+
+def upload(link, frames, width, height, fmt, args):
+    """Sends the frames, once or in a loop; returns (frames, bytes) sent."""
+    sent = sent_bytes = 0
+    start = time.monotonic()
+    while True:
+        for i, frame in enumerate(frames):
+            if args.count and sent == args.count:
+                return sent, sent_bytes
+            if args.fps:
+                delay = start + sent / args.fps - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            data = packet(frame, i, width, height, fmt)
+            link.send(data)
+            sent += 1
+            sent_bytes += len(data)
+        if not args.loop:
+            return sent, sent_bytes
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stream frames to the firmware over its USART")
+    sub = parser.add_subparsers(dest='command', required=True)
+    for name, target in (('tcp', "host:port, e.g. the Renode USART socket"),
+                         ('serial', "serial device"),
+                         ('file', "output file for the byte stream")):
+        sink = sub.add_parser(name, help=f"upload to a {target}")
+        sink.add_argument('target', help=target)
+        sink.add_argument('input', help="NVSQ sequence or raw frames")
+        sink.add_argument('--width', type=int, help="raw input")
+        sink.add_argument('--height', type=int, help="raw input")
+        sink.add_argument('--format', choices=UPLOAD_FORMATS, default='rgb565', help="raw input")
+        sink.add_argument('--loop', action='store_true', help="repeat the frames")
+        sink.add_argument('--count', type=int, default=0, help="stop after this many frames")
+        if name != 'file':
+            sink.add_argument('--fps', type=float, default=0, help="pace the frames, default back to back")
+            sink.add_argument('--send', help="characters to send first: p, r, m or '$name=value;', see app.c")
+            sink.add_argument('--linger', type=float, default=2, help="seconds to keep reading after the last frame")
+            sink.add_argument('--text', action='store_true', help="firmware built with APP_TELEMETRY=0")
+            sink.add_argument('--strings', help="log string table: nvlog.py JSON or the ELF")
+            sink.add_argument('--quiet', action='store_true', help="only the summary")
+        if name == 'serial':
+            sink.add_argument('--baud', type=int, default=115200)
+    args = parser.parse_args()
+    if args.command == 'file':
+        args.fps = 0
+        if args.loop and not args.count:
+            parser.error("--loop into a file needs --count")
+
+    link = None
+    stop = threading.Event()
+    counts = {'reports': 0}
+    try:
+        width, height, fmt, frames = load(args.input, args)
+        link = Link(args)
+        reader = decoder = None
+        if args.command != 'file':
+            decoder = None if args.text else nvtlm.Decoder(nvlog.load(args.strings) if args.strings else None)
+            reader = threading.Thread(target=receive, args=(link, args, decoder, counts, stop), daemon=True)
+            reader.start()
+            if args.send:
+                link.send(args.send.encode())
+        start = time.monotonic()
+        try:
+            sent, sent_bytes = upload(link, frames, width, height, fmt, args)
+        except KeyboardInterrupt:
+            sent = sent_bytes = None
+        elapsed = max(time.monotonic() - start, 1e-6)
+        if reader:
+            try:
+                time.sleep(args.linger)
+            except KeyboardInterrupt:
+                pass
+            stop.set()
+            reader.join(1)
+        if sent is not None:
+            print(f"Sent {sent} {width}x{height} frames, {sent_bytes} bytes in {elapsed:.1f} s "
+                  f"({sent_bytes / elapsed:.0f} B/s, {sent / elapsed:.2f} frames/s)", file=sys.stderr)
+        if reader:
+            print(f"{counts['reports']} frame reports" + (f", {decoder.summary()}" if decoder else ""),
+                  file=sys.stderr)
+    except Exception as e:
+        print(f"An error occurred: {e}")
+        sys.exit(1)
+    finally:
+        stop.set()
+        if link:
+            link.close()
+
+
+if __name__ == "__main__":
+    main()